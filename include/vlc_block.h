@@ -166,6 +166,23 @@ static inline void block_Release( block_t *p_block )
     p_block->pf_release( p_block );
 }
 
+/****************************************************************************
+ * Pools of blocks:
+ ****************************************************************************
+ * - block_PoolNew : create a pool recycling blocks of up to i_max_size bytes
+ *      (rounded up to size classes).
+ * - block_PoolAlloc : like block_Alloc, but reuses a released block of the
+ *      same size class if any. Bigger blocks come from block_Alloc.
+ * - block_PoolRelease : release the pool. It is destroyed with its cached
+ *      blocks once the last block allocated from it is released.
+ *
+ * Pool blocks are released with block_Release, from any thread, without
+ * locking. They can be allocated from any thread too.
+ ****************************************************************************/
+VLC_API block_pool_t *block_PoolNew( size_t i_max_size ) VLC_USED VLC_MALLOC;
+VLC_API block_t *block_PoolAlloc( block_pool_t *, size_t ) VLC_USED VLC_MALLOC;
+VLC_API void block_PoolRelease( block_pool_t * );
+
 VLC_API block_t *block_heap_Alloc(void *, size_t) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_mmap_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
 VLC_API block_t * block_shm_Alloc(void *addr, size_t length) VLC_USED VLC_MALLOC;
@@ -303,6 +303,7 @@ typedef struct iso639_lang_t iso639_lang_t;
 /* block */
 typedef struct block_t      block_t;
 typedef struct block_fifo_t block_fifo_t;
+typedef struct block_pool_t block_pool_t;
 
 /* Hashing */
 typedef struct md5_s md5_t;
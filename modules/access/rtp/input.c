@@ -125,7 +125,7 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
-            block_t *block = block_Alloc (0xffff); /* TODO: p_sys->mru */
+            block_t *block = block_PoolAlloc (sys->pool, 0xffff); /* TODO: p_sys->mru */
             if (unlikely(block == NULL))
                 break; /* we are totallly screwed */
 
@@ -170,7 +170,7 @@ void *rtp_stream_thread (void *opaque)
         if (recv (fd, &frame_len, 2, MSG_WAITALL) != 2)
             break;
 
-        block_t *block = block_Alloc (ntohs (frame_len));
+        block_t *block = block_PoolAlloc (sys->pool, ntohs (frame_len));
         if (unlikely(block == NULL))
             break;
 
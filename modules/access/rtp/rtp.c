@@ -271,8 +271,9 @@ static int Open (vlc_object_t *obj)
     demux->pf_control = Control;
     demux->p_sys      = p_sys;
 
+    p_sys->pool = block_PoolNew (0xffff);
     p_sys->session = rtp_session_create (demux);
-    if (p_sys->session == NULL)
+    if (p_sys->session == NULL || p_sys->pool == NULL)
         goto error;
 
 #ifdef HAVE_SRTP
@@ -334,6 +335,8 @@ static void Close (vlc_object_t *obj)
 #endif
     if (p_sys->session)
         rtp_session_destroy (demux, p_sys->session);
+    if (p_sys->pool)
+        block_PoolRelease (p_sys->pool);
     if (p_sys->rtcp_fd != -1)
         net_Close (p_sys->rtcp_fd);
     net_Close (p_sys->fd);
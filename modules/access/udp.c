@@ -75,6 +75,7 @@ struct access_sys_t
     bool running;
     size_t fifo_size;
     block_fifo_t *fifo;
+    block_pool_t *pool;
     vlc_thread_t thread;
 };
 
@@ -167,12 +168,21 @@ static int Open( vlc_object_t *p_this )
         goto error;
     }
 
+    sys->pool = block_PoolNew( MTU );
+    if( unlikely( sys->pool == NULL ) )
+    {
+        block_FifoRelease( sys->fifo );
+        net_Close( sys->fd );
+        goto error;
+    }
+
     sys->running = true;
     sys->fifo_size = var_InheritInteger( p_access, "udp-buffer");
 
     if( vlc_clone( &sys->thread, ThreadRead, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
+        block_PoolRelease( sys->pool );
         block_FifoRelease( sys->fifo );
         net_Close( sys->fd );
 error:
@@ -194,6 +204,7 @@ static void Close( vlc_object_t *p_this )
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
     block_FifoRelease( sys->fifo );
+    block_PoolRelease( sys->pool );
     net_Close( sys->fd );
     free( sys );
 }
@@ -260,7 +271,7 @@ static void* ThreadRead( void *data )
 
     for(;;)
     {
-        block_t *pkt = block_Alloc(MTU);
+        block_t *pkt = block_PoolAlloc(sys->pool, MTU);
         if (unlikely(pkt == NULL))
         {   /* OOM - dequeue and discard one packet */
             char dummy;
@@ -288,6 +288,18 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
             p_sys->b_mtu_warning = true;
         }
 
+        /* A block filling most of a datagram is sent as is, without copy */
+        if( !p_sys->p_buffer && p_buffer->i_buffer > p_sys->i_mtu / 2
+         && p_buffer->i_buffer <= p_sys->i_mtu )
+        {
+            i_len += p_buffer->i_buffer;
+            p_next = p_buffer->p_next;
+            p_buffer->p_next = NULL;
+            block_FifoPut( p_sys->p_fifo, p_buffer );
+            p_buffer = p_next;
+            continue;
+        }
+
         /* Check if there is enough space in the buffer */
         if( p_sys->p_buffer &&
             p_sys->p_buffer->i_buffer + p_buffer->i_buffer > p_sys->i_mtu )
@@ -35,9 +35,11 @@
 #include "playlist/BasePeriod.h"
 #include "playlist/BaseAdaptationSet.h"
 #include "http/HTTPConnectionManager.h"
+#include "http/SegmentCache.hpp"
 #include "logic/AlwaysBestAdaptationLogic.h"
 #include "logic/RateBasedAdaptationLogic.h"
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
+#include "logic/BufferBasedAdaptationLogic.hpp"
 #include <vlc_stream.h>
 
 #include <ctime>
@@ -53,7 +55,11 @@ PlaylistManager::PlaylistManager( AbstractPlaylist *pl,
              logicType      ( type ),
              playlist       ( pl ),
              stream         ( stream ),
-             nextPlaylistupdate  ( 0 )
+             nextPlaylistupdate  ( 0 ),
+             prefetchSegments    ( 1 ),
+             prefetchLength      ( 0 ),
+             httpPipelining      ( false ),
+             cacheSize           ( 0 )
 {
     for(int i=0; i<StreamTypeCount; i++)
         streams[i] = NULL;
@@ -61,9 +67,9 @@ PlaylistManager::PlaylistManager( AbstractPlaylist *pl,
 
 PlaylistManager::~PlaylistManager   ()
 {
-    delete conManager;
     for(int i=0; i<StreamTypeCount; i++)
         delete streams[i];
+    delete conManager;
 }
 
 bool PlaylistManager::start(demux_t *demux)
@@ -72,6 +78,14 @@ bool PlaylistManager::start(demux_t *demux)
     if(!period)
         return false;
 
+    conManager = new (std::nothrow) HTTPConnectionManager(VLC_OBJECT(stream));
+    if(!conManager)
+        return false;
+    conManager->setPipelining(httpPipelining);
+    if(cacheSize)
+        conManager->setCache(new (std::nothrow) SegmentCache(VLC_OBJECT(stream),
+                                                             cacheSize, cacheDir));
+
     for(int i=0; i<StreamTypeCount; i++)
     {
         StreamType type = static_cast<StreamType>(i);
@@ -100,14 +114,19 @@ bool PlaylistManager::start(demux_t *demux)
                 delete logic;
                 delete tracker;
                 streams[type] = NULL;
+                continue;
+            }
+
+            /* each stream downloads from its own thread and connection */
+            if(!streams[type]->startPrefetching(conManager, &downloadNotifier,
+                                                prefetchSegments, prefetchLength))
+            {
+                delete streams[type];
+                streams[type] = NULL;
             }
         }
     }
 
-    conManager = new (std::nothrow) HTTPConnectionManager(VLC_OBJECT(stream));
-    if(!conManager)
-        return false;
-
     playlist->playbackStart.Set(time(NULL));
     nextPlaylistupdate = playlist->playbackStart.Get();
 
@@ -117,14 +136,14 @@ bool PlaylistManager::start(demux_t *demux)
 Stream::status PlaylistManager::demux(mtime_t nzdeadline)
 {
     Stream::status i_return = Stream::status_demuxed;
+    const unsigned events = downloadNotifier.getEvents();
 
     for(int type=0; type<StreamTypeCount; type++)
     {
         if(!streams[type])
             continue;
 
-        Stream::status i_ret =
-                streams[type]->demux(conManager, nzdeadline);
+        Stream::status i_ret = streams[type]->demux(nzdeadline);
 
         if(i_ret < Stream::status_eof)
             return i_ret;
@@ -132,6 +151,17 @@ Stream::status PlaylistManager::demux(mtime_t nzdeadline)
             i_return = Stream::status_buffering;
     }
 
+    /* Nothing left to feed: wait for any of the streams to get data
+     * instead of blocking on one of them */
+    if(i_return == Stream::status_buffering)
+    {
+        bool b_data = false;
+        for(int type=0; type<StreamTypeCount && !b_data; type++)
+            b_data = streams[type] && streams[type]->hasPrefetchedData();
+        if(!b_data)
+            downloadNotifier.wait(events, mdate() + CLOCK_FREQ / 10);
+    }
+
     return i_return;
 }
 
@@ -229,6 +259,8 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
         case AbstractAdaptationLogic::Default:
         case AbstractAdaptationLogic::RateBased:
             return new (std::nothrow) RateBasedAdaptationLogic(0, 0);
+        case AbstractAdaptationLogic::BufferBased:
+            return new (std::nothrow) BufferBasedAdaptationLogic();
         default:
             return NULL;
     }
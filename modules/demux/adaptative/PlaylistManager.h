@@ -67,7 +67,13 @@ namespace adaptative
             AbstractPlaylist                    *playlist;
             stream_t                            *stream;
             Stream                              *streams[StreamTypeCount];
+            DownloadNotifier                     downloadNotifier;
             mtime_t                              nextPlaylistupdate;
+            unsigned                             prefetchSegments;
+            mtime_t                              prefetchLength;
+            bool                                 httpPipelining;
+            size_t                               cacheSize;
+            std::string                          cacheDir;
     };
 
 }
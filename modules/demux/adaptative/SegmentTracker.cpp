@@ -127,3 +127,8 @@ mtime_t SegmentTracker::getSegmentStart() const
     else
         return 0;
 }
+
+AbstractPlaylist *SegmentTracker::getPlaylist() const
+{
+    return playlist;
+}
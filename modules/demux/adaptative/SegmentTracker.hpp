@@ -61,6 +61,7 @@ namespace adaptative
             Chunk* getNextChunk(StreamType);
             bool setPosition(mtime_t, bool);
             mtime_t getSegmentStart() const;
+            AbstractPlaylist *getPlaylist() const;
 
         private:
             bool initializing;
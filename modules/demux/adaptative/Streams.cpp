@@ -25,13 +25,63 @@
 #include "http/Chunk.h"
 #include "logic/AbstractAdaptationLogic.h"
 #include "SegmentTracker.hpp"
+#include "playlist/AbstractPlaylist.hpp"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
 
+/* Marks the last block of a prefetched segment */
+#define BLOCK_FLAG_SEGMENT_END (1 << BLOCK_FLAG_PRIVATE_SHIFT)
+
+/* Chunks are read in blocks of about that much media */
+#define READ_BLOCK_DURATION (CLOCK_FREQ / 4)
+#define READ_BLOCK_MIN      (32 * 1024)
+#define READ_BLOCK_MAX      (512 * 1024)
+
 using namespace adaptative;
 using namespace adaptative::http;
 using namespace adaptative::logic;
 
+DownloadNotifier::DownloadNotifier()
+{
+    events = 0;
+    vlc_mutex_init(&lock);
+    vlc_cond_init(&cond);
+}
+
+DownloadNotifier::~DownloadNotifier()
+{
+    vlc_cond_destroy(&cond);
+    vlc_mutex_destroy(&lock);
+}
+
+void DownloadNotifier::signal()
+{
+    vlc_mutex_lock(&lock);
+    events++;
+    vlc_cond_broadcast(&cond);
+    vlc_mutex_unlock(&lock);
+}
+
+unsigned DownloadNotifier::getEvents() const
+{
+    vlc_mutex_lock(&lock);
+    unsigned ret = events;
+    vlc_mutex_unlock(&lock);
+    return ret;
+}
+
+/* Waits for a new event since the given events count */
+void DownloadNotifier::wait(unsigned since, mtime_t deadline)
+{
+    vlc_mutex_lock(&lock);
+    while(events == since)
+    {
+        if(vlc_cond_timedwait(&cond, &lock, deadline))
+            break;
+    }
+    vlc_mutex_unlock(&lock);
+}
+
 Stream::Stream(const std::string &mime)
 {
     init(mimeToType(mime), mimeToFormat(mime));
@@ -48,17 +98,48 @@ void Stream::init(const StreamType type_, const StreamFormat format_)
     format = format_;
     output = NULL;
     adaptationLogic = NULL;
-    currentChunk = NULL;
     eof = false;
     segmentTracker = NULL;
+    blockPool = block_PoolNew(READ_BLOCK_MAX);
+    cacheBlock = NULL;
+    cacheOffset = 0;
+    prefetchConnManager = NULL;
+    prefetchNotifier = NULL;
+    prefetchQueue = NULL;
+    prefetchQueueLast = &prefetchQueue;
+    prefetchedSegments = 0;
+    prefetchedLength = 0;
+    prefetchSegmentLength = 0;
+    prefetchMaxSegments = 0;
+    prefetchMaxLength = 0;
+    prefetchGeneration = 0;
+    prefetching = false;
+    prefetchEOF = false;
+    prefetchClose = false;
+    vlc_mutex_init(&lock);
+    vlc_cond_init(&prefetchWait);
 }
 
 Stream::~Stream()
 {
-    delete currentChunk;
+    if(prefetching)
+    {
+        vlc_mutex_lock(&lock);
+        prefetchClose = true;
+        vlc_cond_signal(&prefetchWait);
+        vlc_mutex_unlock(&lock);
+        vlc_join(prefetchThreadId, NULL);
+    }
+    block_ChainRelease(prefetchQueue);
+    vlc_cond_destroy(&prefetchWait);
+    vlc_mutex_destroy(&lock);
     delete adaptationLogic;
     delete output;
     delete segmentTracker;
+    if(blockPool)
+        block_PoolRelease(blockPool);
+    if(cacheBlock)
+        block_Release(cacheBlock);
 }
 
 StreamType Stream::mimeToType(const std::string &mime)
@@ -108,6 +189,24 @@ void Stream::create(demux_t *demux, AbstractAdaptationLogic *logic, SegmentTrack
     segmentTracker = tracker;
 }
 
+bool Stream::startPrefetching(HTTPConnectionManager *connManager,
+                              DownloadNotifier *notifier,
+                              unsigned maxsegments, mtime_t maxlength)
+{
+    if(prefetching)
+        return false;
+
+    prefetchConnManager = connManager;
+    prefetchNotifier = notifier;
+    prefetchMaxSegments = __MAX(maxsegments, 1);
+    prefetchMaxLength = maxlength;
+    if(vlc_clone(&prefetchThreadId, prefetchThread,
+                 this, VLC_THREAD_PRIORITY_INPUT))
+        return false;
+    prefetching = true;
+    return true;
+}
+
 bool Stream::isEOF() const
 {
     return false;
@@ -133,29 +232,18 @@ bool Stream::operator ==(const Stream &stream) const
     return stream.type == type;
 }
 
-Chunk * Stream::getChunk()
-{
-    if (currentChunk == NULL)
-    {
-        currentChunk = segmentTracker->getNextChunk(type);
-        if (currentChunk == NULL)
-            eof = true;
-    }
-    return currentChunk;
-}
-
 bool Stream::seekAble() const
 {
     return (output && output->seekAble());
 }
 
-Stream::status Stream::demux(HTTPConnectionManager *connManager, mtime_t nz_deadline)
+Stream::status Stream::demux(mtime_t nz_deadline)
 {
     if(nz_deadline + VLC_TS_0 > output->getPCR()) /* not already demuxed */
     {
         /* need to read, demuxer still buffering, ... */
-        if(read(connManager) <= 0)
-            return Stream::status_eof;
+        if(read() <= 0)
+            return (eof) ? Stream::status_eof : Stream::status_buffering;
 
         if(nz_deadline + VLC_TS_0 > output->getPCR()) /* need to read more */
             return Stream::status_buffering;
@@ -165,41 +253,70 @@ Stream::status Stream::demux(HTTPConnectionManager *connManager, mtime_t nz_dead
     return Stream::status_demuxed;
 }
 
-size_t Stream::read(HTTPConnectionManager *connManager)
+/* Reads next block of chunk, doing the query first if needed.
+ * Chunk is released and deleted when fully read or on read error,
+ * which is reported through pb_released. */
+block_t * Stream::readChunk(HTTPConnectionManager *connManager, Chunk *chunk,
+                            bool *pb_released)
 {
-    Chunk *chunk = getChunk();
-    if(!chunk)
-        return 0;
+    *pb_released = false;
 
     if(!chunk->getConnection())
     {
+        /* Already downloaded, we get it whole */
+        block_t *cached;
+        if(chunk->getBytesRead() == 0 &&
+           (cached = connManager->getCachedChunk(chunk)))
+        {
+            AbstractPlaylist *playlist = segmentTracker->getPlaylist();
+            playlist->lock();
+            chunk->onDownload(cached->p_buffer, cached->i_buffer);
+            playlist->unlock();
+            dropChunk(connManager, chunk);
+            *pb_released = true;
+            return cached;
+        }
+
        if(!connManager->connectChunk(chunk))
-        return 0;
+        return NULL;
     }
 
-    size_t readsize = 0;
-
     /* New chunk, do query */
     if(chunk->getBytesRead() == 0)
     {
         if(chunk->getConnection()->query(chunk->getPath()) != VLC_SUCCESS)
         {
-            chunk->getConnection()->releaseChunk();
-            currentChunk = NULL;
-            delete chunk;
-            return 0;
+            dropChunk(connManager, chunk);
+            *pb_released = true;
+            return NULL;
         }
+
+        /* previous one might have been left unfinished */
+        if(cacheBlock)
+            block_Release(cacheBlock);
+        cacheBlock = NULL;
+        cacheOffset = 0;
+        if(connManager->canCache(chunk->getBytesToRead()))
+            cacheBlock = block_Alloc(chunk->getBytesToRead());
     }
 
-    /* Because we don't know Chunk size at start, we need to get size
+    /* Read about READ_BLOCK_DURATION of media at once, so high bitrates
+       go in few large blocks straight to the demuxer. They come from
+       the pool, avoiding to fault in fresh buffers every time.
+       Because we don't know Chunk size at start, we need to get size
        from content length */
-    readsize = chunk->getBytesToRead();
-    if (readsize > 32768)
-        readsize = 32768;
-
-    block_t *block = block_Alloc(readsize);
+    size_t readsize = (uint64_t)chunk->getBitrate() * READ_BLOCK_DURATION / CLOCK_FREQ / 8;
+    readsize = VLC_CLIP(readsize, READ_BLOCK_MIN, READ_BLOCK_MAX);
+    if (readsize > chunk->getBytesToRead())
+        readsize = chunk->getBytesToRead();
+
+    block_t *block;
+    if(blockPool)
+        block = block_PoolAlloc(blockPool, readsize);
+    else
+        block = block_Alloc(readsize);
     if(!block)
-        return 0;
+        return NULL;
 
     mtime_t time = mdate();
     ssize_t ret = chunk->getConnection()->read(block->p_buffer, readsize);
@@ -208,36 +325,243 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     if(ret < 0)
     {
         block_Release(block);
-        chunk->getConnection()->releaseChunk();
-        currentChunk = NULL;
-        delete chunk;
-        return 0;
+        dropChunk(connManager, chunk);
+        *pb_released = true;
+        return NULL;
     }
-    else
+
+    block->i_buffer = (size_t)ret;
+
+    adaptationLogic->updateDownloadRate(block->i_buffer, time);
+
+    if(cacheBlock && cacheOffset + block->i_buffer <= cacheBlock->i_buffer)
     {
-        block->i_buffer = (size_t)ret;
+        memcpy(&cacheBlock->p_buffer[cacheOffset], block->p_buffer, block->i_buffer);
+        cacheOffset += block->i_buffer;
+    }
+
+    if (chunk->getBytesToRead() == 0)
+    {
+        if(cacheBlock && cacheOffset == cacheBlock->i_buffer)
+        {
+            connManager->cacheChunk(chunk, cacheBlock);
+            cacheBlock = NULL;
+        }
 
-        adaptationLogic->updateDownloadRate(block->i_buffer, time);
+        AbstractPlaylist *playlist = segmentTracker->getPlaylist();
+        playlist->lock();
+        chunk->onDownload(block->p_buffer, block->i_buffer);
+        playlist->unlock();
+        dropChunk(connManager, chunk);
+        *pb_released = true;
+    }
+
+    return block;
+}
+
+void Stream::dropChunk(HTTPConnectionManager *connManager, Chunk *chunk)
+{
+    connManager->releaseChunk(chunk);
+    delete chunk;
+}
+
+size_t Stream::read()
+{
+    vlc_mutex_lock(&lock);
+    block_t *block = prefetchQueue;
+    if(block)
+    {
+        prefetchQueue = block->p_next;
+        if(prefetchQueue == NULL)
+            prefetchQueueLast = &prefetchQueue;
+        block->p_next = NULL;
 
-        if (chunk->getBytesToRead() == 0)
+        if(block->i_flags & BLOCK_FLAG_SEGMENT_END)
         {
-            chunk->onDownload(block->p_buffer, block->i_buffer);
-            chunk->getConnection()->releaseChunk();
-            currentChunk = NULL;
-            delete chunk;
+            prefetchedSegments--;
+            prefetchedLength -= block->i_length;
+            vlc_cond_signal(&prefetchWait);
         }
+        block->i_flags &= ~BLOCK_FLAG_SEGMENT_END;
+        block->i_length = 0;
+    }
+    else if(prefetchEOF)
+    {
+        eof = true;
     }
+    vlc_mutex_unlock(&lock);
 
-    readsize = block->i_buffer;
+    if(!block)
+        return 0;
 
+    size_t readsize = block->i_buffer;
     output->pushBlock(block);
-
     return readsize;
 }
 
+bool Stream::hasPrefetchedData() const
+{
+    vlc_mutex_lock(&lock);
+    bool b_data = (prefetchQueue != NULL);
+    vlc_mutex_unlock(&lock);
+    return b_data;
+}
+
+bool Stream::prefetchHasRoom() const
+{
+    /* always allow one segment ahead */
+    if(prefetchedSegments == 0)
+        return true;
+    if(prefetchedSegments >= prefetchMaxSegments)
+        return false;
+    return (prefetchMaxLength == 0 || prefetchedLength < prefetchMaxLength);
+}
+
+/* Estimated duration the queue can hold, given both limits */
+mtime_t Stream::prefetchCapacity() const
+{
+    mtime_t capacity = prefetchSegmentLength * prefetchMaxSegments;
+    if(prefetchMaxLength && (capacity == 0 || capacity > prefetchMaxLength))
+        capacity = prefetchMaxLength;
+    return capacity;
+}
+
+void Stream::prefetchFlush()
+{
+    block_ChainRelease(prefetchQueue);
+    prefetchQueue = NULL;
+    prefetchQueueLast = &prefetchQueue;
+    prefetchedSegments = 0;
+    prefetchedLength = 0;
+    prefetchGeneration++;
+    prefetchEOF = false;
+    eof = false;
+    vlc_cond_signal(&prefetchWait);
+}
+
+void * Stream::prefetchThread(void *p_data)
+{
+    Stream *me = static_cast<Stream *>(p_data);
+    int canc = vlc_savecancel();
+
+    Chunk *next = NULL; /* pipelined request */
+    mtime_t nextLength = 0;
+    unsigned nextGeneration = 0;
+
+    vlc_mutex_lock(&me->lock);
+    while(!me->prefetchClose)
+    {
+        if(next && nextGeneration != me->prefetchGeneration)
+        {
+            me->dropChunk(me->prefetchConnManager, next);
+            next = NULL;
+        }
+
+        if(me->prefetchEOF || !me->prefetchHasRoom())
+        {
+            vlc_cond_wait(&me->prefetchWait, &me->lock);
+            continue;
+        }
+
+        me->adaptationLogic->updateBufferLevel(me->prefetchedLength,
+                                               me->prefetchCapacity());
+
+        AbstractPlaylist *playlist = me->segmentTracker->getPlaylist();
+        Chunk *chunk;
+        mtime_t length;
+        if(next)
+        {
+            chunk = next;
+            length = nextLength;
+            next = NULL;
+        }
+        else
+        {
+            playlist->lock();
+            mtime_t start = me->segmentTracker->getSegmentStart();
+            chunk = me->segmentTracker->getNextChunk(me->type);
+            length = me->segmentTracker->getSegmentStart() - start;
+            playlist->unlock();
+        }
+        if(length > 0)
+            me->prefetchSegmentLength = length;
+
+        if(chunk == NULL)
+        {
+            me->prefetchEOF = true;
+            me->prefetchNotifier->signal();
+            continue;
+        }
+
+        const unsigned generation = me->prefetchGeneration;
+        bool b_done = false;
+        bool b_pipelineTried = false;
+        while(!b_done)
+        {
+            vlc_mutex_unlock(&me->lock);
+            block_t *block = me->readChunk(me->prefetchConnManager, chunk, &b_done);
+            vlc_mutex_lock(&me->lock);
+
+            if(!block) /* failed, skip to next segment */
+            {
+                if(!b_done)
+                    me->dropChunk(me->prefetchConnManager, chunk);
+                break;
+            }
+
+            if(me->prefetchClose || generation != me->prefetchGeneration)
+            {
+                /* seeked or closing: data is obsolete */
+                block_Release(block);
+                if(!b_done)
+                    me->dropChunk(me->prefetchConnManager, chunk);
+                break;
+            }
+
+            if(b_done)
+            {
+                block->i_flags |= BLOCK_FLAG_SEGMENT_END;
+                block->i_length = (length > 0) ? length : 0;
+                me->prefetchedSegments++;
+                me->prefetchedLength += block->i_length;
+            }
+            block_ChainLastAppend(&me->prefetchQueueLast, block);
+            me->prefetchNotifier->signal();
+
+            /* Request next segment on the same connection while reading,
+             * only if it will fit in the queue */
+            if(!b_done && !b_pipelineTried &&
+               me->prefetchConnManager->isPipelining() &&
+               me->prefetchedSegments + 1 < me->prefetchMaxSegments)
+            {
+                b_pipelineTried = true;
+                playlist->lock();
+                mtime_t start = me->segmentTracker->getSegmentStart();
+                next = me->segmentTracker->getNextChunk(me->type);
+                nextLength = me->segmentTracker->getSegmentStart() - start;
+                playlist->unlock();
+                nextGeneration = generation;
+                if(next)
+                    me->prefetchConnManager->pipelineChunk(chunk, next);
+            }
+        }
+    }
+    /* current chunk is always released first */
+    if(next)
+        me->dropChunk(me->prefetchConnManager, next);
+    vlc_mutex_unlock(&me->lock);
+
+    vlc_restorecancel(canc);
+    return NULL;
+}
+
 bool Stream::setPosition(mtime_t time, bool tryonly)
 {
+    vlc_mutex_lock(&lock);
     bool ret = segmentTracker->setPosition(time, tryonly);
+    if(!tryonly && ret && prefetching)
+        prefetchFlush();
+    vlc_mutex_unlock(&lock);
     if(!tryonly && ret)
         output->setPosition(time);
     return ret;
@@ -245,7 +569,10 @@ bool Stream::setPosition(mtime_t time, bool tryonly)
 
 mtime_t Stream::getPosition() const
 {
-    return segmentTracker->getSegmentStart();
+    vlc_mutex_lock(&lock);
+    mtime_t time = segmentTracker->getSegmentStart();
+    vlc_mutex_unlock(&lock);
+    return time;
 }
 
 AbstractStreamOutput::AbstractStreamOutput(demux_t *demux)
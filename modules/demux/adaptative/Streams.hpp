@@ -50,6 +50,22 @@ namespace adaptative
     using namespace http;
     using namespace logic;
 
+    /* Wakes up the demuxer when any of the streams got new data */
+    class DownloadNotifier
+    {
+    public:
+        DownloadNotifier();
+        ~DownloadNotifier();
+        void signal();
+        unsigned getEvents() const;
+        void wait(unsigned, mtime_t);
+
+    private:
+        mutable vlc_mutex_t lock;
+        vlc_cond_t cond;
+        unsigned events;
+    };
+
     class Stream
     {
     public:
@@ -60,27 +76,55 @@ namespace adaptative
         static StreamType mimeToType(const std::string &mime);
         static StreamFormat mimeToFormat(const std::string &mime);
         void create(demux_t *, AbstractAdaptationLogic *, SegmentTracker *);
+        bool startPrefetching(HTTPConnectionManager *, DownloadNotifier *,
+                              unsigned, mtime_t);
         bool isEOF() const;
         mtime_t getPCR() const;
         int getGroup() const;
         int esCount() const;
         bool seekAble() const;
         typedef enum {status_eof, status_buffering, status_demuxed} status;
-        status demux(HTTPConnectionManager *, mtime_t);
+        status demux(mtime_t);
+        bool hasPrefetchedData() const;
         bool setPosition(mtime_t, bool);
         mtime_t getPosition() const;
 
     private:
-        Chunk *getChunk();
         void init(const StreamType, const StreamFormat);
-        size_t read(HTTPConnectionManager *);
+        size_t read();
+        block_t * readChunk(HTTPConnectionManager *, Chunk *, bool *);
+        void dropChunk(HTTPConnectionManager *, Chunk *);
         StreamType type;
         StreamFormat format;
         AbstractStreamOutput *output;
         AbstractAdaptationLogic *adaptationLogic;
         SegmentTracker *segmentTracker;
-        http::Chunk *currentChunk;
+        block_pool_t *blockPool; /* large read buffers recycling */
+        block_t *cacheBlock; /* copy of the chunk being read, for the cache */
+        size_t cacheOffset;
         bool eof;
+
+        /* background segments download */
+        static void * prefetchThread(void *);
+        bool prefetchHasRoom() const;
+        mtime_t prefetchCapacity() const;
+        void prefetchFlush();
+        HTTPConnectionManager *prefetchConnManager;
+        DownloadNotifier *prefetchNotifier;
+        vlc_thread_t prefetchThreadId;
+        vlc_cond_t   prefetchWait;   /* downloader waits for room */
+        block_t     *prefetchQueue;
+        block_t    **prefetchQueueLast;
+        unsigned     prefetchedSegments; /* downloaded, not yet consumed */
+        mtime_t      prefetchedLength;   /* duration of those segments */
+        mtime_t      prefetchSegmentLength; /* last segment duration */
+        unsigned     prefetchMaxSegments;
+        mtime_t      prefetchMaxLength;
+        unsigned     prefetchGeneration; /* bumped on seek */
+        bool         prefetching;
+        bool         prefetchEOF;
+        bool         prefetchClose;
+        mutable vlc_mutex_t lock;
     };
 
     class AbstractStreamOutput
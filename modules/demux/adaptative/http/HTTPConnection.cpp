@@ -35,8 +35,10 @@ HTTPConnection::HTTPConnection(vlc_object_t *stream_, Socket *socket_,
     psz_useragent = var_InheritString(stream, "http-user-agent");
     toRead = 0;
     chunk = NULL;
+    pendingChunk = NULL;
     queryOk = false;
-    retries = 0;
+    pipelined = false;
+    this->persistent = persistent;
     connectionClose = !persistent;
     bindChunk(chunk_);
 }
@@ -65,56 +67,88 @@ bool HTTPConnection::connected() const
 void HTTPConnection::disconnect()
 {
     queryOk = false;
+    pipelined = false;
     toRead = 0;
     socket->disconnect();
 }
 
-int HTTPConnection::query(const std::string &path)
+bool HTTPConnection::sendRequest(const Chunk *target)
+{
+    std::string header = buildRequestHeader(target);
+    if(connectionClose)
+        header.append("Connection: close\r\n");
+    header.append("\r\n");
+    return send(header);
+}
+
+int HTTPConnection::query(const std::string &)
 {
     if(!chunk)
         return VLC_EGENERIC;
 
     queryOk = false;
+    toRead = 0;
 
-    if(!connected() &&
-       !connect(chunk->getHostname(), chunk->getPort()))
-        return VLC_EGENERIC;
-
-    std::string header = buildRequestHeader(path);
-    if(connectionClose)
-        header.append("Connection: close\r\n");
-    header.append("\r\n");
-
-    if(!send( header ))
+    if(pipelined)
     {
-        socket->disconnect();
-        if(!connectionClose)
+        /* request was sent while reading the previous reply */
+        pipelined = false;
+        int i_ret = parseReply();
+        if(i_ret == VLC_SUCCESS)
         {
-            /* server closed connection pipeline after last req. need new */
-            connectionClose = true;
-            return query(path);
+            queryOk = true;
+            return VLC_SUCCESS;
         }
-        return VLC_EGENERIC;
+        socket->disconnect();
+        if(i_ret != VLC_EGENERIC)
+            return i_ret;
+        /* server dropped the pipeline, do a regular request */
     }
 
-    int i_ret = parseReply();
+    connectionClose = !persistent;
+
+    /* A kept alive socket might have been closed by the server meanwhile,
+     * in which case we retry once on a new one, still persistent */
+    const bool reused = connected();
+    if(!reused && !connect(chunk->getHostname(), chunk->getPort()))
+        return VLC_EGENERIC;
+
+    int i_ret = VLC_EGENERIC;
+    if(sendRequest(chunk))
+        i_ret = parseReply();
+
     if(i_ret == VLC_SUCCESS)
     {
         queryOk = true;
     }
-    else if(i_ret == VLC_EGENERIC)
+    else
     {
+        /* error reply body is left unread */
         socket->disconnect();
-        if(!connectionClose)
-        {
-            connectionClose = true;
-            return query(path);
-        }
+        if(i_ret == VLC_EGENERIC && reused)
+            return query(chunk->getPath());
     }
 
     return i_ret;
 }
 
+bool HTTPConnection::pipeline(Chunk *next)
+{
+    if(!chunk || pendingChunk || connectionClose || !connected() ||
+       chunk->getBytesRead() == 0 || toRead == 0 ||
+       next->getHostname() != chunk->getHostname() ||
+       next->getPort() != chunk->getPort() ||
+       next->getScheme() != chunk->getScheme())
+        return false;
+
+    if(!sendRequest(next))
+        return false;
+
+    pendingChunk = next;
+    next->setConnection(this);
+    return true;
+}
+
 ssize_t HTTPConnection::read(void *p_buffer, size_t len)
 {
     if(!chunk || !connected() ||
@@ -172,7 +206,7 @@ int HTTPConnection::parseReply()
     if (replycode != 200 && replycode != 206)
         return VLC_ENOOBJ;
 
-    readLine();
+    line = readLine();
 
     while(!line.empty() && line.compare("\r\n"))
     {
@@ -210,8 +244,10 @@ void HTTPConnection::bindChunk(Chunk *chunk_)
 
 void HTTPConnection::releaseChunk()
 {
-    if(!connectionClose &&
-       (!chunk || chunk->getBytesRead() == toRead) ) /* We can't resend request if we haven't finished reading */
+    /* We can't resend request if we haven't finished reading, nor if the
+     * reply to a pipelined request is still on the wire */
+    if(!connectionClose && !pipelined &&
+       (!chunk || chunk->getBytesRead() == toRead) )
     {
         queryOk = false;
         toRead = 0;
@@ -224,6 +260,15 @@ void HTTPConnection::releaseChunk()
         chunk->setConnection(NULL);
         chunk = NULL;
     }
+
+    /* pipelined chunk becomes current, its reply is next on the wire
+     * unless we had to disconnect */
+    if(pendingChunk)
+    {
+        chunk = pendingChunk;
+        pendingChunk = NULL;
+        pipelined = connected();
+    }
 }
 
 bool HTTPConnection::isAvailable() const
@@ -231,6 +276,11 @@ bool HTTPConnection::isAvailable() const
     return chunk == NULL;
 }
 
+bool HTTPConnection::isPersistent() const
+{
+    return !connectionClose;
+}
+
 void HTTPConnection::onHeader(const std::string &key,
                               const std::string &value)
 {
@@ -248,24 +298,24 @@ void HTTPConnection::onHeader(const std::string &key,
     }
 }
 
-std::string HTTPConnection::buildRequestHeader(const std::string &path) const
+std::string HTTPConnection::buildRequestHeader(const Chunk *target) const
 {
     std::stringstream req;
-    req << "GET " << path << " HTTP/1.1\r\n" <<
+    req << "GET " << target->getPath() << " HTTP/1.1\r\n" <<
            "Host: " << hostname << "\r\n" <<
            "User-Agent: " << std::string(psz_useragent) << "\r\n";
-    req << extraRequestHeaders();
+    req << extraRequestHeaders(target);
     return req.str();
 }
 
-std::string HTTPConnection::extraRequestHeaders() const
+std::string HTTPConnection::extraRequestHeaders(const Chunk *target) const
 {
     std::stringstream ss;
-    if(chunk->usesByteRange())
+    if(target->usesByteRange())
     {
-        ss << "Range: bytes=" << chunk->getStartByte() << "-";
-        if(chunk->getEndByte())
-            ss << chunk->getEndByte();
+        ss << "Range: bytes=" << target->getStartByte() << "-";
+        if(target->getEndByte())
+            ss << target->getEndByte();
         ss << "\r\n";
     }
     return ss.str();
@@ -48,6 +48,7 @@ namespace adaptative
                 virtual bool    connect     (const std::string& hostname, int port = 80);
                 virtual bool    connected   () const;
                 virtual int     query       (const std::string& path);
+                virtual bool    pipeline    (Chunk *);
                 virtual bool    send        (const void *buf, size_t size);
                 virtual ssize_t read        (void *p_buffer, size_t len);
                 virtual void    disconnect  ();
@@ -56,14 +57,16 @@ namespace adaptative
                 const std::string&  getHostname () const;
                 virtual void    bindChunk   (Chunk *chunk);
                 virtual bool    isAvailable () const;
+                virtual bool    isPersistent() const;
                 virtual void    releaseChunk();
 
             protected:
 
                 virtual void    onHeader    (const std::string &line,
                                              const std::string &value);
-                virtual std::string extraRequestHeaders() const;
-                virtual std::string buildRequestHeader(const std::string &path) const;
+                virtual std::string extraRequestHeaders(const Chunk *) const;
+                virtual std::string buildRequestHeader(const Chunk *) const;
+                bool sendRequest(const Chunk *);
 
                 int parseReply();
                 std::string readLine();
@@ -72,11 +75,12 @@ namespace adaptative
                 vlc_object_t *stream;
                 size_t toRead;
                 Chunk *chunk;
+                Chunk *pendingChunk;    /* next request, already sent */
 
+                bool                persistent;
                 bool                connectionClose;
                 bool                queryOk;
-                int                 retries;
-                static const int    retryCount = 5;
+                bool                pipelined; /* current request already sent */
 
             private:
                 Socket *socket;
@@ -29,42 +29,194 @@
 #include "HTTPConnection.hpp"
 #include "Chunk.h"
 #include "Sockets.hpp"
+#include "SegmentCache.hpp"
+
+#include <sstream>
 
 using namespace adaptative::http;
 
 const uint64_t  HTTPConnectionManager::CHUNKDEFAULTBITRATE    = 1;
+const size_t    HTTPConnectionManager::MAXCONNECTIONS         = 8;
+const mtime_t   HTTPConnectionManager::IDLETIMEOUT            = CLOCK_FREQ * 15;
 
 HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *stream) :
-                       stream                   (stream)
+                       stream                   (stream),
+                       pipelining               (false),
+                       cache                    (NULL),
+                       connectCount             (0),
+                       reuseCount               (0),
+                       pipelineCount            (0)
 {
+    vlc_mutex_init(&lock);
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
+    msg_Dbg(stream, "HTTP connections: %u opened, %u reused, %u pipelined requests",
+            connectCount, reuseCount, pipelineCount);
     this->closeAllConnections();
+    delete cache;
+    vlc_mutex_destroy(&lock);
 }
 
 void HTTPConnectionManager::closeAllConnections      ()
 {
     releaseAllConnections();
+    vlc_mutex_lock(&lock);
+    idlePool.clear();
     vlc_delete_all(this->connectionPool);
+    vlc_mutex_unlock(&lock);
 }
 
 void HTTPConnectionManager::releaseAllConnections()
 {
+    vlc_mutex_lock(&lock);
     std::vector<HTTPConnection *>::iterator it;
     for(it = connectionPool.begin(); it != connectionPool.end(); ++it)
         (*it)->releaseChunk();
+    vlc_mutex_unlock(&lock);
+}
+
+void HTTPConnectionManager::setPipelining(bool b)
+{
+    pipelining = b;
+}
+
+bool HTTPConnectionManager::isPipelining() const
+{
+    return pipelining;
+}
+
+void HTTPConnectionManager::setCache(SegmentCache *cache_)
+{
+    delete cache;
+    cache = cache_;
+}
+
+bool HTTPConnectionManager::canCache(size_t size) const
+{
+    return cache && size > 0 && size <= cache->getMaxSize();
+}
+
+std::string HTTPConnectionManager::cacheKey(const Chunk *chunk)
+{
+    std::stringstream ss;
+    ss << chunk->getUrl() << "@" << chunk->getStartByte() << "-" << chunk->getEndByte();
+    return ss.str();
+}
+
+/* Returns the whole chunk content, if we already downloaded it */
+block_t * HTTPConnectionManager::getCachedChunk(Chunk *chunk)
+{
+    if(!cache)
+        return NULL;
+    return cache->get(cacheKey(chunk));
+}
+
+void HTTPConnectionManager::cacheChunk(Chunk *chunk, block_t *block)
+{
+    if(cache)
+        cache->put(cacheKey(chunk), block);
+    else
+        block_Release(block);
+}
+
+std::string HTTPConnectionManager::connectionKey(const Chunk *chunk)
+{
+    std::stringstream ss;
+    ss << chunk->getScheme() << "://" << chunk->getHostname() << ":" << chunk->getPort();
+    return ss.str();
 }
 
-HTTPConnection * HTTPConnectionManager::getConnectionForHost(const std::string &hostname)
+void HTTPConnectionManager::deleteConnection(HTTPConnection *conn)
 {
-    std::vector<HTTPConnection *>::const_iterator it;
+    std::vector<HTTPConnection *>::iterator it;
     for(it = connectionPool.begin(); it != connectionPool.end(); ++it)
     {
-        if(!(*it)->getHostname().compare(hostname) && (*it)->isAvailable())
-            return *it;
+        if(*it == conn)
+        {
+            connectionPool.erase(it);
+            break;
+        }
+    }
+    delete conn;
+}
+
+void HTTPConnectionManager::releaseChunk(Chunk *chunk)
+{
+    vlc_mutex_lock(&lock);
+    HTTPConnection *conn = chunk->getConnection();
+    if(conn)
+    {
+        conn->releaseChunk();
+        if(conn->isAvailable())
+        {
+            if(conn->connected() && conn->isPersistent() &&
+               connectionPool.size() <= MAXCONNECTIONS)
+            {
+                IdleConnection idle;
+                idle.conn = conn;
+                idle.since = mdate();
+                idlePool[connectionKey(chunk)].push_front(idle);
+            }
+            else
+                deleteConnection(conn);
+        }
     }
-    return NULL;
+    vlc_mutex_unlock(&lock);
+}
+
+HTTPConnection * HTTPConnectionManager::getIdleConnection(const std::string &key)
+{
+    std::map<std::string, IdleList>::iterator it = idlePool.find(key);
+    if(it == idlePool.end())
+        return NULL;
+
+    HTTPConnection *conn = NULL;
+    if(!it->second.empty())
+    {
+        conn = it->second.front().conn;
+        it->second.pop_front();
+    }
+    if(it->second.empty())
+        idlePool.erase(it);
+    return conn;
+}
+
+void HTTPConnectionManager::pruneIdleConnections(mtime_t now)
+{
+    std::map<std::string, IdleList>::iterator it = idlePool.begin();
+    while(it != idlePool.end())
+    {
+        IdleList &list = it->second;
+        while(!list.empty() && now - list.back().since > IDLETIMEOUT)
+        {
+            deleteConnection(list.back().conn);
+            list.pop_back();
+        }
+        if(list.empty())
+            idlePool.erase(it++);
+        else
+            ++it;
+    }
+}
+
+bool HTTPConnectionManager::removeOldestIdle()
+{
+    std::map<std::string, IdleList>::iterator it, oldest = idlePool.end();
+    for(it = idlePool.begin(); it != idlePool.end(); ++it)
+    {
+        if(oldest == idlePool.end() ||
+           it->second.back().since < oldest->second.back().since)
+            oldest = it;
+    }
+    if(oldest == idlePool.end())
+        return false;
+
+    deleteConnection(oldest->second.back().conn);
+    oldest->second.pop_back();
+    if(oldest->second.empty())
+        idlePool.erase(oldest);
+    return true;
 }
 
 bool HTTPConnectionManager::connectChunk(Chunk *chunk)
@@ -77,29 +229,60 @@ bool HTTPConnectionManager::connectChunk(Chunk *chunk)
     msg_Dbg(stream, "Retrieving %s @%zu", chunk->getUrl().c_str(),
             chunk->getStartByte());
 
-    HTTPConnection *conn = getConnectionForHost(chunk->getHostname());
+    if(chunk->getBitrate() <= 0)
+        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+
+    vlc_mutex_lock(&lock);
+    pruneIdleConnections(mdate());
+
+    HTTPConnection *conn = getIdleConnection(connectionKey(chunk));
+    if(conn)
+    {
+        conn->bindChunk(chunk);
+        reuseCount++;
+        vlc_mutex_unlock(&lock);
+        return true;
+    }
+
+    while(connectionPool.size() >= MAXCONNECTIONS && removeOldestIdle());
+
+    const bool tls = (chunk->getScheme() == "https");
+    Socket *socket = tls ? new (std::nothrow) TLSSocket(): new (std::nothrow) Socket();
+    if(!socket)
+    {
+        vlc_mutex_unlock(&lock);
+        return false;
+    }
+    conn = new (std::nothrow) HTTPConnection(stream, socket, chunk, true);
     if(!conn)
     {
-        const bool tls = (chunk->getScheme() == "https");
-        Socket *socket = tls ? new (std::nothrow) TLSSocket(): new (std::nothrow) Socket();
-        if(!socket)
-            return false;
-        /* disable pipelined tls until we have ticket/resume session support */
-        conn = new (std::nothrow) HTTPConnection(stream, socket, chunk, !tls);
-        if(!conn)
-        {
-            delete socket;
-            return false;
-        }
-        connectionPool.push_back(conn);
-        if (!chunk->getConnection()->connect(chunk->getHostname(), chunk->getPort()))
-            return false;
+        vlc_mutex_unlock(&lock);
+        delete socket;
+        return false;
     }
+    connectionPool.push_back(conn);
+    connectCount++;
+    vlc_mutex_unlock(&lock);
 
-    conn->bindChunk(chunk);
+    /* connection is bound to our chunk, can't be picked by others */
+    return conn->connect(chunk->getHostname(), chunk->getPort());
+}
 
-    if(chunk->getBitrate() <= 0)
-        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+/* Sends next chunk request on the connection still reading current one */
+bool HTTPConnectionManager::pipelineChunk(Chunk *current, Chunk *next)
+{
+    if(!pipelining || next->getConnection())
+        return false;
 
-    return true;
+    vlc_mutex_lock(&lock);
+    HTTPConnection *conn = current->getConnection();
+    bool b_ret = conn && conn->pipeline(next);
+    if(b_ret)
+    {
+        if(next->getBitrate() <= 0)
+            next->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+        pipelineCount++;
+    }
+    vlc_mutex_unlock(&lock);
+    return b_ret;
 }
@@ -32,6 +32,8 @@
 #include <vlc_common.h>
 #include <vector>
 #include <string>
+#include <list>
+#include <map>
 
 namespace adaptative
 {
@@ -39,6 +41,7 @@ namespace adaptative
     {
         class HTTPConnection;
         class Chunk;
+        class SegmentCache;
 
         class HTTPConnectionManager
         {
@@ -49,14 +52,46 @@ namespace adaptative
                 void    closeAllConnections ();
                 void    releaseAllConnections ();
                 bool    connectChunk        (Chunk *chunk);
+                bool    pipelineChunk       (Chunk *current, Chunk *next);
+                void    releaseChunk        (Chunk *chunk);
+                void    setPipelining       (bool);
+                bool    isPipelining        () const;
+                void    setCache            (SegmentCache *);
+                bool    canCache            (size_t) const;
+                block_t *getCachedChunk     (Chunk *);
+                void    cacheChunk          (Chunk *, block_t *);
 
             private:
+                /* kept alive connections, most recently used first */
+                class IdleConnection
+                {
+                    public:
+                        HTTPConnection *conn;
+                        mtime_t         since;
+                };
+                typedef std::list<IdleConnection> IdleList;
+
                 std::vector<HTTPConnection *>                       connectionPool;
+                std::map<std::string, IdleList>                     idlePool;
                 vlc_object_t                                       *stream;
+                vlc_mutex_t                                         lock;
+                bool                                                pipelining;
+                SegmentCache                                       *cache;
+
+                unsigned                                            connectCount;
+                unsigned                                            reuseCount;
+                unsigned                                            pipelineCount;
 
                 static const uint64_t   CHUNKDEFAULTBITRATE;
+                static const size_t     MAXCONNECTIONS;
+                static const mtime_t    IDLETIMEOUT;
 
-                HTTPConnection * getConnectionForHost    (const std::string &hostname);
+                static std::string connectionKey(const Chunk *);
+                static std::string cacheKey(const Chunk *);
+                HTTPConnection * getIdleConnection  (const std::string &);
+                void             pruneIdleConnections(mtime_t);
+                bool             removeOldestIdle   ();
+                void             deleteConnection   (HTTPConnection *);
         };
     }
 }
@@ -0,0 +1,182 @@
+/*
+ * SegmentCache.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SegmentCache.hpp"
+
+#include <vlc_fs.h>
+#include <sstream>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace adaptative::http;
+
+SegmentCache::SegmentCache(vlc_object_t *obj_, size_t maxsize_, const std::string &dir_) :
+    obj         (obj_),
+    size        (0),
+    maxsize     (maxsize_),
+    dir         (dir_),
+    fileid      (0),
+    hits        (0),
+    misses      (0),
+    evictions   (0),
+    hitbytes    (0)
+{
+    vlc_mutex_init(&lock);
+}
+
+SegmentCache::~SegmentCache()
+{
+    msg_Dbg(obj, "segment cache: %u hits (%" PRIu64 " bytes), %u misses, %u evictions",
+            hits, hitbytes, misses, evictions);
+    while(!entries.empty())
+        drop(--entries.end());
+    vlc_mutex_destroy(&lock);
+}
+
+size_t SegmentCache::getMaxSize() const
+{
+    return maxsize;
+}
+
+void SegmentCache::drop(EntryList::iterator it)
+{
+    if((*it).data)
+        block_Release((*it).data);
+    if(!(*it).path.empty())
+        vlc_unlink((*it).path.c_str());
+    size -= (*it).size;
+    index.erase((*it).key);
+    entries.erase(it);
+}
+
+block_t * SegmentCache::load(const Entry &entry) const
+{
+    if(entry.data)
+        return block_Duplicate(entry.data);
+
+    FILE *file = vlc_fopen(entry.path.c_str(), "rb");
+    if(!file)
+        return NULL;
+
+    block_t *block = block_Alloc(entry.size);
+    if(block && fread(block->p_buffer, 1, entry.size, file) != entry.size)
+    {
+        block_Release(block);
+        block = NULL;
+    }
+    fclose(file);
+    return block;
+}
+
+bool SegmentCache::store(Entry &entry, block_t *block)
+{
+    if(dir.empty())
+    {
+        entry.data = block;
+        return true;
+    }
+
+    std::stringstream ss;
+    ss << dir << DIR_SEP << "vlc-segment-" << getpid() << "-" << fileid++;
+    entry.path = ss.str();
+
+    FILE *file = vlc_fopen(entry.path.c_str(), "wb");
+    if(!file)
+    {
+        entry.path.clear();
+        return false;
+    }
+    bool b_ok = fwrite(block->p_buffer, 1, block->i_buffer, file) == block->i_buffer;
+    if(fclose(file) || !b_ok)
+    {
+        vlc_unlink(entry.path.c_str());
+        entry.path.clear();
+        return false;
+    }
+    block_Release(block);
+    return true;
+}
+
+block_t * SegmentCache::get(const std::string &key)
+{
+    block_t *block = NULL;
+
+    vlc_mutex_lock(&lock);
+    std::map<std::string, EntryList::iterator>::iterator it = index.find(key);
+    if(it != index.end())
+    {
+        /* move to front */
+        entries.splice(entries.begin(), entries, it->second);
+        block = load(entries.front());
+        if(block)
+        {
+            hits++;
+            hitbytes += block->i_buffer;
+        }
+        else /* lost file */
+        {
+            drop(entries.begin());
+        }
+    }
+    if(!block)
+        misses++;
+    vlc_mutex_unlock(&lock);
+
+    return block;
+}
+
+/* takes ownership of the block */
+void SegmentCache::put(const std::string &key, block_t *block)
+{
+    if(block->i_buffer == 0 || block->i_buffer > maxsize)
+    {
+        block_Release(block);
+        return;
+    }
+
+    vlc_mutex_lock(&lock);
+    if(index.find(key) == index.end())
+    {
+        while(!entries.empty() && size + block->i_buffer > maxsize)
+        {
+            drop(--entries.end());
+            evictions++;
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.size = block->i_buffer;
+        entry.data = NULL;
+        if(store(entry, block))
+        {
+            entries.push_front(entry);
+            index[key] = entries.begin();
+            size += entry.size;
+            block = NULL;
+        }
+    }
+    vlc_mutex_unlock(&lock);
+
+    if(block)
+        block_Release(block);
+}
@@ -0,0 +1,81 @@
+/*
+ * SegmentCache.hpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef SEGMENTCACHE_HPP
+#define SEGMENTCACHE_HPP
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <string>
+#include <list>
+#include <map>
+
+namespace adaptative
+{
+    namespace http
+    {
+        /* Keeps downloaded segments, in memory or as files in a directory,
+         * least recently used ones being evicted first */
+        class SegmentCache
+        {
+            public:
+                SegmentCache(vlc_object_t *, size_t maxsize, const std::string &dir);
+                ~SegmentCache();
+
+                block_t *   get (const std::string &key);
+                void        put (const std::string &key, block_t *);
+                size_t      getMaxSize() const;
+
+            private:
+                class Entry
+                {
+                    public:
+                        std::string key;
+                        size_t      size;
+                        block_t    *data; /* memory storage */
+                        std::string path; /* or disk storage */
+                };
+                typedef std::list<Entry> EntryList;
+
+                void drop(EntryList::iterator);
+                block_t * load(const Entry &) const;
+                bool store(Entry &, block_t *);
+
+                vlc_object_t                               *obj;
+                vlc_mutex_t                                 lock;
+                EntryList                                   entries; /* most recent first */
+                std::map<std::string, EntryList::iterator>  index;
+                size_t                                      size;
+                size_t                                      maxsize;
+                std::string                                 dir;
+                unsigned                                    fileid;
+
+                unsigned                                    hits;
+                unsigned                                    misses;
+                unsigned                                    evictions;
+                uint64_t                                    hitbytes;
+        };
+    }
+}
+
+#endif // SEGMENTCACHE_HPP
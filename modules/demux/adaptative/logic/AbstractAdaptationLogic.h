@@ -48,6 +48,7 @@ namespace adaptative
 
                 virtual BaseRepresentation* getCurrentRepresentation(StreamType, BasePeriod *) const = 0;
                 virtual void                updateDownloadRate     (size_t, mtime_t);
+                virtual void                updateBufferLevel      (mtime_t, mtime_t);
 
                 enum LogicType
                 {
@@ -55,7 +56,8 @@ namespace adaptative
                     AlwaysBest,
                     AlwaysLowest,
                     RateBased,
-                    FixedRate
+                    FixedRate,
+                    BufferBased
                 };
         };
     }
@@ -0,0 +1,167 @@
+/*
+ * BufferBasedAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.hpp"
+#include "Representationselectors.hpp"
+
+#include "../playlist/BaseRepresentation.h"
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BasePeriod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace adaptative::logic;
+using namespace adaptative::playlist;
+
+/* Buffer level under which we only rely on throughput */
+#define MIN_BUFFER_LEVEL    (CLOCK_FREQ * 10)
+/* Used when the downloader has no duration limit */
+#define DEFAULT_BUFFER_TARGET (CLOCK_FREQ * 30)
+/* Only use that part of the estimated throughput */
+#define THROUGHPUT_SAFETY   0.9
+
+BufferBasedAdaptationLogic::Ewma::Ewma(mtime_t halflife_)
+{
+    halflife = halflife_;
+    totaltime = 0;
+    estimate = 0.0;
+}
+
+void BufferBasedAdaptationLogic::Ewma::push(double value, mtime_t time)
+{
+    double alpha = pow(0.5, (double) time / halflife);
+    estimate = alpha * estimate + (1.0 - alpha) * value;
+    totaltime += time;
+}
+
+double BufferBasedAdaptationLogic::Ewma::get() const
+{
+    /* unbias towards the 0 initial value */
+    double zerofactor = 1.0 - pow(0.5, (double) totaltime / halflife);
+    return (zerofactor > 0.0) ? estimate / zerofactor : 0.0;
+}
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic() :
+    AbstractAdaptationLogic(),
+    fastEstimate(CLOCK_FREQ * 2),
+    slowEstimate(CLOCK_FREQ * 10)
+{
+    bufferLevel = 0;
+    bufferTarget = DEFAULT_BUFFER_TARGET;
+    startup = true;
+}
+
+uint64_t BufferBasedAdaptationLogic::getThroughput() const
+{
+    /* be conservative: fast to drop, slow to raise */
+    double bps = std::min(fastEstimate.get(), slowEstimate.get());
+    return (uint64_t) (bps * THROUGHPUT_SAFETY);
+}
+
+void BufferBasedAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
+{
+    if(unlikely(time <= 0))
+        return;
+
+    double bps = (double) size * 8 * CLOCK_FREQ / time;
+    fastEstimate.push(bps, time);
+    slowEstimate.push(bps, time);
+}
+
+void BufferBasedAdaptationLogic::updateBufferLevel(mtime_t level, mtime_t capacity)
+{
+    bufferLevel = level;
+    bufferTarget = (capacity > 0) ? capacity : DEFAULT_BUFFER_TARGET;
+    if(bufferLevel >= std::min((mtime_t)MIN_BUFFER_LEVEL, bufferTarget / 2))
+        startup = false;
+}
+
+BaseRepresentation *BufferBasedAdaptationLogic::getCurrentRepresentation(StreamType type, BasePeriod *period) const
+{
+    if(period == NULL)
+        return NULL;
+
+    RepresentationSelector selector;
+    BaseRepresentation *throughputRep = selector.select(period, type, getThroughput());
+    if(startup || throughputRep == NULL)
+        return throughputRep;
+
+    std::vector<BaseRepresentation *> reps;
+    std::vector<BaseAdaptationSet *> adaptSets = period->getAdaptationSets(type);
+    std::vector<BaseAdaptationSet *>::const_iterator adaptIt;
+    for(adaptIt=adaptSets.begin(); adaptIt!=adaptSets.end(); ++adaptIt)
+    {
+        std::vector<BaseRepresentation *> &setreps = (*adaptIt)->getRepresentations();
+        reps.insert(reps.end(), setreps.begin(), setreps.end());
+    }
+
+    uint64_t minbw = 0, maxbw = 0;
+    std::vector<BaseRepresentation *>::const_iterator repIt;
+    for(repIt=reps.begin(); repIt!=reps.end(); ++repIt)
+    {
+        uint64_t bw = (*repIt)->getBandwidth();
+        if(bw == 0)
+            continue;
+        if(minbw == 0 || bw < minbw)
+            minbw = bw;
+        if(bw > maxbw)
+            maxbw = bw;
+    }
+    if(minbw == 0 || minbw == maxbw)
+        return throughputRep;
+
+    /* BOLA: utility is log of bitrate, shifted so lowest is 1.
+     * V and gamma*p are set so the lowest representation is picked at
+     * the minimum buffer level, and the highest one when reaching target */
+    const double target = (double) bufferTarget / CLOCK_FREQ;
+    const double minlevel = std::min((double) MIN_BUFFER_LEVEL / CLOCK_FREQ, target / 2);
+    const double maxutility = log((double) maxbw / minbw) + 1.0;
+    const double gp = (maxutility - 1.0) / (target / minlevel - 1.0);
+    const double Vp = minlevel / gp;
+    const double level = (double) bufferLevel / CLOCK_FREQ;
+
+    BaseRepresentation *bolaRep = NULL;
+    double bestscore = 0.0;
+    for(repIt=reps.begin(); repIt!=reps.end(); ++repIt)
+    {
+        uint64_t bw = (*repIt)->getBandwidth();
+        if(bw == 0)
+            continue;
+        double utility = log((double) bw / minbw) + 1.0;
+        double score = (Vp * (utility + gp) - level) / bw;
+        if(bolaRep == NULL || score > bestscore)
+        {
+            bolaRep = *repIt;
+            bestscore = score;
+        }
+    }
+
+    /* Don't outrun the network while the buffer can't absorb it */
+    if(bolaRep->getBandwidth() > throughputRep->getBandwidth() &&
+       bufferLevel < bufferTarget / 2)
+        return throughputRep;
+
+    return bolaRep;
+}
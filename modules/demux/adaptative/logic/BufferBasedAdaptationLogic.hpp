@@ -0,0 +1,66 @@
+/*
+ * BufferBasedAdaptationLogic.hpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef BUFFERBASEDADAPTATIONLOGIC_HPP
+#define BUFFERBASEDADAPTATIONLOGIC_HPP
+
+#include "AbstractAdaptationLogic.h"
+
+namespace adaptative
+{
+    namespace logic
+    {
+        /* BOLA-like logic: picks the representation maximizing a buffer
+         * level driven utility, falling back to a smoothed throughput
+         * estimate while the buffer is filling or running low. */
+        class BufferBasedAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                BufferBasedAdaptationLogic();
+
+                virtual BaseRepresentation* getCurrentRepresentation(StreamType, BasePeriod *) const;
+                virtual void updateDownloadRate(size_t, mtime_t);
+                virtual void updateBufferLevel(mtime_t, mtime_t);
+
+            private:
+                uint64_t getThroughput() const;
+
+                class Ewma
+                {
+                    public:
+                        Ewma(mtime_t);
+                        void    push(double, mtime_t);
+                        double  get() const;
+
+                    private:
+                        mtime_t halflife;
+                        mtime_t totaltime;
+                        double  estimate;
+                };
+
+                Ewma                    fastEstimate;
+                Ewma                    slowEstimate;
+                mtime_t                 bufferLevel;
+                mtime_t                 bufferTarget;
+                bool                    startup;
+        };
+    }
+}
+
+#endif // BUFFERBASEDADAPTATIONLOGIC_HPP
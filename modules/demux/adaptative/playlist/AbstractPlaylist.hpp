@@ -56,6 +56,10 @@ namespace adaptative
                 void                mergeWith(AbstractPlaylist *, mtime_t = 0);
                 void                getTimeLinesBoundaries(mtime_t *, mtime_t *) const;
 
+                /* serializes segments lookups against updates */
+                void                lock();
+                void                unlock();
+
                 Property<time_t>                    duration;
                 Property<time_t>                    playbackStart;
                 Property<time_t>                    availabilityEndTime;
@@ -70,6 +74,9 @@ namespace adaptative
                 std::vector<BasePeriod *>           periods;
                 std::vector<std::string>            baseUrls;
                 std::string                         type;
+
+            private:
+                vlc_mutex_t                         updatelock;
         };
     }
 }
@@ -176,7 +176,13 @@ bool SegmentInformation::getSegmentNumberByTime(mtime_t time, uint64_t *ret) con
     {
         uint64_t timescale = mediaTemplate->inheritTimescale();
         mtime_t duration = mediaTemplate->duration.Get();
-        if(duration)
+        const SegmentTimeline *timeline = mediaTemplate->segmentTimeline.Get();
+        if(timeline)
+        {
+            *ret = timeline->getElementNumberByScaledPlaybackTime(time * timescale / CLOCK_FREQ);
+            return true;
+        }
+        else if(duration)
         {
             *ret = time / (CLOCK_FREQ * duration / timescale);
             return true;
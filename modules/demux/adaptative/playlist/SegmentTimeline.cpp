@@ -36,106 +36,88 @@ SegmentTimeline::SegmentTimeline(TimescaleAble *parent)
 
 SegmentTimeline::~SegmentTimeline()
 {
-    std::list<Element *>::iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-        delete *it;
 }
 
-void SegmentTimeline::addElement(mtime_t d, uint64_t r, mtime_t t)
+void SegmentTimeline::append(const Element &element)
 {
-    Element *element = new (std::nothrow) Element(d, r, t);
-    if(element)
-    {
-        if(!elements.empty() && !t)
-        {
-            const Element *el = elements.back();
-            element->t = el->t + (el->d * (el->r + 1));
-        }
-        elements.push_back(element);
-    }
+    elements.push_back(element);
+    Element &el = elements.back();
+    if(elements.size() > 1)
+        el.number = elements[elements.size() - 2].number + elements[elements.size() - 2].count();
+    else
+        el.number = pruned;
 }
 
-uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(time_t scaled) const
+void SegmentTimeline::addElement(mtime_t d, uint64_t r, mtime_t t)
 {
-    uint64_t count = 0;
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
-        for(uint64_t repeat = 1 + el->r; repeat; repeat--)
-        {
-            if(el->d >= scaled)
-                return count;
+    Element element(d, r, t);
+    if(!elements.empty() && !t)
+        element.t = elements.back().end();
+    append(element);
+}
 
-            scaled -= el->d;
-            count++;
-        }
-    }
-    count += pruned;
-    return count;
+uint64_t SegmentTimeline::getElementNumberByScaledPlaybackTime(mtime_t scaled) const
+{
+    if(elements.empty())
+        return pruned;
+
+    /* last element starting before or at that time */
+    std::vector<Element>::const_iterator it =
+            std::upper_bound(elements.begin(), elements.end(), scaled,
+                             Element::compareTime);
+    if(it == elements.begin())
+        return elements.front().number;
+    --it;
+
+    const Element &el = *it;
+    if(scaled >= el.end() || el.d == 0)
+        return el.number + el.count();
+    return el.number + (scaled - el.t) / el.d;
 }
 
 mtime_t SegmentTimeline::getScaledPlaybackTimeByElementNumber(uint64_t number) const
 {
-    mtime_t totalscaledtime = 0;
-
-    if(number < pruned)
+    if(number < pruned || elements.empty())
         return 0;
 
-    number -= pruned;
+    std::vector<Element>::const_iterator it =
+            std::upper_bound(elements.begin(), elements.end(), number,
+                             Element::compareNumber);
+    --it;
 
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-    {
-        const Element *el = *it;
-
-        if(number == 0)
-        {
-            totalscaledtime = el->t;
-            break;
-        }
-        else if(number <= el->r)
-        {
-            totalscaledtime = el->t + (number * el->d);
-            break;
-        }
-        else
-        {
-            number -= el->r + 1;
-        }
-    }
-
-    return totalscaledtime;
+    const Element &el = *it;
+    number -= el.number;
+    if(number > el.r)
+        return 0;
+    return el.t + (number * el.d);
 }
 
 size_t SegmentTimeline::maxElementNumber() const
 {
-    size_t count = 0;
-
-    std::list<Element *>::const_iterator it;
-    for(it = elements.begin(); it != elements.end(); ++it)
-        count += (*it)->r + 1;
-
-    return pruned + count - 1;
+    if(elements.empty())
+        return pruned - 1;
+    const Element &last = elements.back();
+    return last.number + last.count() - 1;
 }
 
 size_t SegmentTimeline::prune(mtime_t time)
 {
     mtime_t scaled = time * inheritTimescale() / CLOCK_FREQ;
-    size_t prunednow = 0;
-    while(elements.size())
-    {
-        Element *el = elements.front();
-        if(el->t + (el->d * (mtime_t)(el->r + 1)) < scaled)
-        {
-            prunednow += el->r + 1;
-            delete el;
-            elements.pop_front();
-        }
-        else
-            break;
-    }
 
+    /* only drop whole elements ending before the barrier */
+    std::vector<Element>::iterator it =
+            std::lower_bound(elements.begin(), elements.end(), scaled,
+                             Element::compareEnd);
+    if(it == elements.begin())
+        return 0;
+
+    size_t prunednow;
+    if(it == elements.end())
+        prunednow = maxElementNumber() + 1 - pruned;
+    else
+        prunednow = it->number - pruned;
+
+    elements.erase(elements.begin(), it);
     pruned += prunednow;
     return prunednow;
 }
@@ -144,64 +126,55 @@ void SegmentTimeline::mergeWith(SegmentTimeline &other)
 {
     if(elements.empty())
     {
-        while(other.elements.size())
-        {
-            elements.push_back(other.elements.front());
-            other.elements.pop_front();
-        }
+        std::vector<Element>::const_iterator it;
+        for(it = other.elements.begin(); it != other.elements.end(); ++it)
+            append(*it);
+        other.elements.clear();
         return;
     }
 
-    Element *last = elements.back();
-    while(other.elements.size())
+    /* Updates only overlap our tail: skip everything older than our
+     * last element, which is the only one that can still change */
+    std::vector<Element>::const_iterator it =
+            std::upper_bound(other.elements.begin(), other.elements.end(),
+                             elements.back().t, Element::compareTime);
+    if(it != other.elements.begin() && (it - 1)->t == elements.back().t)
+        --it;
+
+    for(; it != other.elements.end(); ++it)
     {
-        Element *el = other.elements.front();
-        other.elements.pop_front();
-        if(el->t == last->t) /* Same element, but prev could have been middle of repeat */
+        Element &last = elements.back();
+        const Element &el = *it;
+        if(el.t == last.t) /* Same element, but prev could have been middle of repeat */
         {
-            last->r = std::max(last->r, el->r);
-            delete el;
+            last.r = std::max(last.r, el.r);
         }
-        else if(el->t > last->t) /* Did not exist in previous list */
+        else if( el.t - last.t >= last.d * (mtime_t)(last.r + 1) ) /* Did not exist in previous list */
         {
-            if( el->t - last->t >= last->d * (mtime_t)(last->r + 1) )
-            {
-                elements.push_back(el);
-                last = el;
-            }
-            else if(last->d == el->d) /* should always be in that case */
-            {
-                last->r = ((el->t - last->t) / last->d) - 1;
-                elements.push_back(el);
-                last = el;
-            }
-            else
-            {
-                /* borked: skip */
-                delete el;
-            }
+            append(el);
         }
-        else
+        else if(last.d == el.d) /* should always be in that case */
         {
-            delete el;
+            last.r = ((el.t - last.t) / last.d) - 1;
+            append(el);
         }
+        /* else borked: skip */
     }
+    other.elements.clear();
 }
 
 mtime_t SegmentTimeline::start() const
 {
     if(elements.empty())
         return 0;
-    return CLOCK_FREQ * elements.front()->t / inheritTimescale();
+    return CLOCK_FREQ * elements.front().t / inheritTimescale();
 }
 
 mtime_t SegmentTimeline::end() const
 {
     if(elements.empty())
         return 0;
-    const Element *last = elements.back();
-    mtime_t scaled = last->t + last->d * (last->r + 1);
-    return CLOCK_FREQ * scaled / inheritTimescale();
+    return CLOCK_FREQ * elements.back().end() / inheritTimescale();
 }
 
 SegmentTimeline::Element::Element(mtime_t d_, uint64_t r_, mtime_t t_)
@@ -209,4 +182,30 @@ SegmentTimeline::Element::Element(mtime_t d_, uint64_t r_, mtime_t t_)
     d = d_;
     t = t_;
     r = r_;
+    number = 0;
+}
+
+mtime_t SegmentTimeline::Element::end() const
+{
+    return t + d * (mtime_t)(r + 1);
+}
+
+uint64_t SegmentTimeline::Element::count() const
+{
+    return r + 1;
+}
+
+bool SegmentTimeline::Element::compareTime(mtime_t t, const Element &el)
+{
+    return t < el.t;
+}
+
+bool SegmentTimeline::Element::compareNumber(uint64_t number, const Element &el)
+{
+    return number < el.number;
+}
+
+bool SegmentTimeline::Element::compareEnd(const Element &el, mtime_t t)
+{
+    return el.end() < t;
 }
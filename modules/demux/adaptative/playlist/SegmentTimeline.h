@@ -30,7 +30,7 @@
 
 #include "SegmentInfoCommon.h"
 #include <vlc_common.h>
-#include <list>
+#include <vector>
 
 namespace adaptative
 {
@@ -38,13 +38,26 @@ namespace adaptative
     {
         class SegmentTimeline : public TimescaleAble
         {
-            class Element;
+            class Element
+            {
+                public:
+                    Element(mtime_t, uint64_t, mtime_t);
+                    mtime_t  t;
+                    mtime_t  d;
+                    uint64_t r;
+                    uint64_t number; /* of first repeat, pruned ones included */
+                    mtime_t  end() const;
+                    uint64_t count() const;
+                    static bool compareTime(mtime_t, const Element &);
+                    static bool compareNumber(uint64_t, const Element &);
+                    static bool compareEnd(const Element &, mtime_t);
+            };
 
             public:
                 SegmentTimeline(TimescaleAble * = NULL);
                 virtual ~SegmentTimeline();
                 void addElement(mtime_t d, uint64_t r = 0, mtime_t t = 0);
-                uint64_t getElementNumberByScaledPlaybackTime(time_t) const;
+                uint64_t getElementNumberByScaledPlaybackTime(mtime_t) const;
                 mtime_t getScaledPlaybackTimeByElementNumber(uint64_t) const;
                 size_t maxElementNumber() const;
                 size_t prune(mtime_t);
@@ -53,17 +66,12 @@ namespace adaptative
                 mtime_t end() const;
 
             private:
-                std::list<Element *> elements;
+                /* Sorted by both start time and number, so lookups
+                 * are binary searches */
+                std::vector<Element> elements;
                 size_t pruned;
 
-                class Element
-                {
-                    public:
-                        Element(mtime_t, uint64_t, mtime_t);
-                        mtime_t  t;
-                        mtime_t  d;
-                        uint64_t r;
-                };
+                void append(const Element &);
         };
     }
 }
@@ -36,7 +36,6 @@
 
 #include "DASHManager.h"
 #include "mpd/MPDFactory.h"
-#include "xml/DOMParser.h"
 #include "../adaptative/logic/RateBasedAdaptationLogic.h"
 #include <vlc_stream.h>
 
@@ -51,6 +50,18 @@ DASHManager::DASHManager(MPD *mpd,
                          AbstractAdaptationLogic::LogicType type, stream_t *stream) :
              PlaylistManager(mpd, type, stream)
 {
+    prefetchSegments = var_InheritInteger(stream, "dash-prefetch-segments");
+    prefetchLength = CLOCK_FREQ * var_InheritInteger(stream, "dash-prefetch-length");
+    httpPipelining = var_InheritBool(stream, "dash-http-pipelining");
+    uint64_t cachemax = 1024 * 1024 *
+            (uint64_t) __MAX(var_InheritInteger(stream, "dash-cache-size"), 0);
+    cacheSize = (cachemax > SIZE_MAX) ? SIZE_MAX : cachemax;
+    char *psz_dir = var_InheritString(stream, "dash-cache-dir");
+    if(psz_dir)
+    {
+        cacheDir = psz_dir;
+        free(psz_dir);
+    }
 }
 
 DASHManager::~DASHManager   ()
@@ -77,13 +88,6 @@ bool DASHManager::updatePlaylist()
         if(!mpdstream)
             return false;
 
-        xml::DOMParser parser(mpdstream);
-        if(!parser.parse())
-        {
-            stream_Delete(mpdstream);
-            return false;
-        }
-
         mtime_t minsegmentTime = 0;
         for(int type=0; type<StreamTypeCount; type++)
         {
@@ -94,13 +98,15 @@ bool DASHManager::updatePlaylist()
                 minsegmentTime = segmentTime;
         }
 
-        MPD *newmpd = MPDFactory::create(parser.getRootNode(), mpdstream, parser.getProfile());
+        MPD *newmpd = MPDFactory::create(mpdstream, var_InheritBool(stream, "dash-dom-parser"));
+        stream_Delete(mpdstream);
         if(newmpd)
         {
+            playlist->lock();
             playlist->mergeWith(newmpd, minsegmentTime);
+            playlist->unlock();
             delete newmpd;
         }
-        stream_Delete(mpdstream);
     }
 
     /* Compute new MPD update time */
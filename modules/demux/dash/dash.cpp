@@ -69,12 +69,39 @@ static void Close   (vlc_object_t *);
 
 #define DASH_LOGIC_TEXT N_("Adaptation Logic")
 
+#define DASH_PREFETCH_SEGMENTS_TEXT N_("Segments to prefetch")
+#define DASH_PREFETCH_SEGMENTS_LONGTEXT N_("Number of segments downloaded ahead " \
+    "of playback. Each stream is downloaded by its own thread. With 0, a " \
+    "segment is only downloaded once the previous one has been read.")
+
+#define DASH_PREFETCH_LENGTH_TEXT N_("Prefetch duration (seconds)")
+#define DASH_PREFETCH_LENGTH_LONGTEXT N_("Maximum duration of segments " \
+    "downloaded ahead of playback. 0 for no limit.")
+
+#define DASH_PIPELINING_TEXT N_("HTTP pipelining")
+#define DASH_PIPELINING_LONGTEXT N_("Request the next segment on the same " \
+    "connection before the current one is fully received.")
+
+#define DASH_DOMPARSER_TEXT N_("Parse MPD as a tree")
+#define DASH_DOMPARSER_LONGTEXT N_("Build the whole XML tree before reading " \
+    "the MPD, instead of reading it while streaming. Slower, uses more memory.")
+
+#define DASH_CACHE_SIZE_TEXT N_("Segments cache size (MiB)")
+#define DASH_CACHE_SIZE_LONGTEXT N_("Keep downloaded segments so seeking " \
+    "back does not download them again. 0 disables the cache.")
+
+#define DASH_CACHE_DIR_TEXT N_("Segments cache directory")
+#define DASH_CACHE_DIR_LONGTEXT N_("Store cached segments as files in this " \
+    "directory, instead of memory.")
+
 static const int pi_logics[] = {AbstractAdaptationLogic::RateBased,
+                                AbstractAdaptationLogic::BufferBased,
                                 AbstractAdaptationLogic::FixedRate,
                                 AbstractAdaptationLogic::AlwaysLowest,
                                 AbstractAdaptationLogic::AlwaysBest};
 
 static const char *const ppsz_logics[] = { N_("Bandwidth Adaptive"),
+                                           N_("Buffer Based (BOLA)"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
                                            N_("Highest Bandwith/Quality")};
@@ -91,6 +118,21 @@ vlc_module_begin ()
         add_integer( "dash-prefwidth",  480, DASH_WIDTH_TEXT,  DASH_WIDTH_LONGTEXT,  true )
         add_integer( "dash-prefheight", 360, DASH_HEIGHT_TEXT, DASH_HEIGHT_LONGTEXT, true )
         add_integer( "dash-prefbw",     250, DASH_BW_TEXT,     DASH_BW_LONGTEXT,     false )
+        add_integer( "dash-prefetch-segments", 3, DASH_PREFETCH_SEGMENTS_TEXT,
+                     DASH_PREFETCH_SEGMENTS_LONGTEXT, true )
+            change_integer_range( 0, 100 )
+        add_integer( "dash-prefetch-length", 30, DASH_PREFETCH_LENGTH_TEXT,
+                     DASH_PREFETCH_LENGTH_LONGTEXT, true )
+            change_integer_range( 0, 3600 )
+        add_bool( "dash-http-pipelining", false, DASH_PIPELINING_TEXT,
+                  DASH_PIPELINING_LONGTEXT, true )
+        add_bool( "dash-dom-parser", false, DASH_DOMPARSER_TEXT,
+                  DASH_DOMPARSER_LONGTEXT, true )
+        add_integer( "dash-cache-size", 0, DASH_CACHE_SIZE_TEXT,
+                     DASH_CACHE_SIZE_LONGTEXT, true )
+            change_integer_range( 0, 65536 )
+        add_directory( "dash-cache-dir", NULL, DASH_CACHE_DIR_TEXT,
+                       DASH_CACHE_DIR_LONGTEXT, true )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -119,19 +161,10 @@ static int Open(vlc_object_t *p_obj)
     if(!b_mimematched && !DOMParser::isDash(p_demux->s))
         return VLC_EGENERIC;
 
-    //Build a XML tree
-    DOMParser        parser(p_demux->s);
-    if( !parser.parse() )
-    {
-        msg_Err( p_demux, "Could not parse MPD" );
-        return VLC_EGENERIC;
-    }
-
-    //Begin the actual MPD parsing:
-    MPD *mpd = MPDFactory::create(parser.getRootNode(), p_demux->s, parser.getProfile());
+    MPD *mpd = MPDFactory::create(p_demux->s, var_InheritBool(p_obj, "dash-dom-parser"));
     if(mpd == NULL)
     {
-        msg_Err( p_demux, "Cannot create/unknown MPD for profile");
+        msg_Err( p_demux, "Could not parse MPD or unknown profile" );
         return VLC_EGENERIC;
     }
 
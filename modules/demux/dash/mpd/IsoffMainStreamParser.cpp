@@ -0,0 +1,647 @@
+/*
+ * IsoffMainStreamParser.cpp
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "IsoffMainStreamParser.h"
+#include "IsoffMainParser.h"
+#include "../adaptative/playlist/SegmentTemplate.h"
+#include "../adaptative/playlist/Segment.h"
+#include "../adaptative/playlist/SegmentBase.h"
+#include "../adaptative/playlist/SegmentList.h"
+#include "../adaptative/playlist/SegmentTimeline.h"
+#include "MPD.h"
+#include "Representation.h"
+#include "Period.h"
+#include "AdaptationSet.h"
+#include "ProgramInformation.h"
+#include "DASHSegment.h"
+#include <vlc_stream.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+using namespace dash::mpd;
+using namespace adaptative::playlist;
+
+IsoffMainStreamParser::Element::Element(ElementType type_, SegmentInformation *info_)
+{
+    type = type_;
+    info = info_;
+    seen = 0;
+}
+
+IsoffMainStreamParser::IsoffMainStreamParser(stream_t *stream) :
+    p_stream( stream ),
+    vlc_xml( NULL ),
+    vlc_reader( NULL ),
+    mpd( NULL ),
+    programInfo( NULL ),
+    period( NULL ),
+    adaptationSet( NULL ),
+    segmentBase( NULL ),
+    segmentList( NULL ),
+    mediaTemplate( NULL ),
+    timeline( NULL ),
+    listStartTime( 0 )
+{
+}
+
+IsoffMainStreamParser::~IsoffMainStreamParser()
+{
+    if(vlc_reader)
+        xml_ReaderDelete(vlc_reader);
+    if(vlc_xml)
+        xml_Delete(vlc_xml);
+}
+
+MPD * IsoffMainStreamParser::getMPD()
+{
+    return mpd;
+}
+
+bool IsoffMainStreamParser::parse()
+{
+    vlc_xml = xml_Create(p_stream);
+    if(!vlc_xml)
+        return false;
+
+    vlc_reader = xml_ReaderCreate(vlc_xml, p_stream);
+    if(!vlc_reader)
+        return false;
+
+    const char *data;
+    int type;
+    bool b_done = false;
+    bool b_error = false;
+
+    while(!b_done && !b_error &&
+          (type = xml_ReaderNextNode(vlc_reader, &data)) > 0)
+    {
+        switch(type)
+        {
+            case XML_READER_STARTELEM:
+            {
+                bool empty = xml_ReaderIsEmptyElement(vlc_reader);
+                if(!startElement(data))
+                {
+                    b_error = true;
+                    break;
+                }
+                if(empty)
+                    endElement();
+                b_done = elements.empty();
+                break;
+            }
+
+            case XML_READER_TEXT:
+            {
+                if(elements.empty())
+                    break;
+                Element &el = elements.back();
+                if(el.type == BASEURL || el.type == TITLE ||
+                   el.type == SOURCE || el.type == COPYRIGHT)
+                    el.text = data;
+                break;
+            }
+
+            case XML_READER_ENDELEM:
+            {
+                if(elements.empty())
+                {
+                    b_error = true;
+                    break;
+                }
+                endElement();
+                b_done = elements.empty();
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    if(!b_done)
+    {
+        delete mpd;
+        mpd = NULL;
+        return false;
+    }
+
+    mpd->debug();
+    return true;
+}
+
+IsoffMainStreamParser::ElementType
+IsoffMainStreamParser::childType(const Element &parent, const char *name) const
+{
+    static const struct
+    {
+        ElementType parent;
+        const char *name;
+        ElementType type;
+    } childs[] =
+    {
+        { ROOT,                 "ProgramInformation",   PROGRAMINFORMATION },
+        { ROOT,                 "BaseURL",              BASEURL },
+        { ROOT,                 "Period",               PERIOD },
+        { PROGRAMINFORMATION,   "Title",                TITLE },
+        { PROGRAMINFORMATION,   "Source",               SOURCE },
+        { PROGRAMINFORMATION,   "Copyright",            COPYRIGHT },
+        { PERIOD,               "BaseURL",              BASEURL },
+        { PERIOD,               "SegmentBase",          SEGMENTBASE },
+        { PERIOD,               "SegmentList",          SEGMENTLIST },
+        { PERIOD,               "SegmentTemplate",      SEGMENTTEMPLATE },
+        { PERIOD,               "AdaptationSet",        ADAPTATIONSET },
+        { ADAPTATIONSET,        "BaseURL",              BASEURL },
+        { ADAPTATIONSET,        "SegmentBase",          SEGMENTBASE },
+        { ADAPTATIONSET,        "SegmentList",          SEGMENTLIST },
+        { ADAPTATIONSET,        "SegmentTemplate",      SEGMENTTEMPLATE },
+        { ADAPTATIONSET,        "Representation",       REPRESENTATION },
+        { REPRESENTATION,       "BaseURL",              BASEURL },
+        { REPRESENTATION,       "SegmentBase",          SEGMENTBASE },
+        { REPRESENTATION,       "SegmentList",          SEGMENTLIST },
+        { REPRESENTATION,       "SegmentTemplate",      SEGMENTTEMPLATE },
+        { SEGMENTBASE,          "Initialization",       INITIALIZATION },
+        { SEGMENTLIST,          "Initialization",       INITIALIZATION },
+        { SEGMENTLIST,          "SegmentURL",           SEGMENTURL },
+        { SEGMENTTEMPLATE,      "SegmentTimeline",      SEGMENTTIMELINE },
+        { SEGMENTTIMELINE,      "S",                    S },
+    };
+
+    for(size_t i=0; i<ARRAY_SIZE(childs); i++)
+    {
+        if(childs[i].parent == parent.type && !strcmp(childs[i].name, name))
+            return childs[i].type;
+    }
+    return UNKNOWN;
+}
+
+bool IsoffMainStreamParser::startElement(const char *name)
+{
+    ElementType type;
+    SegmentInformation *info = NULL;
+
+    if(elements.empty())
+    {
+        if(strcmp(name, "MPD"))
+            return false;
+        type = ROOT;
+    }
+    else
+    {
+        Element &parent = elements.back();
+        type = childType(parent, name);
+        info = parent.info;
+
+        /* Only the first of those is used, as with the DOM parser */
+        if(type != UNKNOWN)
+        {
+            const unsigned bit = 1 << type;
+            const bool multiple = (type == PERIOD || type == ADAPTATIONSET ||
+                                   type == REPRESENTATION || type == SEGMENTURL ||
+                                   type == S || (type == BASEURL && parent.type == ROOT));
+            if(!multiple && (parent.seen & bit))
+                type = UNKNOWN;
+            parent.seen |= bit;
+        }
+    }
+
+    elements.push_back(Element(type, info));
+    Element &el = elements.back();
+
+    switch(type)
+    {
+        case ROOT:
+            startMPD();
+            if(!mpd)
+                return false;
+            break;
+        case PROGRAMINFORMATION:
+            if((programInfo = new (std::nothrow) ProgramInformation()))
+            {
+                const char *attr, *value;
+                while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+                {
+                    if(!strcmp(attr, "moreInformationURL"))
+                        programInfo->setMoreInformationUrl(value);
+                }
+                mpd->programInfo.Set(programInfo);
+            }
+            else el.type = UNKNOWN;
+            break;
+        case PERIOD:
+            startPeriod(el);
+            break;
+        case ADAPTATIONSET:
+            startAdaptationSet(el);
+            break;
+        case REPRESENTATION:
+            startRepresentation(el);
+            break;
+        case SEGMENTBASE:
+            startSegmentBase(el);
+            break;
+        case SEGMENTLIST:
+            startSegmentList(el);
+            break;
+        case SEGMENTURL:
+            startSegmentURL(el);
+            break;
+        case SEGMENTTEMPLATE:
+            startSegmentTemplate(el);
+            break;
+        case SEGMENTTIMELINE:
+            startSegmentTimeline(el);
+            break;
+        case S:
+            startTimelineElement();
+            break;
+        case INITIALIZATION:
+            startInitialization(el, elements[elements.size() - 2].type);
+            break;
+        default:
+            break;
+    }
+
+    return true;
+}
+
+void IsoffMainStreamParser::endElement()
+{
+    Element el = elements.back();
+    elements.pop_back();
+
+    switch(el.type)
+    {
+        case BASEURL:
+            setBaseUrl(elements.back(), el.text);
+            break;
+        case TITLE:
+            programInfo->setTitle(el.text);
+            break;
+        case SOURCE:
+            programInfo->setSource(el.text);
+            break;
+        case COPYRIGHT:
+            programInfo->setCopyright(el.text);
+            break;
+        case SEGMENTTIMELINE:
+            /* was not used by any S element */
+            if(mediaTemplate->segmentTimeline.Get() != timeline)
+                delete timeline;
+            timeline = NULL;
+            break;
+        default:
+            break;
+    }
+}
+
+void IsoffMainStreamParser::startMPD()
+{
+    /* The profile is needed to create the MPD, so root attributes,
+     * which are only a few, are kept until then */
+    std::vector<std::pair<std::string, std::string> > attrs;
+    std::string urn;
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "profiles"))
+            urn = value;
+        else if(!strcmp(attr, "profile") && urn.empty()) //The standard spells it the both ways...
+            urn = value;
+        else
+            attrs.push_back(std::make_pair(std::string(attr), std::string(value)));
+    }
+
+    Profile profile(urn);
+    if(profile == Profile::Unknown)
+        return;
+
+    mpd = new (std::nothrow) MPD(p_stream, profile);
+    if(!mpd)
+        return;
+
+    std::vector<std::pair<std::string, std::string> >::const_iterator it;
+    for(it = attrs.begin(); it != attrs.end(); ++it)
+    {
+        const std::string &key = (*it).first;
+        const std::string &val = (*it).second;
+        if(key == "mediaPresentationDuration")
+            mpd->duration.Set(IsoTime(val));
+        else if(key == "minBufferTime")
+            mpd->minBufferTime.Set(IsoTime(val));
+        else if(key == "minimumUpdatePeriod")
+            mpd->minUpdatePeriod.Set(IsoTime(val));
+        else if(key == "maxSegmentDuration")
+            mpd->maxSegmentDuration.Set(IsoTime(val));
+        else if(key == "type")
+            mpd->setType(val);
+        else if(key == "availabilityStartTime")
+            mpd->availabilityStartTime.Set(UTCTime(val));
+        else if(key == "timeShiftBufferDepth")
+            mpd->timeShiftBufferDepth.Set(IsoTime(val));
+    }
+}
+
+void IsoffMainStreamParser::parseSegmentInformationAttribute(SegmentInformation *info,
+                                                             const char *attr,
+                                                             const char *value)
+{
+    if(!strcmp(attr, "bitstreamSwitching"))
+        info->setBitstreamSwitching(!strcmp(value, "true"));
+    else if(!strcmp(attr, "timescale"))
+        info->timescale.Set(Integer<uint64_t>(value));
+}
+
+void IsoffMainStreamParser::startPeriod(Element &el)
+{
+    if(!(period = new (std::nothrow) Period(mpd)))
+    {
+        el.type = UNKNOWN;
+        return;
+    }
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "start"))
+            period->startTime.Set(IsoTime(value));
+        else if(!strcmp(attr, "duration"))
+            period->duration.Set(IsoTime(value));
+        else if(!strcmp(attr, "id"))
+            period->setId(value);
+        else
+            parseSegmentInformationAttribute(period, attr, value);
+    }
+
+    el.info = period;
+    mpd->addPeriod(period);
+}
+
+void IsoffMainStreamParser::startAdaptationSet(Element &el)
+{
+    if(!(adaptationSet = new (std::nothrow) AdaptationSet(period)))
+    {
+        el.type = UNKNOWN;
+        return;
+    }
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "mimeType"))
+            adaptationSet->setMimeType(value);
+        else
+            parseSegmentInformationAttribute(adaptationSet, attr, value);
+    }
+
+    el.info = adaptationSet;
+    period->addAdaptationSet(adaptationSet);
+}
+
+void IsoffMainStreamParser::startRepresentation(Element &el)
+{
+    Representation *rep = new (std::nothrow) Representation(adaptationSet, mpd);
+    if(!rep)
+    {
+        el.type = UNKNOWN;
+        return;
+    }
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "id"))
+            rep->setId(value);
+        else if(!strcmp(attr, "width"))
+            rep->setWidth(atoi(value));
+        else if(!strcmp(attr, "height"))
+            rep->setHeight(atoi(value));
+        else if(!strcmp(attr, "bandwidth"))
+            rep->setBandwidth(atoi(value));
+        else if(!strcmp(attr, "mimeType"))
+            rep->setMimeType(value);
+        else
+            parseSegmentInformationAttribute(rep, attr, value);
+    }
+
+    el.info = rep;
+    adaptationSet->addRepresentation(rep);
+}
+
+void IsoffMainStreamParser::startSegmentBase(Element &el)
+{
+    if(!(segmentBase = new (std::nothrow) SegmentBase(el.info)))
+    {
+        el.type = UNKNOWN;
+        return;
+    }
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        size_t start = 0, end = 0;
+        if(!strcmp(attr, "indexRange") &&
+           std::sscanf(value, "%zu-%zu", &start, &end) == 2)
+        {
+            IndexSegment *index = new (std::nothrow) DashIndexSegment(el.info);
+            if(index)
+            {
+                index->setByteRange(start, end);
+                segmentBase->indexSegment.Set(index);
+                /* index must be before data, so data starts at index end */
+                segmentBase->setByteRange(end + 1, 0);
+            }
+        }
+    }
+
+    el.info->setSegmentBase(segmentBase);
+}
+
+void IsoffMainStreamParser::startSegmentList(Element &el)
+{
+    if(!(segmentList = new (std::nothrow) SegmentList()))
+    {
+        el.type = UNKNOWN;
+        return;
+    }
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "duration"))
+            segmentList->duration.Set(Integer<uint64_t>(value));
+        else if(!strcmp(attr, "timescale"))
+            segmentList->timescale.Set(Integer<uint64_t>(value));
+    }
+
+    listStartTime = 0;
+    el.info->setSegmentList(segmentList);
+}
+
+void IsoffMainStreamParser::startSegmentURL(Element &el)
+{
+    Segment *seg = new (std::nothrow) Segment(el.info);
+    if(!seg)
+        return;
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "media"))
+        {
+            if(*value)
+                seg->setSourceUrl(value);
+        }
+        else if(!strcmp(attr, "mediaRange"))
+        {
+            const char *end = strchr(value, '-');
+            seg->setByteRange(atoi(value), end ? atoi(end + 1) : 0);
+        }
+    }
+
+    seg->startTime.Set(VLC_TS_0 + listStartTime);
+    listStartTime += CLOCK_FREQ * segmentList->duration.Get();
+
+    segmentList->addSegment(seg);
+}
+
+void IsoffMainStreamParser::startSegmentTemplate(Element &el)
+{
+    /* attributes are only valid until the next one is read */
+    std::string mediaurl, initurl, startNumber, duration, timescale;
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "media"))
+            mediaurl = value;
+        else if(!strcmp(attr, "initialization"))
+            initurl = value;
+        else if(!strcmp(attr, "startNumber"))
+            startNumber = value;
+        else if(!strcmp(attr, "duration"))
+            duration = value;
+        else if(!strcmp(attr, "timescale"))
+            timescale = value;
+    }
+
+    mediaTemplate = NULL;
+    if(mediaurl.empty() || !(mediaTemplate = new (std::nothrow) MediaSegmentTemplate(el.info)))
+    {
+        el.type = UNKNOWN;
+        return;
+    }
+    mediaTemplate->setSourceUrl(mediaurl);
+
+    if(!startNumber.empty())
+        mediaTemplate->startNumber.Set(Integer<uint64_t>(startNumber));
+    if(!duration.empty())
+        mediaTemplate->duration.Set(Integer<mtime_t>(duration));
+    if(!timescale.empty())
+        mediaTemplate->timescale.Set(Integer<uint64_t>(timescale));
+
+    InitSegmentTemplate *initTemplate = NULL;
+    if(!initurl.empty() &&
+       (initTemplate = new (std::nothrow) InitSegmentTemplate(el.info)))
+        initTemplate->setSourceUrl(initurl);
+
+    mediaTemplate->initialisationSegment.Set(initTemplate);
+    el.info->setSegmentTemplate(mediaTemplate);
+}
+
+void IsoffMainStreamParser::startSegmentTimeline(Element &el)
+{
+    if(!(timeline = new (std::nothrow) SegmentTimeline(mediaTemplate)))
+        el.type = UNKNOWN;
+}
+
+void IsoffMainStreamParser::startTimelineElement()
+{
+    mtime_t d = 0, t = 0;
+    uint64_t r = 0; // never repeats by default
+    bool b_d = false, b_t = false;
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "d"))
+        {
+            d = strtoll(value, NULL, 10);
+            b_d = true;
+        }
+        else if(!strcmp(attr, "r"))
+            r = strtoull(value, NULL, 10);
+        else if(!strcmp(attr, "t"))
+        {
+            t = strtoll(value, NULL, 10);
+            b_t = true;
+        }
+    }
+
+    if(!b_d) /* Mandatory */
+        return;
+
+    if(b_t)
+        timeline->addElement(d, r, t);
+    else
+        timeline->addElement(d, r);
+
+    mediaTemplate->segmentTimeline.Set(timeline);
+}
+
+void IsoffMainStreamParser::startInitialization(Element &el, ElementType parentType)
+{
+    Initializable<Segment> *init;
+    if(parentType == SEGMENTBASE)
+        init = segmentBase;
+    else
+        init = segmentList;
+
+    Segment *seg = new (std::nothrow) InitSegment(el.info);
+    if(!seg)
+        return;
+    seg->setSourceUrl(std::string());
+
+    const char *attr, *value;
+    while((attr = xml_ReaderNextAttr(vlc_reader, &value)) != NULL)
+    {
+        if(!strcmp(attr, "sourceURL"))
+            seg->setSourceUrl(value);
+        else if(!strcmp(attr, "range"))
+        {
+            const char *end = strchr(value, '-');
+            seg->setByteRange(atoi(value), end ? atoi(end + 1) : 0);
+        }
+    }
+
+    init->initialisationSegment.Set(seg);
+}
+
+void IsoffMainStreamParser::setBaseUrl(const Element &parent, const std::string &url)
+{
+    if(parent.type == ROOT)
+        mpd->addBaseUrl(url);
+    else
+        parent.info->baseUrl.Set(new Url(url));
+}
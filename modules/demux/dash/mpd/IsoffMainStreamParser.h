@@ -0,0 +1,138 @@
+/*
+ * IsoffMainStreamParser.h
+ *****************************************************************************
+ * Copyright (C) 2015 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef ISOFFMAINSTREAMPARSER_H_
+#define ISOFFMAINSTREAMPARSER_H_
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../adaptative/playlist/SegmentInfoCommon.h"
+
+#include <vlc_common.h>
+#include <vlc_xml.h>
+
+#include <string>
+#include <vector>
+
+namespace adaptative
+{
+    namespace playlist
+    {
+        class SegmentInformation;
+        class SegmentBase;
+        class SegmentList;
+        class MediaSegmentTemplate;
+        class SegmentTimeline;
+    }
+}
+
+namespace dash
+{
+    namespace mpd
+    {
+        class MPD;
+        class Period;
+        class AdaptationSet;
+        class ProgramInformation;
+
+        using namespace adaptative::playlist;
+
+        /* Builds the MPD while reading the xml, element by element,
+         * without an intermediate DOM tree. Same semantics as
+         * IsoffMainParser. */
+        class IsoffMainStreamParser
+        {
+            public:
+                IsoffMainStreamParser               (stream_t *p_stream);
+                virtual ~IsoffMainStreamParser      ();
+
+                bool            parse  ();
+                MPD*            getMPD ();
+
+            private:
+                enum ElementType
+                {
+                    UNKNOWN = 0,
+                    ROOT,
+                    PROGRAMINFORMATION,
+                    TITLE,
+                    SOURCE,
+                    COPYRIGHT,
+                    BASEURL,
+                    PERIOD,
+                    ADAPTATIONSET,
+                    REPRESENTATION,
+                    SEGMENTBASE,
+                    SEGMENTLIST,
+                    SEGMENTURL,
+                    SEGMENTTEMPLATE,
+                    SEGMENTTIMELINE,
+                    S,
+                    INITIALIZATION,
+                };
+
+                class Element
+                {
+                    public:
+                        Element(ElementType, SegmentInformation *);
+                        ElementType         type;
+                        SegmentInformation *info; /* closest one */
+                        unsigned            seen; /* children types */
+                        std::string         text;
+                };
+
+                ElementType childType       (const Element &, const char *) const;
+                bool    startElement        (const char *);
+                void    endElement          ();
+                void    startMPD            ();
+                void    startPeriod         (Element &);
+                void    startAdaptationSet  (Element &);
+                void    startRepresentation (Element &);
+                void    parseSegmentInformationAttribute(SegmentInformation *,
+                                                         const char *, const char *);
+                void    startSegmentBase    (Element &);
+                void    startSegmentList    (Element &);
+                void    startSegmentURL     (Element &);
+                void    startSegmentTemplate(Element &);
+                void    startSegmentTimeline(Element &);
+                void    startTimelineElement();
+                void    startInitialization (Element &, ElementType);
+                void    setBaseUrl          (const Element &, const std::string &);
+
+                stream_t                *p_stream;
+                xml_t                   *vlc_xml;
+                xml_reader_t            *vlc_reader;
+                std::vector<Element>     elements;
+
+                MPD                     *mpd;
+                ProgramInformation      *programInfo;
+                Period                  *period;
+                AdaptationSet           *adaptationSet;
+                SegmentBase             *segmentBase;
+                SegmentList             *segmentList;
+                MediaSegmentTemplate    *mediaTemplate;
+                SegmentTimeline         *timeline;
+                mtime_t                  listStartTime;
+        };
+    }
+}
+
+#endif /* ISOFFMAINSTREAMPARSER_H_ */
@@ -28,6 +28,9 @@
 
 #include "MPDFactory.h"
 #include "mpd/IsoffMainParser.h"
+#include "mpd/IsoffMainStreamParser.h"
+#include "xml/DOMParser.h"
+#include <vlc_stream.h>
 
 using namespace dash::xml;
 using namespace dash::mpd;
@@ -56,3 +59,27 @@ MPD* MPDFactory::create(Node *root, stream_t *p_stream, Profile profile)
 
     return mpd;
 }
+
+MPD* MPDFactory::create(stream_t *p_stream, bool b_dom)
+{
+    MPD *mpd = NULL;
+    mtime_t time = mdate();
+
+    if(b_dom)
+    {
+        DOMParser parser(p_stream);
+        if(parser.parse())
+            mpd = create(parser.getRootNode(), p_stream, parser.getProfile());
+    }
+    else
+    {
+        IsoffMainStreamParser parser(p_stream);
+        if(parser.parse())
+            mpd = parser.getMPD();
+    }
+
+    msg_Dbg(p_stream, "MPD %s parsing took %" PRId64 "us",
+            b_dom ? "DOM" : "stream", mdate() - time);
+
+    return mpd;
+}
@@ -40,6 +40,7 @@ namespace dash
         {
             public:
                 static MPD* create(xml::Node *root, stream_t *p_stream, Profile profile);
+                static MPD* create(stream_t *p_stream, bool b_dom);
         };
     }
 }
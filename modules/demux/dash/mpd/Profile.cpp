@@ -53,13 +53,23 @@ Profile::Profile(const std::string &urn)
     type = getNameByURN(urn);
 }
 
+/* urn can be a comma separated list, first known one wins */
 Profile::Name Profile::getNameByURN(const std::string &urn) const
 {
-    for( int i=0; urnmap[i].name != Unknown; i++ )
+    size_t pos;
+    size_t nextpos = -1;
+    do
     {
-        if ( urn == urnmap[i].urn )
-            return urnmap[i].name;
+        pos = nextpos + 1;
+        nextpos = urn.find_first_of(",", pos);
+        const std::string current = urn.substr(pos, nextpos - pos);
+        for( int i=0; urnmap[i].name != Unknown; i++ )
+        {
+            if ( current == urnmap[i].urn )
+                return urnmap[i].name;
+        }
     }
+    while (nextpos != std::string::npos);
     return Unknown;
 }
 
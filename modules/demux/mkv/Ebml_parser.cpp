@@ -301,6 +301,64 @@ EbmlElement *EbmlParser::Get( int n_call )
     return m_el[mi_level];
 }
 
+bool EbmlParser::GetSimpleBlock( uint64 *pi_size )
+{
+    if( mi_user_level != mi_level || mi_level < 1 || m_got || mb_keep )
+        return false;
+
+    /* Done with the previous element, as in Get() */
+    if( m_el[mi_level] )
+    {
+        m_el[mi_level]->SkipData( *m_es, EBML_CONTEXT(m_el[mi_level]) );
+        if( MKV_IS_ID( m_el[mi_level], KaxBlockVirtual ) )
+            static_cast<KaxBlockVirtualWorkaround*>(m_el[mi_level])->Fix();
+        delete m_el[mi_level];
+        m_el[mi_level] = NULL;
+    }
+
+    /* The SimpleBlock ID is the single 0xA3 byte, then comes the size */
+    IOCallback & io = m_es->I_O();
+    const uint64 i_pos = io.getFilePointer();
+    uint8_t p_buf[9];
+
+    if( io.read( p_buf, 2 ) != 2 || p_buf[0] != 0xA3 || p_buf[1] == 0 )
+        goto restore;
+    {
+        unsigned i_length = 1;
+        uint8_t i_mask = 0x80;
+        while( !( p_buf[1] & i_mask ) )
+        {
+            i_mask >>= 1;
+            i_length++;
+        }
+        if( i_length > 1 && io.read( &p_buf[2], i_length - 1 ) != i_length - 1 )
+            goto restore;
+
+        uint64 i_size = p_buf[1] & ( i_mask - 1 );
+        bool b_unknown = i_size == (uint64)( i_mask - 1 );
+        for( unsigned i = 2; i <= i_length; i++ )
+        {
+            i_size = ( i_size << 8 ) | p_buf[i];
+            b_unknown &= p_buf[i] == 0xff;
+        }
+
+        /* Let libebml handle the unusual and broken cases */
+        EbmlElement *p_parent = m_el[mi_level - 1];
+        const uint64 i_data = io.getFilePointer();
+        if( b_unknown || ( p_parent->IsFiniteSize() &&
+                           ( i_data > p_parent->GetEndPosition() ||
+                             i_size > p_parent->GetEndPosition() - i_data ) ) )
+            goto restore;
+
+        *pi_size = i_size;
+        return true;
+    }
+
+restore:
+    io.setFilePointer( i_pos, seek_beginning );
+    return false;
+}
+
 bool EbmlParser::IsTopPresent( EbmlElement *el ) const
 {
     for( int i = 0; i < mi_level; i++ )
@@ -44,6 +44,9 @@ class EbmlParser
     void        Keep( void );
     void        Unkeep( void );
     EbmlElement *UnGet( uint64 i_block_pos, uint64 i_cluster_pos );
+    /* Reads the header of the next element if it is a SimpleBlock, without
+     * creating it. The stream is then at its data. */
+    bool        GetSimpleBlock( uint64 *pi_size );
 
     int  GetLevel( void ) const;
 
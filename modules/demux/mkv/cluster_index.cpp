@@ -0,0 +1,336 @@
+/*****************************************************************************
+ * cluster_index.cpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "cluster_index.hpp"
+#include "Ebml_parser.hpp"
+#include "stream_io_callback.hpp"
+
+#include <vlc_fs.h>
+#include <vlc_url.h>
+#include <vlc_configuration.h>
+
+#include <sys/stat.h>
+
+/* Cache file layout, big endian:
+ * magic, file size, file mtime, segment start, count, (position, time)... */
+static const char psz_magic[8] = { 'V', 'L', 'C', 'M', 'K', 'I', 'X', 1 };
+#define CACHE_MAX_CLUSTERS (1 << 24)
+
+cluster_indexer_c::cluster_indexer_c( demux_t *p_demux, const char *psz_file,
+                                      bool b_cache )
+    :p_demux(p_demux)
+    ,psz_file(strdup(psz_file))
+    ,b_cache(b_cache)
+    ,i_file_size(0)
+    ,i_file_mtime(0)
+    ,segment(NULL)
+    ,i_start_pos(0)
+    ,i_timescale(0)
+    ,is_running(false)
+    ,b_abort(false)
+    ,b_done(false)
+    ,b_loaded(false)
+{
+    struct stat st;
+
+    vlc_mutex_init( &lock );
+
+    if( this->psz_file == NULL || vlc_stat( this->psz_file, &st ) )
+        this->b_cache = false;
+    else
+    {
+        i_file_size = st.st_size;
+        i_file_mtime = st.st_mtime;
+    }
+}
+
+cluster_indexer_c::~cluster_indexer_c()
+{
+    if( is_running )
+    {
+        vlc_mutex_lock( &lock );
+        b_abort = true;
+        vlc_mutex_unlock( &lock );
+
+        vlc_join( thread, NULL );
+    }
+
+    if( b_cache && b_done && !b_loaded )
+        Save();
+
+    vlc_mutex_destroy( &lock );
+    free( psz_file );
+}
+
+bool cluster_indexer_c::Start( KaxSegment *p_segment, int64_t i_start,
+                               uint64_t i_scale )
+{
+    segment     = p_segment;
+    i_start_pos = i_start;
+    i_timescale = i_scale;
+
+    if( b_cache && Load() )
+    {
+        msg_Dbg( p_demux, "using %zu cached cluster positions", clusters.size() );
+        b_done = b_loaded = true;
+        return true;
+    }
+
+    is_running = !vlc_clone( &thread, ScanThread, this, VLC_THREAD_PRIORITY_LOW );
+    return is_running;
+}
+
+bool cluster_indexer_c::Fetch( std::vector<mkv_index_t> & found, size_t i_from )
+{
+    vlc_mutex_locker l( &lock );
+
+    if( i_from < clusters.size() )
+        found.insert( found.end(), clusters.begin() + i_from, clusters.end() );
+    return b_done;
+}
+
+void *cluster_indexer_c::ScanThread( void *data )
+{
+    static_cast<cluster_indexer_c *>( data )->Scan();
+    return NULL;
+}
+
+/* Same as matroska_segment_c::ParseCluster() without data */
+bool cluster_indexer_c::ReadTimecode( EbmlStream & es, KaxCluster *cluster,
+                                      mtime_t *pi_mk_time ) const
+{
+    EbmlElement *el;
+    EbmlMaster  *m = static_cast<EbmlMaster *>( cluster );
+    int i_upper_level = 0;
+
+    if( unlikely( m->IsFiniteSize() && m->GetSize() >= SIZE_MAX ) )
+        return false;
+
+    m->Read( es, EBML_CONTEXT(cluster), i_upper_level, el, true, SCOPE_NO_DATA );
+
+    for( unsigned int i = 0; i < m->ListSize(); i++ )
+    {
+        EbmlElement *l = (*m)[i];
+
+        if( MKV_IS_ID( l, KaxClusterTimecode ) )
+        {
+            KaxClusterTimecode &ctc = *(KaxClusterTimecode*)l;
+
+            cluster->InitTimecode( uint64( ctc ), i_timescale );
+            *pi_mk_time = cluster->GlobalTimecode() / INT64_C(1000);
+            return true;
+        }
+    }
+    return false;
+}
+
+void cluster_indexer_c::Scan()
+{
+    char *psz_url = vlc_path2uri( psz_file, "file" );
+    stream_t *s = psz_url ? stream_UrlNew( p_demux, psz_url ) : NULL;
+
+    free( psz_url );
+    if( s == NULL )
+    {
+        msg_Warn( p_demux, "cannot open %s to index clusters", psz_file );
+        return;
+    }
+
+    vlc_stream_io_callback io( s, true );
+    EbmlStream es( io );
+    bool b_aborted = false;
+    bool b_complete = false;
+    mtime_t i_start = mdate();
+
+    try
+    {
+        io.setFilePointer( i_start_pos, seek_beginning );
+
+        EbmlParser ep( &es, segment, p_demux, false );
+        EbmlElement *el;
+
+        while( ( el = ep.Get() ) != NULL )
+        {
+            vlc_mutex_lock( &lock );
+            b_aborted = b_abort;
+            vlc_mutex_unlock( &lock );
+            if( b_aborted )
+                break;
+
+            if( !MKV_IS_ID( el, KaxCluster ) )
+                continue;
+
+            KaxCluster *cluster = (KaxCluster *)el;
+            mkv_index_t idx;
+
+            idx.i_track       = -1;
+            idx.i_block_number= -1;
+            idx.i_position    = cluster->GetElementPosition();
+            idx.i_relative_position = -1;
+            idx.b_key         = true;
+
+            if( !ReadTimecode( es, cluster, &idx.i_mk_time ) )
+                continue;
+
+            vlc_mutex_lock( &lock );
+            clusters.push_back( idx );
+            vlc_mutex_unlock( &lock );
+        }
+
+        /* A truncated file ends before its segment */
+        b_complete = !b_aborted &&
+                     ( !segment->IsFiniteSize() ||
+                       segment->GetEndPosition() <= stream_Size( s ) );
+    }
+    catch(...)
+    {
+        msg_Err( p_demux, "error while indexing clusters" );
+    }
+
+    /* A partial index is neither trusted nor cached */
+    vlc_mutex_lock( &lock );
+    b_done = b_complete;
+    msg_Dbg( p_demux, "indexed %zu clusters in %" PRId64 " ms%s", clusters.size(),
+             (mdate() - i_start) / 1000,
+             b_aborted ? " (aborted)" : b_complete ? "" : " (incomplete)" );
+    vlc_mutex_unlock( &lock );
+}
+
+/*****************************************************************************
+ * Cache file
+ *****************************************************************************/
+char *cluster_indexer_c::CachePath() const
+{
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path;
+
+    if( psz_dir == NULL )
+        return NULL;
+
+    /* FNV-1a of the file path, the file size and date are checked on load */
+    uint64_t i_hash = UINT64_C(0xcbf29ce484222325);
+    for( const char *p = psz_file; *p; p++ )
+    {
+        i_hash ^= (uint8_t)*p;
+        i_hash *= UINT64_C(0x100000001b3);
+    }
+
+    if( asprintf( &psz_path, "%s" DIR_SEP "mkvindex" DIR_SEP "%016" PRIx64 ".idx",
+                  psz_dir, i_hash ) == -1 )
+        psz_path = NULL;
+    free( psz_dir );
+    return psz_path;
+}
+
+bool cluster_indexer_c::Load()
+{
+    char *psz_path = CachePath();
+    if( psz_path == NULL )
+        return false;
+
+    FILE *file = vlc_fopen( psz_path, "rb" );
+    free( psz_path );
+    if( file == NULL )
+        return false;
+
+    uint8_t header[8 + 4 * 8];
+    bool b_ok = fread( header, sizeof(header), 1, file ) == 1 &&
+                !memcmp( header, psz_magic, sizeof(psz_magic) ) &&
+                GetQWBE( &header[8] ) == i_file_size &&
+                (int64_t)GetQWBE( &header[16] ) == i_file_mtime &&
+                (int64_t)GetQWBE( &header[24] ) == i_start_pos;
+
+    uint64_t i_count = b_ok ? GetQWBE( &header[32] ) : 0;
+    if( i_count > CACHE_MAX_CLUSTERS )
+        b_ok = false;
+
+    for( uint64_t i = 0; b_ok && i < i_count; i++ )
+    {
+        uint8_t entry[16];
+        mkv_index_t idx;
+
+        if( fread( entry, sizeof(entry), 1, file ) != 1 )
+        {
+            b_ok = false;
+            break;
+        }
+        idx.i_track       = -1;
+        idx.i_block_number= -1;
+        idx.i_position    = GetQWBE( &entry[0] );
+        idx.i_relative_position = -1;
+        idx.i_mk_time     = GetQWBE( &entry[8] );
+        idx.b_key         = true;
+        clusters.push_back( idx );
+    }
+    fclose( file );
+
+    if( !b_ok )
+        clusters.clear();
+    return b_ok;
+}
+
+void cluster_indexer_c::Save()
+{
+    char *psz_path = CachePath();
+    if( psz_path == NULL )
+        return;
+
+    /* create the cache directory and its mkvindex child */
+    char *psz_sep = strrchr( psz_path, DIR_SEP_CHAR );
+    *psz_sep = '\0';
+    char *psz_parent = strrchr( psz_path, DIR_SEP_CHAR );
+    *psz_parent = '\0';
+    vlc_mkdir( psz_path, 0700 );
+    *psz_parent = DIR_SEP_CHAR;
+    vlc_mkdir( psz_path, 0700 );
+    *psz_sep = DIR_SEP_CHAR;
+
+    FILE *file = vlc_fopen( psz_path, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( p_demux, "cannot create %s", psz_path );
+        free( psz_path );
+        return;
+    }
+
+    uint8_t header[8 + 4 * 8];
+    memcpy( header, psz_magic, sizeof(psz_magic) );
+    SetQWBE( &header[8], i_file_size );
+    SetQWBE( &header[16], i_file_mtime );
+    SetQWBE( &header[24], i_start_pos );
+    SetQWBE( &header[32], clusters.size() );
+
+    bool b_ok = fwrite( header, sizeof(header), 1, file ) == 1;
+    for( size_t i = 0; b_ok && i < clusters.size(); i++ )
+    {
+        uint8_t entry[16];
+
+        SetQWBE( &entry[0], clusters[i].i_position );
+        SetQWBE( &entry[8], clusters[i].i_mk_time );
+        b_ok = fwrite( entry, sizeof(entry), 1, file ) == 1;
+    }
+
+    if( fclose( file ) || !b_ok )
+    {
+        msg_Warn( p_demux, "cannot write %s", psz_path );
+        vlc_unlink( psz_path );
+    }
+    free( psz_path );
+}
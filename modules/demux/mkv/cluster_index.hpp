@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * cluster_index.hpp : matroska demuxer
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef _CLUSTER_INDEX_HPP_
+#define _CLUSTER_INDEX_HPP_
+
+#include "mkv.hpp"
+
+/*****************************************************************************
+ * Cluster indexer: finds the clusters of a segment without cues from a
+ * low priority thread reading its own stream of the file, and keeps the
+ * result in the user cache directory when asked to.
+ *****************************************************************************/
+class cluster_indexer_c
+{
+public:
+    cluster_indexer_c( demux_t *, const char *psz_file, bool b_cache );
+    virtual ~cluster_indexer_c();
+
+    bool Start( KaxSegment *, int64_t i_start_pos, uint64_t i_timescale );
+
+    /* Appends the clusters found after the i_from first ones.
+     * Returns true once the whole segment has been scanned. */
+    bool Fetch( std::vector<mkv_index_t> &, size_t i_from );
+
+private:
+    static void *ScanThread( void * );
+    void Scan();
+    bool ReadTimecode( EbmlStream &, KaxCluster *, mtime_t * ) const;
+
+    char *CachePath() const;
+    bool Load();
+    void Save();
+
+    demux_t      *p_demux;
+    char         *psz_file;
+    bool         b_cache;
+    uint64_t     i_file_size;
+    int64_t      i_file_mtime;
+
+    KaxSegment   *segment;
+    int64_t      i_start_pos;
+    uint64_t     i_timescale;
+
+    bool         is_running;
+    vlc_thread_t thread;
+
+    vlc_mutex_t  lock;
+    bool         b_abort;
+    bool         b_done;
+    bool         b_loaded;
+    std::vector<mkv_index_t> clusters;
+};
+
+#endif
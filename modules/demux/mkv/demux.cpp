@@ -642,11 +642,107 @@ void demux_sys_t::CleanUi()
     msg_Dbg( &demuxer, "Stopping the UI Hook" );
 }
 
+/* Family segments are preloaded by a few threads, the segments of a stream
+ * sharing its EbmlStream go to the same thread */
+#define PRELOAD_THREADS_MAX 4
+
+struct family_preload_t
+{
+    vlc_mutex_t lock;
+    std::vector< std::vector<matroska_segment_c*> > groups;
+    size_t      i_next;
+};
+
+static void *PreloadThread( void *data )
+{
+    family_preload_t *p_preload = static_cast<family_preload_t *>( data );
+
+    for( ;; )
+    {
+        vlc_mutex_lock( &p_preload->lock );
+        size_t i_group = p_preload->i_next++;
+        vlc_mutex_unlock( &p_preload->lock );
+
+        if( i_group >= p_preload->groups.size() )
+            break;
+
+        std::vector<matroska_segment_c*> & group = p_preload->groups[i_group];
+        for( size_t i = 0; i < group.size(); i++ )
+        {
+            try
+            {
+                group[i]->Preload( true );
+            }
+            catch(...)
+            {
+                msg_Err( &group[i]->sys.demuxer, "error while preloading a segment" );
+            }
+        }
+    }
+    return NULL;
+}
+
 void demux_sys_t::PreloadFamily( const matroska_segment_c & of_segment )
 {
-    for (size_t i=0; i<opened_segments.size(); i++)
+    family_preload_t preload;
+
+    for (size_t i=0; i<streams.size(); i++)
+    {
+        std::vector<matroska_segment_c*> group;
+
+        for (size_t j=0; j<streams[i]->segments.size(); j++)
+        {
+            matroska_segment_c *p_segment = streams[i]->segments[j];
+            if ( !p_segment->b_preloaded && p_segment->IsFamily( of_segment ) )
+                group.push_back( p_segment );
+        }
+        if ( !group.empty() )
+            preload.groups.push_back( group );
+    }
+    if ( preload.groups.empty() )
+        return;
+
+    vlc_mutex_init( &preload.lock );
+    preload.i_next = 0;
+
+    /* the calling thread takes its share of the groups */
+    vlc_thread_t threads[PRELOAD_THREADS_MAX - 1];
+    size_t i_threads = 0;
+    size_t i_max = __MIN( preload.groups.size(), PRELOAD_THREADS_MAX ) - 1;
+
+    while( i_threads < i_max &&
+           !vlc_clone( &threads[i_threads], PreloadThread, &preload,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+        i_threads++;
+
+    msg_Dbg( &demuxer, "preloading %zu family streams with %zu threads",
+             preload.groups.size(), i_threads + 1 );
+    PreloadThread( &preload );
+
+    for( size_t i = 0; i < i_threads; i++ )
+        vlc_join( threads[i], NULL );
+    vlc_mutex_destroy( &preload.lock );
+}
+
+static void LoadChaptersDeferred( const std::vector<virtual_chapter_c*> & chapters )
+{
+    for( size_t i = 0; i < chapters.size(); i++ )
+    {
+        if( chapters[i]->p_segment != NULL )
+            chapters[i]->p_segment->LoadDeferred();
+        LoadChaptersDeferred( chapters[i]->sub_chapters );
+    }
+}
+
+/* Loads what the segments played by the virtual segments left for later,
+ * the other preloaded family segments are never parsed further */
+void demux_sys_t::LoadDeferred()
+{
+    for( size_t i = 0; i < used_segments.size(); i++ )
     {
-        opened_segments[i]->PreloadFamily( of_segment );
+        std::vector<virtual_edition_c*> *p_editions = used_segments[i]->Editions();
+        for( size_t j = 0; j < p_editions->size(); j++ )
+            LoadChaptersDeferred( (*p_editions)[j]->chapters );
     }
 }
 
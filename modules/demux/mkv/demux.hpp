@@ -381,6 +381,7 @@ public:
     virtual_chapter_c *FindChapter( int64_t i_find_uid, virtual_segment_c * & p_segment_found );
 
     void PreloadFamily( const matroska_segment_c & of_segment );
+    void LoadDeferred();
     bool PreloadLinked();
     void FreeUnused();
     bool PreparePlayback( virtual_segment_c *p_new_segment );
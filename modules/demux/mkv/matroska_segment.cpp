@@ -23,6 +23,7 @@
  *****************************************************************************/
 
 #include "matroska_segment.hpp"
+#include "cluster_index.hpp"
 #include "chapters.hpp"
 #include "demux.hpp"
 #include "util.hpp"
@@ -42,6 +43,9 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,i_chapters_position(-1)
     ,i_tags_position(-1)
     ,i_attachments_position(-1)
+    ,b_defer_meta(false)
+    ,i_tags_deferred(-1)
+    ,i_attachments_deferred(-1)
     ,cluster(NULL)
     ,i_block_pos(0)
     ,i_cluster_pos(0)
@@ -52,6 +56,9 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,b_cues(false)
     ,i_index(0)
     ,i_index_max(1024)
+    ,p_indexer(NULL)
+    ,i_indexer_fetched(0)
+    ,b_indexed(false)
     ,psz_muxing_application(NULL)
     ,psz_writing_application(NULL)
     ,psz_segment_filename(NULL)
@@ -68,6 +75,9 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
 
 matroska_segment_c::~matroska_segment_c()
 {
+    /* the scan thread uses the segment element */
+    delete p_indexer;
+
     for( size_t i_track = 0; i_track < tracks.size(); i_track++ )
     {
         delete tracks[i_track]->p_compression_data;
@@ -123,14 +133,11 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
     {
         if( MKV_IS_ID( el, KaxCuePoint ) )
         {
-            b_invalid_cue = false;
-#define idx p_indexes[i_index]
+            /* one index entry per track position of the cue point */
+            std::vector<mkv_index_t> positions;
+            mtime_t i_mk_time = -1;
 
-            idx.i_track       = -1;
-            idx.i_block_number= -1;
-            idx.i_position    = -1;
-            idx.i_mk_time     = -1;
-            idx.b_key         = true;
+            b_invalid_cue = false;
 
             ep->Down();
             while( ( el = ep->Get() ) != NULL )
@@ -154,10 +161,19 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
                         b_invalid_cue = true;
                         break;
                     }
-                    idx.i_mk_time = uint64( ctime ) * i_timescale / INT64_C(1000);
+                    i_mk_time = uint64( ctime ) * i_timescale / INT64_C(1000);
                 }
                 else if( MKV_IS_ID( el, KaxCueTrackPositions ) )
                 {
+                    mkv_index_t idx;
+
+                    idx.i_track       = -1;
+                    idx.i_block_number= -1;
+                    idx.i_position    = -1;
+                    idx.i_relative_position = -1;
+                    idx.i_mk_time     = -1;
+                    idx.b_key         = true;
+
                     ep->Down();
                     try
                     {
@@ -194,7 +210,10 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
 #if LIBMATROSKA_VERSION >= 0x010401
                             else if( MKV_IS_ID( el, KaxCueRelativePosition ) )
                             {
-                                /* For future use */
+                                KaxCueRelativePosition &crpos = *(KaxCueRelativePosition*)el;
+
+                                crpos.ReadData( es.I_O() );
+                                idx.i_relative_position = uint64( crpos );
                             }
                             else if( MKV_IS_ID( el, KaxCueDuration ) )
                             {
@@ -215,6 +234,9 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
                         break;
                     }
                     ep->Up();
+
+                    if( idx.i_position >= 0 )
+                        positions.push_back( idx );
                 }
                 else
                 {
@@ -223,22 +245,21 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
             }
             ep->Up();
 
-#if 0
-            msg_Dbg( &sys.demuxer, " * added time=%"PRId64" pos=%"PRId64
-                     " track=%d bnum=%d", idx.i_time, idx.i_position,
-                     idx.i_track, idx.i_block_number );
-#endif
-            if( likely( !b_invalid_cue ) )
+            /* a cue without time cannot be used to seek */
+            if( likely( !b_invalid_cue ) && i_mk_time >= 0 )
             {
-                i_index++;
-                if( i_index >= i_index_max )
+                for( size_t i = 0; i < positions.size(); i++ )
                 {
-                    i_index_max += 1024;
-                    p_indexes = (mkv_index_t*)xrealloc( p_indexes,
-                                                        sizeof( mkv_index_t ) * i_index_max );
+                    positions[i].i_mk_time = i_mk_time;
+#if 0
+                    msg_Dbg( &sys.demuxer, " * added time=%"PRId64" pos=%"PRId64
+                             " track=%d bnum=%d", positions[i].i_mk_time,
+                             positions[i].i_position, positions[i].i_track,
+                             positions[i].i_block_number );
+#endif
+                    IndexAppend( positions[i] );
                 }
             }
-#undef idx
         }
         else
         {
@@ -246,8 +267,10 @@ void matroska_segment_c::LoadCues( KaxCues *cues )
         }
     }
     delete ep;
+    IndexSort();
     b_cues = true;
-    msg_Dbg( &sys.demuxer, "|   - loading cues done." );
+    msg_Dbg( &sys.demuxer, "|   - loading cues done (%d entries, %zu tracks).",
+             i_index, track_indexes.size() );
 }
 
 
@@ -592,36 +615,152 @@ void matroska_segment_c::InformationCreate( )
  * Misc
  *****************************************************************************/
 
+void matroska_segment_c::IndexAppend( const mkv_index_t & idx )
+{
+    if( i_index >= i_index_max )
+    {
+        i_index_max += 1024;
+        p_indexes = (mkv_index_t*)xrealloc( p_indexes,
+                                        sizeof( mkv_index_t ) * i_index_max );
+    }
+    track_indexes[idx.i_track].push_back( i_index );
+    p_indexes[i_index++] = idx;
+}
+
 void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
 {
-#define idx p_indexes[i_index]
+    mkv_index_t idx;
+
     idx.i_track       = -1;
     idx.i_block_number= -1;
     idx.i_position    = cluster->GetElementPosition();
+    idx.i_relative_position = -1;
     idx.i_mk_time     = cluster->GlobalTimecode() / INT64_C(1000);
     idx.b_key         = true;
 
-    i_index++;
-    if( i_index >= i_index_max )
+    /* keep the index in time order for IndexFind() */
+    if( i_index > 0 && p_indexes[i_index - 1].i_mk_time >= idx.i_mk_time )
+        return;
+    IndexAppend( idx );
+}
+
+/* Adds the clusters found by the background scan so far */
+void matroska_segment_c::IndexUpdate()
+{
+    if( p_indexer == NULL || b_indexed )
+        return;
+
+    std::vector<mkv_index_t> found;
+    bool b_done = p_indexer->Fetch( found, i_indexer_fetched );
+
+    i_indexer_fetched += found.size();
+    for( size_t i = 0; i < found.size(); i++ )
     {
-        i_index_max += 1024;
-        p_indexes = (mkv_index_t*)xrealloc( p_indexes,
-                                        sizeof( mkv_index_t ) * i_index_max );
+        if( i_index == 0 ||
+            ( p_indexes[i_index - 1].i_position < found[i].i_position &&
+              p_indexes[i_index - 1].i_mk_time < found[i].i_mk_time ) )
+            IndexAppend( found[i] );
     }
-#undef idx
+
+    if( b_done )
+    {
+        msg_Dbg( &sys.demuxer, "all %d clusters indexed", i_index );
+        b_indexed = true;
+    }
+}
+
+static bool IndexEntryBefore( const mkv_index_t & a, const mkv_index_t & b )
+{
+    if( a.i_mk_time != b.i_mk_time )
+        return a.i_mk_time < b.i_mk_time;
+    return a.i_position < b.i_position;
+}
+
+static bool IndexEntryAfter( const mkv_index_t & a, const mkv_index_t & b )
+{
+    return IndexEntryBefore( b, a );
+}
+
+/* Cues are usually stored in time order, but nothing requires it */
+void matroska_segment_c::IndexSort()
+{
+    if( std::adjacent_find( p_indexes, p_indexes + i_index,
+                            IndexEntryAfter ) == p_indexes + i_index )
+        return;
+
+    std::stable_sort( p_indexes, p_indexes + i_index, IndexEntryBefore );
+
+    track_indexes.clear();
+    for( int i = 0; i < i_index; i++ )
+        track_indexes[p_indexes[i].i_track].push_back( i );
+}
+
+/* Last entry of list with a time not after i_mk_time, or -1 */
+int matroska_segment_c::IndexFindIn( const std::vector<int> & list,
+                                     mtime_t i_mk_time ) const
+{
+    size_t i_low = 0, i_high = list.size();
+
+    while( i_low < i_high )
+    {
+        size_t i_mid = i_low + (i_high - i_low) / 2;
+        if( p_indexes[list[i_mid]].i_mk_time <= i_mk_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low > 0 ? list[i_low - 1] : -1;
+}
+
+/*
+ * Returns the last index entry at or before i_mk_time usable to seek the
+ * track numbered i_track: its own cues or the cluster entries.
+ * Any track cue is used when the track has none. Returns -1 if none.
+ */
+int matroska_segment_c::IndexFind( mtime_t i_mk_time, int i_track ) const
+{
+    std::map<int, std::vector<int> >::const_iterator it;
+
+    it = track_indexes.find( i_track );
+    if( i_track < 0 || it == track_indexes.end() )
+    {
+        /* binary search over every entry */
+        int i_low = 0, i_high = i_index;
+        while( i_low < i_high )
+        {
+            int i_mid = i_low + (i_high - i_low) / 2;
+            if( p_indexes[i_mid].i_mk_time <= i_mk_time )
+                i_low = i_mid + 1;
+            else
+                i_high = i_mid;
+        }
+        return i_low - 1;
+    }
+
+    int i_idx = IndexFindIn( it->second, i_mk_time );
+
+    it = track_indexes.find( -1 );
+    if( it != track_indexes.end() )
+        i_idx = __MAX( i_idx, IndexFindIn( it->second, i_mk_time ) );
+    return i_idx;
 }
 
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
 {
-    if ( b_preloaded )
+    if ( b_preloaded || !IsFamily( of_segment ) )
         return false;
 
+    return Preload( );
+}
+
+bool matroska_segment_c::IsFamily( const matroska_segment_c & of_segment ) const
+{
     for (size_t i=0; i<families.size(); i++)
     {
         for (size_t j=0; j<of_segment.families.size(); j++)
         {
             if ( *(families[i]) == *(of_segment.families[j]) )
-                return Preload( );
+                return true;
         }
     }
 
@@ -655,13 +794,16 @@ bool matroska_segment_c::CompareSegmentUIDs( const matroska_segment_c * p_item_a
     return false;
 }
 
-bool matroska_segment_c::Preload( )
+/* With b_defer_meta, the tags and attachments are only located, they are
+ * parsed by LoadDeferred() */
+bool matroska_segment_c::Preload( bool b_defer )
 {
     if ( b_preloaded )
         return false;
 
     EbmlElement *el = NULL;
 
+    b_defer_meta = b_defer;
     ep->Reset( &sys.demuxer );
 
     while( ( el = ep->Get() ) != NULL )
@@ -698,6 +840,7 @@ bool matroska_segment_c::Preload( )
             if ( tracks.size() == 0 )
             {
                 msg_Err( &sys.demuxer, "No tracks supported" );
+                b_defer_meta = false;
                 return false;
             }
             i_tracks_position = el->GetElementPosition();
@@ -729,7 +872,10 @@ bool matroska_segment_c::Preload( )
             msg_Dbg( &sys.demuxer, "|   + Attachments" );
             if( i_attachments_position < 0 )
             {
-                ParseAttachments( static_cast<KaxAttachments*>( el ) );
+                if( b_defer_meta )
+                    i_attachments_deferred = el->GetElementPosition();
+                else
+                    ParseAttachments( static_cast<KaxAttachments*>( el ) );
                 i_attachments_position = el->GetElementPosition();
             }
         }
@@ -747,7 +893,10 @@ bool matroska_segment_c::Preload( )
             msg_Dbg( &sys.demuxer, "|   + Tags" );
             if( i_tags_position < 0)
             {
-                LoadTags( static_cast<KaxTags*>( el ) );
+                if( b_defer_meta )
+                    i_tags_deferred = el->GetElementPosition();
+                else
+                    LoadTags( static_cast<KaxTags*>( el ) );
                 i_tags_position = el->GetElementPosition();
             }
         }
@@ -760,6 +909,18 @@ bool matroska_segment_c::Preload( )
     ComputeTrackPriority();
 
     b_preloaded = true;
+    b_defer_meta = false;
+
+    if( p_indexer != NULL )
+    {
+        if( b_cues || !p_indexer->Start( segment, i_start_pos, i_timescale ) )
+        {
+            delete p_indexer;
+            p_indexer = NULL;
+        }
+        else
+            IndexUpdate();
+    }
 
     EnsureDuration();
 
@@ -834,7 +995,10 @@ bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int
         msg_Dbg( &sys.demuxer, "|   + Attachments" );
         if( i_attachments_position < 0 )
         {
-            ParseAttachments( static_cast<KaxAttachments*>( el ) );
+            if( b_defer_meta )
+                i_attachments_deferred = i_element_position;
+            else
+                ParseAttachments( static_cast<KaxAttachments*>( el ) );
             i_attachments_position = i_element_position;
         }
     }
@@ -852,7 +1016,10 @@ bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int
         msg_Dbg( &sys.demuxer, "|   + Tags" );
         if( i_tags_position < 0 )
         {
-            LoadTags( static_cast<KaxTags*>( el ) );
+            if( b_defer_meta )
+                i_tags_deferred = i_element_position;
+            else
+                LoadTags( static_cast<KaxTags*>( el ) );
             i_tags_position = i_element_position;
         }
     }
@@ -866,6 +1033,23 @@ bool matroska_segment_c::LoadSeekHeadItem( const EbmlCallbacks & ClassInfos, int
     return true;
 }
 
+/* Parses the tags and attachments Preload() left aside */
+void matroska_segment_c::LoadDeferred()
+{
+    if( i_tags_deferred >= 0 )
+    {
+        i_tags_position = -1;
+        LoadSeekHeadItem( EBML_INFO(KaxTags), i_tags_deferred );
+        i_tags_deferred = -1;
+    }
+    if( i_attachments_deferred >= 0 )
+    {
+        i_attachments_position = -1;
+        LoadSeekHeadItem( EBML_INFO(KaxAttachments), i_attachments_deferred );
+        i_attachments_deferred = -1;
+    }
+}
+
 struct spoint
 {
     spoint(unsigned int tk, mtime_t mk_date, int64_t pos, int64_t cpos):
@@ -948,16 +1132,26 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
         return;
     }
 
-    int i_idx = 0;
-    if ( i_index > 0 )
+    /* The cues of the track the seek is done on, video first */
+    const int es_types[3] = { VIDEO_ES, AUDIO_ES, SPU_ES };
+    int i_seek_track = -1;
+    unsigned i_seek_tracks = 0;
+    for( int i = 0; i < 2 && i_seek_tracks == 0; i++ )
     {
+        for( i_track = 0; i_track < tracks.size(); i_track++ )
+        {
+            if( tracks[i_track]->fmt.i_cat == es_types[i]
+             && i_seek_tracks++ == 0 )
+                i_seek_track = tracks[i_track]->i_number;
+        }
+    }
 
-        for( ; i_idx < i_index; i_idx++ )
-            if( p_indexes[i_idx].i_mk_time != -1 && p_indexes[i_idx].i_mk_time + i_mk_time_offset > i_mk_date )
-                break;
-
-        if( i_idx > 0 )
-            i_idx--;
+    int i_idx = -1;
+    if ( i_index > 0 )
+    {
+        i_idx = IndexFind( i_mk_date - i_mk_time_offset, i_seek_track );
+        if( i_idx < 0 )
+            i_idx = 0;
 
         i_seek_position = p_indexes[i_idx].i_position;
         i_mk_seek_time = p_indexes[i_idx].i_mk_time;
@@ -975,7 +1169,6 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
     sys.i_start_pts = i_mk_date + VLC_TS_0;
 
     /* now parse until key frame */
-    const int es_types[3] = { VIDEO_ES, AUDIO_ES, SPU_ES };
     i_cat = es_types[0];
     mtime_t i_seek_preroll = 0;
     for( int i = 0; i < 2; i_cat = es_types[++i] )
@@ -1029,7 +1222,21 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
         return;
     }
     i_mk_date -= i_seek_preroll;
-    for(;;)
+
+    /* The cue gives the key frame block of the only track we wait for:
+     * it will be reached once its cluster is loaded below */
+    if( i_idx >= 0 && i_seek_tracks == 1 && i_seek_preroll == 0 &&
+        p_indexes[i_idx].i_track == i_seek_track &&
+        p_indexes[i_idx].i_relative_position >= 0 &&
+        p_indexes[i_idx].i_mk_time + i_mk_time_offset <= i_mk_date )
+    {
+        p_first->i_mk_date = sys.i_mk_chapter_time + p_indexes[i_idx].i_mk_time;
+        p_first->i_seek_pos = -1;
+        p_first->i_cluster_pos = p_indexes[i_idx].i_position;
+        b_has_key = true;
+    }
+
+    while( !b_has_key )
     {
         do
         {
@@ -1081,12 +1288,16 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
 
             delete block;
         } while( i_mk_pts < i_mk_date );
-        if( b_has_key || !i_idx )
+        if( b_has_key || i_idx < 0 )
+            break;
+
+        int i_prev = IndexFind( p_indexes[i_idx].i_mk_time - 1, i_seek_track );
+        if( i_prev < 0 )
             break;
 
         /* No key picture was found in the cluster seek to previous seekpoint */
         i_mk_date = i_mk_time_offset + p_indexes[i_idx].i_mk_time;
-        i_idx--;
+        i_idx = i_prev;
         i_mk_pts = 0;
         es.I_O().setFilePointer( p_indexes[i_idx].i_position );
         delete ep;
@@ -1113,6 +1324,9 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
         bool b_discardable_picture;
         BlockGet( block, simpleblock, &b_key_picture, &b_discardable_picture, &i_block_duration );
         delete block;
+        if( p_min->i_seek_pos < 0 && cluster != NULL )
+            p_min->i_seek_pos = cluster->GetElementPosition() + cluster->HeadSize() +
+                                p_indexes[i_idx].i_relative_position;
         cluster = (KaxCluster *) ep->UnGet( p_min->i_seek_pos, p_min->i_cluster_pos );
     }
 
@@ -1124,6 +1338,60 @@ void matroska_segment_c::Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int6
     }
 }
 
+/* Reads the SimpleBlock payload at the current position */
+int matroska_segment_c::SimpleBlockRead( uint64 i_size, mkv_simpleblock_t *p_sb )
+{
+    size_t i_track;
+
+    if( SimpleBlockReadHeader( es.I_O(), i_size, p_sb ) )
+    {
+        msg_Err( &sys.demuxer, "invalid SimpleBlock header" );
+        return VLC_EGENERIC;
+    }
+    /* Check blocks validity to protect againts broken files */
+    if( BlockFindTrackIndex( &i_track, p_sb->i_track ) )
+        return VLC_EGENERIC;
+
+    const mkv_track_t *tk = tracks[i_track];
+    size_t i_offset = 0;
+    if( tk->i_compression_type == MATROSKA_COMPRESSION_HEADER &&
+        tk->p_compression_data != NULL &&
+        tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
+        i_offset = tk->p_compression_data->GetSize();
+
+    if( SimpleBlockReadFrames( es.I_O(), p_sb, i_offset ) )
+    {
+        msg_Warn( &sys.demuxer, "Cannot read frame (too long or no frame)" );
+        return VLC_EGENERIC;
+    }
+
+    /* as KaxInternalBlock::GlobalTimecode() */
+    p_sb->i_global_timecode = cluster->GlobalTimecode() +
+                              (int64_t)p_sb->i_timecode * cluster->GlobalTimecodeScale();
+
+    /* update the index */
+    if( i_index > 0 && p_indexes[i_index - 1].i_mk_time == -1 )
+    {
+        p_indexes[i_index - 1].i_mk_time = p_sb->i_global_timecode / INT64_C(1000);
+        p_indexes[i_index - 1].b_key     = p_sb->b_key;
+    }
+    return VLC_SUCCESS;
+}
+
+int matroska_segment_c::BlockFindTrackIndex( size_t *pi_track, unsigned int i_track_number )
+{
+    for( size_t i_track = 0; i_track < tracks.size(); i_track++ )
+    {
+        if( tracks[i_track]->i_number == i_track_number )
+        {
+            if( pi_track )
+                *pi_track = i_track;
+            return VLC_SUCCESS;
+        }
+    }
+    return VLC_EGENERIC;
+}
+
 int matroska_segment_c::BlockFindTrackIndex( size_t *pi_track,
                                              const KaxBlock *p_block, const KaxSimpleBlock *p_simpleblock )
 {
@@ -1219,8 +1487,8 @@ void matroska_segment_c::EnsureDuration()
     uint64 i_current_position = es.I_O().getFilePointer();
     uint64 i_last_cluster_pos = 0;
 
-    // find the last Cluster from the Cues
-    if ( b_cues && i_index > 0 && p_indexes != NULL)
+    // find the last Cluster from the Cues or the complete index
+    if ( ( b_cues || b_indexed ) && i_index > 0 && p_indexes != NULL)
     {
         i_last_cluster_pos = p_indexes[i_index-1].i_position;
     }
@@ -1365,7 +1633,7 @@ void matroska_segment_c::UnSelect( )
     ep = NULL;
 }
 
-int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_simpleblock, bool *pb_key_picture, bool *pb_discardable_picture, int64_t *pi_duration )
+int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_simpleblock, bool *pb_key_picture, bool *pb_discardable_picture, int64_t *pi_duration, mkv_simpleblock_t *p_fast )
 {
     pp_simpleblock = NULL;
     pp_block = NULL;
@@ -1383,6 +1651,25 @@ int matroska_segment_c::BlockGet( KaxBlock * & pp_block, KaxSimpleBlock * & pp_s
         if ( ep == NULL )
             return VLC_EGENERIC;
 
+        /* SimpleBlocks of the cluster go straight to the frame blocks,
+         * without any libebml element */
+        uint64 i_size;
+        if( p_fast != NULL && pp_block == NULL && pp_simpleblock == NULL &&
+            cluster != NULL && ep->GetLevel() == 2 && ep->IsTopPresent( cluster ) &&
+            ep->GetSimpleBlock( &i_size ) )
+        {
+            const uint64 i_end = es.I_O().getFilePointer() + i_size;
+
+            if( i_size < SIZE_MAX && !SimpleBlockRead( i_size, p_fast ) )
+            {
+                *pb_key_picture         = p_fast->b_key;
+                *pb_discardable_picture = p_fast->b_discardable;
+                return VLC_SUCCESS;
+            }
+            es.I_O().setFilePointer( i_end, seek_beginning );
+            continue;
+        }
+
         if( pp_simpleblock != NULL || ((el = ep->Get()) == NULL && pp_block != NULL) )
         {
             /* Check blocks validity to protect againts broken files */
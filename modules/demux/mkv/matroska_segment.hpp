@@ -28,6 +28,7 @@
 #include "mkv.hpp"
 
 class EbmlParser;
+class cluster_indexer_c;
 
 class chapter_edition_c;
 class chapter_translation_c;
@@ -97,6 +98,10 @@ public:
     int64_t                 i_chapters_position;
     int64_t                 i_tags_position;
     int64_t                 i_attachments_position;
+    /* tags and attachments left for LoadDeferred() */
+    bool                    b_defer_meta;
+    int64_t                 i_tags_deferred;
+    int64_t                 i_attachments_deferred;
 
     KaxCluster              *cluster;
     uint64                  i_block_pos;
@@ -110,6 +115,12 @@ public:
     int                     i_index;
     int                     i_index_max;
     mkv_index_t             *p_indexes;
+    /* p_indexes entries of each track number, -1 for clusters */
+    std::map<int, std::vector<int> > track_indexes;
+    /* background cluster scan of segments without cues */
+    cluster_indexer_c       *p_indexer;
+    size_t                  i_indexer_fetched;
+    bool                    b_indexed; /* p_indexes holds every cluster */
 
     /* info */
     char                    *psz_muxing_application;
@@ -133,14 +144,23 @@ public:
     bool                           b_preloaded;
     bool                           b_ref_external_segments;
 
-    bool Preload();
+    bool Preload( bool b_defer_meta = false );
     bool PreloadFamily( const matroska_segment_c & segment );
+    bool IsFamily( const matroska_segment_c & segment ) const;
+    void LoadDeferred();
     void InformationCreate();
     void Seek( mtime_t i_mk_date, mtime_t i_mk_time_offset, int64_t i_global_position );
-    int BlockGet( KaxBlock * &, KaxSimpleBlock * &, bool *, bool *, int64_t *);
+    /* SimpleBlocks are read into p_simpleblock, with block and simpleblock
+     * set to NULL, when it is given */
+    int BlockGet( KaxBlock * &, KaxSimpleBlock * &, bool *, bool *, int64_t *,
+                  mkv_simpleblock_t *p_simpleblock = NULL );
+
+    int IndexFind( mtime_t i_mk_time, int i_track ) const;
+    void IndexUpdate();
 
     int BlockFindTrackIndex( size_t *pi_track,
                              const KaxBlock *, const KaxSimpleBlock * );
+    int BlockFindTrackIndex( size_t *pi_track, unsigned int i_track_number );
 
     bool Select( mtime_t i_mk_start_time );
     void UnSelect();
@@ -160,7 +180,11 @@ private:
     void ParseTrackEntry( KaxTrackEntry *m );
     void ParseCluster( KaxCluster *cluster, bool b_update_start_time = true, ScopeMode read_fully = SCOPE_ALL_DATA );
     SimpleTag * ParseSimpleTags( KaxTagSimple *tag, int level = 50 );
+    int SimpleBlockRead( uint64 i_size, mkv_simpleblock_t * );
+    void IndexAppend( const mkv_index_t & );
     void IndexAppendCluster( KaxCluster *cluster );
+    void IndexSort();
+    int IndexFindIn( const std::vector<int> &, mtime_t i_mk_time ) const;
     int32_t TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
     void EnsureDuration();
@@ -26,6 +26,7 @@
 #include "util.hpp"
 
 #include "matroska_segment.hpp"
+#include "cluster_index.hpp"
 #include "demux.hpp"
 
 #include "chapters.hpp"
@@ -74,6 +75,14 @@ vlc_module_begin ()
             N_("Dummy Elements"),
             N_("Read and discard unknown EBML elements (not good for broken files)."), true );
 
+    add_bool( "mkv-index-clusters", true,
+            N_("Index clusters in background"),
+            N_("Find the clusters of local files without cues after opening them, for faster seeking."), true );
+
+    add_bool( "mkv-index-cache", false,
+            N_("Store cluster index"),
+            N_("Keep the cluster index of files without cues in the cache directory."), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -132,6 +141,14 @@ static int Open( vlc_object_t * p_this )
     p_stream->p_io_callback = p_io_callback;
     p_stream->p_estream = p_io_stream;
 
+    /* Cueless segments of local files get their clusters indexed */
+    if( p_demux->psz_file && !strcmp( p_demux->psz_access, "file" ) &&
+        !p_stream->segments.empty() &&
+        var_InheritBool( p_demux, "mkv-index-clusters" ) )
+        p_stream->segments[0]->p_indexer =
+            new cluster_indexer_c( p_demux, p_demux->psz_file,
+                                   var_InheritBool( p_demux, "mkv-index-cache" ) );
+
     for (size_t i=0; i<p_stream->segments.size(); i++)
     {
         p_stream->segments[i]->Preload();
@@ -299,6 +316,10 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             ppp_attach = (input_attachment_t***)va_arg( args, input_attachment_t*** );
             pi_int = (int*)va_arg( args, int * );
 
+            vlc_mutex_lock( &p_sys->lock_demuxer );
+            p_sys->LoadDeferred();
+            vlc_mutex_unlock( &p_sys->lock_demuxer );
+
             if( p_sys->stored_attachments.size() <= 0 )
                 return VLC_EGENERIC;
 
@@ -317,6 +338,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         case DEMUX_GET_META:
             p_meta = (vlc_meta_t*)va_arg( args, vlc_meta_t* );
+            vlc_mutex_lock( &p_sys->lock_demuxer );
+            p_sys->LoadDeferred();
+            vlc_mutex_unlock( &p_sys->lock_demuxer );
             vlc_meta_Merge( p_meta, p_sys->meta );
             return VLC_SUCCESS;
 
@@ -455,20 +479,28 @@ static void Seek( demux_t *p_demux, mtime_t i_mk_date, double f_percent, virtual
         return;
     }
 
+    p_segment->IndexUpdate();
+    const bool b_index = p_segment->b_cues || p_segment->b_indexed;
+
     /* seek without index or without date */
-    if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !p_segment->b_cues || i_mk_date < 0 ))
+    if( f_percent >= 0 && (var_InheritBool( p_demux, "mkv-seek-percent" ) || !b_index || i_mk_date < 0 ))
     {
         i_mk_date = int64_t( f_percent * p_sys->f_duration * 1000.0 );
-        if( !p_segment->b_cues )
+        if( !b_index )
         {
             int64_t i_pos = int64_t( f_percent * stream_Size( p_demux->s ) );
 
             msg_Dbg( p_demux, "lengthy way of seeking for pos:%" PRId64, i_pos );
-            for( i_index = 0; i_index < p_segment->i_index; i_index++ )
+            /* without cues, the index only holds clusters in stream order */
+            int i_high = p_segment->i_index;
+            i_index = 0;
+            while( i_index < i_high )
             {
-                if( p_segment->p_indexes[i_index].i_position >= i_pos &&
-                    p_segment->p_indexes[i_index].i_mk_time != -1 )
-                    break;
+                int i_mid = i_index + (i_high - i_index) / 2;
+                if( p_segment->p_indexes[i_mid].i_position < i_pos )
+                    i_index = i_mid + 1;
+                else
+                    i_high = i_mid;
             }
             if( i_index == p_segment->i_index )
                 i_index--;
@@ -483,33 +515,15 @@ static void Seek( demux_t *p_demux, mtime_t i_mk_date, double f_percent, virtual
     p_vsegment->Seek( *p_demux, i_mk_date, p_chapter, i_global_position );
 }
 
-/* Needed by matroska_segment::Seek() and Seek */
-void BlockDecode( demux_t *p_demux, KaxBlock *block, KaxSimpleBlock *simpleblock,
-                  mtime_t i_pts, mtime_t i_duration, bool b_key_picture,
-                  bool b_discardable_picture )
+/* Checks the track is selected and sends its init data once */
+static bool TrackPrepare( demux_t *p_demux, mkv_track_t *tk )
 {
-    demux_sys_t        *p_sys = p_demux->p_sys;
-    matroska_segment_c *p_segment = p_sys->p_current_segment->CurrentSegment();
-
-    if( !p_segment ) return;
-
-    size_t          i_track;
-    if( p_segment->BlockFindTrackIndex( &i_track, block, simpleblock ) )
-    {
-        msg_Err( p_demux, "invalid track number" );
-        return;
-    }
-
-    mkv_track_t *tk = p_segment->tracks[i_track];
-
     if( tk->fmt.i_cat != NAV_ES && tk->p_es == NULL )
     {
         msg_Err( p_demux, "unknown track number" );
-        return;
+        return false;
     }
 
-    i_pts -= tk->i_codec_delay;
-
     if ( tk->fmt.i_cat != NAV_ES )
     {
         bool b;
@@ -520,7 +534,7 @@ void BlockDecode( demux_t *p_demux, KaxBlock *block, KaxSimpleBlock *simpleblock
             tk->b_inited = false;
             if( tk->fmt.i_cat == VIDEO_ES || tk->fmt.i_cat == AUDIO_ES )
                 tk->i_last_dts = VLC_TS_INVALID;
-            return;
+            return false;
         }
     }
 
@@ -535,7 +549,142 @@ void BlockDecode( demux_t *p_demux, KaxBlock *block, KaxSimpleBlock *simpleblock
         if( p_init ) send_Block( p_demux, tk, p_init, 1, 0 );
     }
     tk->b_inited = true;
+    return true;
+}
+
+/* Decodes and sends one frame, with room left in front of it for the header
+ * compression data. Returns false when the following frames must be dropped. */
+static bool FrameSend( demux_t *p_demux, matroska_segment_c *p_segment,
+                       mkv_track_t *tk, block_t *p_block, mtime_t *pi_pts,
+                       unsigned int i_number_frames, mtime_t i_duration,
+                       bool b_key_picture, bool b_discardable_picture )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    mtime_t     i_pts = *pi_pts;
+
+#if defined(HAVE_ZLIB_H)
+    if( tk->i_compression_type == MATROSKA_COMPRESSION_ZLIB &&
+        tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
+    {
+        p_block = block_zlib_decompress( VLC_OBJECT(p_demux), p_block );
+        if( p_block == NULL )
+            return false;
+    }
+    else
+#endif
+    if( tk->i_compression_type == MATROSKA_COMPRESSION_HEADER &&
+        tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
+    {
+        memcpy( p_block->p_buffer, tk->p_compression_data->GetBuffer(), tk->p_compression_data->GetSize() );
+    }
+
+    if ( b_key_picture )
+        p_block->i_flags |= BLOCK_FLAG_TYPE_I;
+
+    switch( tk->fmt.i_codec )
+    {
+    case VLC_CODEC_COOK:
+    case VLC_CODEC_ATRAC3:
+    {
+        handle_real_audio(p_demux, tk, p_block, i_pts);
+        block_Release(p_block);
+        *pi_pts = ( tk->i_default_duration )?
+            i_pts + ( mtime_t )tk->i_default_duration:
+            VLC_TS_INVALID;
+        return true;
+     }
+
+    case VLC_CODEC_DTS:
+        /* Check if packetization is correct and without padding.
+         * example: Test_mkv_div3_DTS_1920x1080_1785Kbps_23,97fps.mkv */
+        if( p_block->i_buffer > 6 )
+        {
+            unsigned int a, b, c, d;
+            bool e;
+            int i_frame_size = GetSyncInfo( p_block->p_buffer, &e, &a, &b, &c, &d );
+            if( i_frame_size > 0 )
+                p_block->i_buffer = __MIN(p_block->i_buffer, (size_t)i_frame_size);
+        }
+        break;
+
+     case VLC_CODEC_OPUS:
+        mtime_t i_length = i_duration * tk-> f_timecodescale *
+                (double) p_segment->i_timescale / 1000.0;
+        if ( i_length < 0 ) i_length = 0;
+        p_block->i_nb_samples = i_length * tk->fmt.audio.i_rate
+                / CLOCK_FREQ;
+        break;
+    }
+
+    if( tk->fmt.i_cat != VIDEO_ES )
+    {
+        if ( tk->fmt.i_cat == NAV_ES )
+        {
+            // TODO handle the start/stop times of this packet
+            p_sys->p_ev->SetPci( (const pci_t *)&p_block->p_buffer[1]);
+            block_Release( p_block );
+            return false;
+        }
+        p_block->i_dts = p_block->i_pts = i_pts;
+    }
+    else
+    {
+        // correct timestamping when B frames are used
+        if( tk->b_dts_only )
+        {
+            p_block->i_pts = VLC_TS_INVALID;
+            p_block->i_dts = i_pts;
+        }
+        else if( tk->b_pts_only )
+        {
+            p_block->i_pts = i_pts;
+            p_block->i_dts = i_pts;
+        }
+        else
+        {
+            p_block->i_pts = i_pts;
+            // condition when the DTS is correct (keyframe or B frame == NOT P frame)
+            if ( b_key_picture || b_discardable_picture )
+                p_block->i_dts = p_block->i_pts;
+            else if ( tk->i_last_dts == VLC_TS_INVALID )
+                p_block->i_dts = i_pts;
+            else
+                p_block->i_dts = min( i_pts, tk->i_last_dts + ( mtime_t )tk->i_default_duration );
+        }
+    }
+
+    send_Block( p_demux, tk, p_block, i_number_frames, i_duration );
+
+    /* use time stamp only for first block */
+    *pi_pts = ( tk->i_default_duration )?
+             i_pts + ( mtime_t )tk->i_default_duration:
+             ( tk->fmt.b_packetized ) ? VLC_TS_INVALID : i_pts + 1;
+    return true;
+}
+
+/* Needed by matroska_segment::Seek() and Seek */
+void BlockDecode( demux_t *p_demux, KaxBlock *block, KaxSimpleBlock *simpleblock,
+                  mtime_t i_pts, mtime_t i_duration, bool b_key_picture,
+                  bool b_discardable_picture )
+{
+    demux_sys_t        *p_sys = p_demux->p_sys;
+    matroska_segment_c *p_segment = p_sys->p_current_segment->CurrentSegment();
+
+    if( !p_segment ) return;
+
+    size_t          i_track;
+    if( p_segment->BlockFindTrackIndex( &i_track, block, simpleblock ) )
+    {
+        msg_Err( p_demux, "invalid track number" );
+        return;
+    }
 
+    mkv_track_t *tk = p_segment->tracks[i_track];
+
+    if( !TrackPrepare( p_demux, tk ) )
+        return;
+
+    i_pts -= tk->i_codec_delay;
 
     size_t frame_size = 0;
     size_t block_size = 0;
@@ -580,104 +729,64 @@ void BlockDecode( demux_t *p_demux, KaxBlock *block, KaxSimpleBlock *simpleblock
             break;
         }
 
-#if defined(HAVE_ZLIB_H)
-        if( tk->i_compression_type == MATROSKA_COMPRESSION_ZLIB &&
-            tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
-        {
-            p_block = block_zlib_decompress( VLC_OBJECT(p_demux), p_block );
-            if( p_block == NULL )
-                break;
-        }
-        else
-#endif
-        if( tk->i_compression_type == MATROSKA_COMPRESSION_HEADER &&
-            tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES )
-        {
-            memcpy( p_block->p_buffer, tk->p_compression_data->GetBuffer(), tk->p_compression_data->GetSize() );
-        }
+        if( !FrameSend( p_demux, p_segment, tk, p_block, &i_pts, i_number_frames,
+                        i_duration, b_key_picture, b_discardable_picture ) )
+            break;
+    }
+}
 
-        if ( b_key_picture )
-            p_block->i_flags |= BLOCK_FLAG_TYPE_I;
+/* Same as BlockDecode() for the frames read by SimpleBlockRead(),
+ * which are released */
+static void SimpleBlockDecode( demux_t *p_demux, matroska_segment_c *p_segment,
+                               mkv_simpleblock_t *p_sb, mtime_t i_pts,
+                               mtime_t i_duration )
+{
+    block_t *p_frames = p_sb->p_frames;
+    size_t  i_track;
 
-        switch( tk->fmt.i_codec )
-        {
-        case VLC_CODEC_COOK:
-        case VLC_CODEC_ATRAC3:
-        {
-            handle_real_audio(p_demux, tk, p_block, i_pts);
-            block_Release(p_block);
-            i_pts = ( tk->i_default_duration )?
-                i_pts + ( mtime_t )tk->i_default_duration:
-                VLC_TS_INVALID;
-            continue;
-         }
-
-        case VLC_CODEC_DTS:
-            /* Check if packetization is correct and without padding.
-             * example: Test_mkv_div3_DTS_1920x1080_1785Kbps_23,97fps.mkv */
-            if( p_block->i_buffer > 6 )
-            {
-                unsigned int a, b, c, d;
-                bool e;
-                int i_frame_size = GetSyncInfo( p_block->p_buffer, &e, &a, &b, &c, &d );
-                if( i_frame_size > 0 )
-                    p_block->i_buffer = __MIN(p_block->i_buffer, (size_t)i_frame_size);
-            }
-            break;
+    p_sb->p_frames = NULL;
+    if( p_segment->BlockFindTrackIndex( &i_track, p_sb->i_track ) )
+    {
+        msg_Err( p_demux, "invalid track number" );
+        block_ChainRelease( p_frames );
+        return;
+    }
 
-         case VLC_CODEC_OPUS:
-            mtime_t i_length = i_duration * tk-> f_timecodescale *
-                    (double) p_segment->i_timescale / 1000.0;
-            if ( i_length < 0 ) i_length = 0;
-            p_block->i_nb_samples = i_length * tk->fmt.audio.i_rate
-                    / CLOCK_FREQ;
-            break;
-        }
+    mkv_track_t *tk = p_segment->tracks[i_track];
 
-        if( tk->fmt.i_cat != VIDEO_ES )
-        {
-            if ( tk->fmt.i_cat == NAV_ES )
-            {
-                // TODO handle the start/stop times of this packet
-                p_sys->p_ev->SetPci( (const pci_t *)&p_block->p_buffer[1]);
-                block_Release( p_block );
-                return;
-            }
-            p_block->i_dts = p_block->i_pts = i_pts;
-        }
-        else
+    if( !TrackPrepare( p_demux, tk ) )
+    {
+        block_ChainRelease( p_frames );
+        return;
+    }
+
+    i_pts -= tk->i_codec_delay;
+
+    const bool b_header = tk->i_compression_type == MATROSKA_COMPRESSION_HEADER &&
+                          tk->p_compression_data != NULL &&
+                          tk->i_encoding_scope & MATROSKA_ENCODING_SCOPE_ALL_FRAMES;
+    while( p_frames != NULL )
+    {
+        block_t *p_block = p_frames;
+
+        p_frames = p_block->p_next;
+        p_block->p_next = NULL;
+
+        if( !b_header && unlikely( tk->fmt.i_codec == VLC_CODEC_WAVPACK ) )
         {
-            // correct timestamping when B frames are used
-            if( tk->b_dts_only )
-            {
-                p_block->i_pts = VLC_TS_INVALID;
-                p_block->i_dts = i_pts;
-            }
-            else if( tk->b_pts_only )
-            {
-                p_block->i_pts = i_pts;
-                p_block->i_dts = i_pts;
-            }
-            else
-            {
-                p_block->i_pts = i_pts;
-                // condition when the DTS is correct (keyframe or B frame == NOT P frame)
-                if ( b_key_picture || b_discardable_picture )
-                    p_block->i_dts = p_block->i_pts;
-                else if ( tk->i_last_dts == VLC_TS_INVALID )
-                    p_block->i_dts = i_pts;
-                else
-                    p_block->i_dts = min( i_pts, tk->i_last_dts + ( mtime_t )tk->i_default_duration );
-            }
+            block_t *p_packet = packetize_wavpack( tk, p_block->p_buffer,
+                                                   p_block->i_buffer );
+            block_Release( p_block );
+            if( p_packet == NULL )
+                break;
+            p_block = p_packet;
         }
 
-        send_Block( p_demux, tk, p_block, i_number_frames, i_duration );
-
-        /* use time stamp only for first block */
-        i_pts = ( tk->i_default_duration )?
-                 i_pts + ( mtime_t )tk->i_default_duration:
-                 ( tk->fmt.b_packetized ) ? VLC_TS_INVALID : i_pts + 1;
+        if( !FrameSend( p_demux, p_segment, tk, p_block, &i_pts, p_sb->i_frames,
+                        i_duration, p_sb->b_key, p_sb->b_discardable ) )
+            break;
     }
+    block_ChainRelease( p_frames );
 }
 
 /*****************************************************************************
@@ -717,10 +826,11 @@ static int Demux( demux_t *p_demux)
 
         KaxBlock *block;
         KaxSimpleBlock *simpleblock;
+        mkv_simpleblock_t fast;
         int64_t i_block_duration = 0;
         bool b_key_picture;
         bool b_discardable_picture;
-        if( p_segment->BlockGet( block, simpleblock, &b_key_picture, &b_discardable_picture, &i_block_duration ) )
+        if( p_segment->BlockGet( block, simpleblock, &b_key_picture, &b_discardable_picture, &i_block_duration, &fast ) )
         {
             if ( p_vsegment->CurrentEdition() && p_vsegment->CurrentEdition()->b_ordered )
             {
@@ -745,7 +855,11 @@ static int Demux( demux_t *p_demux)
             }
         }
 
-        if( simpleblock != NULL )
+        /* SimpleBlocks come in fast, the others from libmatroska */
+        const bool b_fast = block == NULL && simpleblock == NULL;
+        if( b_fast )
+            p_sys->i_pts = (mtime_t)fast.i_global_timecode / INT64_C(1000);
+        else if( simpleblock != NULL )
             p_sys->i_pts = (mtime_t)simpleblock->GlobalTimecode() / INT64_C(1000);
         else
             p_sys->i_pts = (mtime_t)block->GlobalTimecode() / INT64_C(1000);
@@ -757,6 +871,8 @@ static int Demux( demux_t *p_demux)
             {
                 i_return = 1;
                 delete block;
+                if( b_fast )
+                    block_ChainRelease( fast.p_frames );
                 break;
             }
         }
@@ -767,10 +883,15 @@ static int Demux( demux_t *p_demux)
         {
             /* nothing left to read in this ordered edition */
             delete block;
+            if( b_fast )
+                block_ChainRelease( fast.p_frames );
             break;
         }
 
-        BlockDecode( p_demux, block, simpleblock, p_sys->i_pts, i_block_duration, b_key_picture, b_discardable_picture );
+        if( b_fast )
+            SimpleBlockDecode( p_demux, p_segment, &fast, p_sys->i_pts, i_block_duration );
+        else
+            BlockDecode( p_demux, block, simpleblock, p_sys->i_pts, i_block_duration, b_key_picture, b_discardable_picture );
 
         delete block;
 
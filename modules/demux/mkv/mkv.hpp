@@ -58,6 +58,7 @@
 #include <typeinfo>
 #include <string>
 #include <vector>
+#include <map>
 #include <algorithm>
 
 /* libebml and matroska */
@@ -250,10 +251,26 @@ struct mkv_index_t
     int     i_block_number;
 
     int64_t i_position;
+    int64_t i_relative_position; /* of the block in the cluster data */
     mtime_t i_mk_time;
 
     bool       b_key;
 };
 
+/* SimpleBlock read straight from the stream, see SimpleBlockReadHeader() */
+#define MKV_LACED_FRAMES_MAX 256
+struct mkv_simpleblock_t
+{
+    unsigned int i_track;       /* track number */
+    int16_t      i_timecode;    /* relative to the cluster */
+    bool         b_key;
+    bool         b_discardable;
+
+    unsigned int i_frames;
+    uint64_t     pi_frame_size[MKV_LACED_FRAMES_MAX];
+    block_t      *p_frames;     /* once read, one block per frame */
+    int64_t      i_global_timecode;
+};
+
 
 #endif /* _MKV_HPP_ */
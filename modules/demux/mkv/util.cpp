@@ -167,6 +167,183 @@ block_t *MemToBlock( uint8_t *p_mem, size_t i_mem, size_t offset)
     return p_block;
 }
 
+/*****************************************************************************
+ * SimpleBlock reader
+ *****************************************************************************
+ * Reads a SimpleBlock payload from the current position of the stream: the
+ * header first, then each (laced) frame directly into its own block_t,
+ * without the libmatroska buffers and the copy from them.
+ *****************************************************************************/
+static bool ReadBytes( IOCallback & io, uint8_t *p_buf, size_t i_buf,
+                       uint64_t *pi_left )
+{
+    if( i_buf > *pi_left || io.read( p_buf, i_buf ) != i_buf )
+        return false;
+    *pi_left -= i_buf;
+    return true;
+}
+
+static bool ReadVint( IOCallback & io, uint64_t *pi_value, unsigned *pi_length,
+                      uint64_t *pi_left )
+{
+    uint8_t p_buf[8];
+
+    if( !ReadBytes( io, p_buf, 1, pi_left ) || p_buf[0] == 0 )
+        return false;
+
+    unsigned i_length = 1;
+    uint8_t i_mask = 0x80;
+    while( !( p_buf[0] & i_mask ) )
+    {
+        i_mask >>= 1;
+        i_length++;
+    }
+    if( i_length > 1 && !ReadBytes( io, &p_buf[1], i_length - 1, pi_left ) )
+        return false;
+
+    uint64_t i_value = p_buf[0] & ( i_mask - 1 );
+    for( unsigned i = 1; i < i_length; i++ )
+        i_value = ( i_value << 8 ) | p_buf[i];
+
+    *pi_value = i_value;
+    if( pi_length )
+        *pi_length = i_length;
+    return true;
+}
+
+/* Adds a laced frame size, checked as soon as it is read so that the sum
+ * of the sizes cannot wrap */
+static bool LaceAdd( uint64_t *pi_total, uint64_t i_frame, uint64_t i_left )
+{
+    if( *pi_total > i_left || i_frame > i_left - *pi_total )
+        return false;
+    *pi_total += i_frame;
+    return true;
+}
+
+int SimpleBlockReadHeader( IOCallback & io, uint64_t i_size, mkv_simpleblock_t *p_sb )
+{
+    uint64_t i_left = i_size;
+    uint64_t i_track;
+    uint8_t  p_header[3];
+
+    p_sb->p_frames = NULL;
+
+    if( !ReadVint( io, &i_track, NULL, &i_left ) ||
+        !ReadBytes( io, p_header, 3, &i_left ) )
+        return VLC_EGENERIC;
+
+    p_sb->i_track       = i_track;
+    p_sb->i_timecode    = (int16_t)GetWBE( p_header );
+    p_sb->b_key         = p_header[2] & 0x80;
+    p_sb->b_discardable = p_header[2] & 0x01;
+
+    const unsigned i_lacing = ( p_header[2] >> 1 ) & 0x03;
+    if( i_lacing == 0 )
+    {
+        p_sb->i_frames = 1;
+        p_sb->pi_frame_size[0] = i_left;
+        return VLC_SUCCESS;
+    }
+
+    uint8_t i_count;
+    if( !ReadBytes( io, &i_count, 1, &i_left ) )
+        return VLC_EGENERIC;
+    p_sb->i_frames = i_count + 1;
+
+    uint64_t i_total = 0;
+    switch( i_lacing )
+    {
+        case 0x01: /* Xiph */
+            for( unsigned i = 0; i < p_sb->i_frames - 1; i++ )
+            {
+                uint64_t i_frame = 0;
+                uint8_t i_byte;
+                do
+                {
+                    if( !ReadBytes( io, &i_byte, 1, &i_left ) )
+                        return VLC_EGENERIC;
+                    i_frame += i_byte;
+                } while( i_byte == 0xff );
+                if( !LaceAdd( &i_total, i_frame, i_left ) )
+                    return VLC_EGENERIC;
+                p_sb->pi_frame_size[i] = i_frame;
+            }
+            break;
+
+        case 0x02: /* fixed */
+            if( i_left % p_sb->i_frames )
+                return VLC_EGENERIC;
+            for( unsigned i = 0; i < p_sb->i_frames; i++ )
+                p_sb->pi_frame_size[i] = i_left / p_sb->i_frames;
+            return VLC_SUCCESS;
+
+        case 0x03: /* EBML: the first size, then signed differences */
+        {
+            uint64_t i_frame;
+            if( p_sb->i_frames < 2 )
+                break;
+            if( !ReadVint( io, &i_frame, NULL, &i_left ) ||
+                !LaceAdd( &i_total, i_frame, i_left ) )
+                return VLC_EGENERIC;
+            p_sb->pi_frame_size[0] = i_frame;
+
+            for( unsigned i = 1; i < p_sb->i_frames - 1; i++ )
+            {
+                uint64_t i_value;
+                unsigned i_length;
+                if( !ReadVint( io, &i_value, &i_length, &i_left ) )
+                    return VLC_EGENERIC;
+
+                int64_t i_delta = (int64_t)i_value -
+                                  ( ( INT64_C(1) << ( 7 * i_length - 1 ) ) - 1 );
+                if( i_delta < 0 && (uint64_t)-i_delta > i_frame )
+                    return VLC_EGENERIC;
+                i_frame += i_delta;
+                if( !LaceAdd( &i_total, i_frame, i_left ) )
+                    return VLC_EGENERIC;
+                p_sb->pi_frame_size[i] = i_frame;
+            }
+            break;
+        }
+    }
+
+    if( i_total > i_left )
+        return VLC_EGENERIC;
+    p_sb->pi_frame_size[p_sb->i_frames - 1] = i_left - i_total;
+    return VLC_SUCCESS;
+}
+
+/* i_offset bytes are left in front of each frame */
+int SimpleBlockReadFrames( IOCallback & io, mkv_simpleblock_t *p_sb, size_t i_offset )
+{
+    block_t **pp_last = &p_sb->p_frames;
+
+    for( unsigned i = 0; i < p_sb->i_frames; i++ )
+    {
+        const uint64_t i_frame = p_sb->pi_frame_size[i];
+        block_t *p_block = NULL;
+
+        if( likely( i_frame <= UINT32_MAX - i_offset ) )
+            p_block = block_Alloc( i_offset + i_frame );
+        if( unlikely( p_block == NULL ) )
+            goto error;
+
+        if( io.read( p_block->p_buffer + i_offset, i_frame ) != i_frame )
+        {
+            block_Release( p_block );
+            goto error;
+        }
+        *pp_last = p_block;
+        pp_last = &p_block->p_next;
+    }
+    return VLC_SUCCESS;
+
+error:
+    block_ChainRelease( p_sb->p_frames );
+    p_sb->p_frames = NULL;
+    return VLC_EGENERIC;
+}
 
 void handle_real_audio(demux_t * p_demux, mkv_track_t * p_tk, block_t * p_blk, mtime_t i_pts)
 {
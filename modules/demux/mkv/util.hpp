@@ -34,6 +34,9 @@ block_t *MemToBlock( uint8_t *p_mem, size_t i_mem, size_t offset);
 void handle_real_audio(demux_t * p_demux, mkv_track_t * p_tk, block_t * p_blk, mtime_t i_pts);
 void send_Block( demux_t * p_demux, mkv_track_t * p_tk, block_t * p_block, unsigned int i_number_frames, mtime_t i_duration );
 
+int SimpleBlockReadHeader( IOCallback &, uint64_t i_size, mkv_simpleblock_t * );
+int SimpleBlockReadFrames( IOCallback &, mkv_simpleblock_t *, size_t i_offset );
+
 
 struct real_audio_private
 {
@@ -118,6 +118,7 @@ struct demux_sys_t
 static void MP4_TrackCreate ( demux_t *, mp4_track_t *, MP4_Box_t  *, bool b_force_enable );
 static int MP4_frg_TrackCreate( demux_t *, mp4_track_t *, MP4_Box_t *);
 static void MP4_TrackDestroy(  mp4_track_t * );
+static int TrackLoadChunkTimes( demux_t *, mp4_track_t *, uint32_t );
 
 static block_t * MP4_Block_Read( demux_t *, const mp4_track_t *, int );
 static void MP4_Block_Send( demux_t *, mp4_track_t *, block_t * );
@@ -238,7 +239,10 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     if( p_sys->b_fragmented )
         p_chunk = p_track->cchunk;
     else
+    {
+        TrackLoadChunkTimes( p_demux, p_track, p_track->i_chunk );
         p_chunk = &p_track->chunk[p_track->i_chunk];
+    }
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
@@ -292,7 +296,10 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
     if( p_sys->b_fragmented )
         ck = p_track->cchunk;
     else
+    {
+        TrackLoadChunkTimes( p_demux, p_track, p_track->i_chunk );
         ck = &p_track->chunk[p_track->i_chunk];
+    }
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
@@ -1978,6 +1985,131 @@ static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
     return VLC_SUCCESS;
 }
 
+/* Walks the i_sample_count samples of a chunk through the i_entries runs
+ * they take in a stts or ctts table, starting at *pi_index with *pi_left
+ * samples left in that entry (0 for all of them). The chunk runs are stored
+ * when p_count and p_value are given. */
+static void xTTS_Walk( uint32_t *pi_index, uint32_t *pi_left,
+                       uint32_t i_sample_count, uint32_t i_entries,
+                       const uint32_t *pi_table_count,
+                       const int32_t *pi_table_value,
+                       uint32_t *p_count, int32_t *p_value,
+                       mtime_t *pi_dts, uint64_t *pi_last_dts )
+{
+    uint32_t i_index = *pi_index;
+    uint32_t i_left = *pi_left;
+
+    for( uint32_t i = 0; i < i_entries; i++ )
+    {
+        uint32_t i_run = i_left ? i_left : pi_table_count[i_index];
+
+        if( i_run > i_sample_count )
+        {
+            /* keep building from same index */
+            i_left = i_run - i_sample_count;
+            i_run = i_sample_count;
+        }
+        else
+        {
+            i_left = 0;
+        }
+
+        if( p_count )
+        {
+            p_count[i] = i_run;
+            p_value[i] = pi_table_value[i_index];
+        }
+        if( pi_dts )
+        {
+            if( i_run )
+                *pi_last_dts = *pi_dts;
+            *pi_dts += (mtime_t)i_run * pi_table_value[i_index];
+        }
+
+        i_sample_count -= i_run;
+        if( i_left == 0 )
+            i_index++;
+        else
+        {
+            assert( i == i_entries - 1 );
+            break;
+        }
+    }
+
+    *pi_index = i_index;
+    *pi_left = i_left;
+}
+
+/* Builds the dts and pts tables of a chunk from the stts and ctts boxes,
+ * dropping those of the chunk that was read the longest time ago */
+static int TrackLoadChunkTimes( demux_t *p_demux, mp4_track_t *p_track,
+                                uint32_t i_chunk )
+{
+    mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+
+    if( ( ck->i_entries_dts == 0 || ck->p_sample_count_dts != NULL ) &&
+        ( ck->i_entries_pts == 0 || ck->p_sample_count_pts != NULL ) )
+        return VLC_SUCCESS;
+
+    if( p_track->i_chunk_cache >= MP4_CHUNK_CACHE )
+    {
+        uint32_t i_old = p_track->chunk_cache[p_track->i_chunk_cache % MP4_CHUNK_CACHE];
+        mp4_chunk_t *old = &p_track->chunk[i_old];
+
+        FREENULL( old->p_sample_count_dts );
+        FREENULL( old->p_sample_delta_dts );
+        FREENULL( old->p_sample_count_pts );
+        FREENULL( old->p_sample_offset_pts );
+    }
+    p_track->chunk_cache[p_track->i_chunk_cache++ % MP4_CHUNK_CACHE] = i_chunk;
+
+    MP4_Box_t *p_stts = MP4_BoxGet( p_track->p_stbl, "stts" );
+    if( ck->i_entries_dts > 0 && p_stts && BOXDATA(p_stts) )
+    {
+        uint32_t i_index = ck->i_stts_index;
+        uint32_t i_left = ck->i_stts_left;
+
+        ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
+        ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
+        if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
+        {
+            FREENULL( ck->p_sample_count_dts );
+            FREENULL( ck->p_sample_delta_dts );
+            msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
+            ck->i_entries_dts = 0;
+            return VLC_ENOMEM;
+        }
+        xTTS_Walk( &i_index, &i_left, ck->i_sample_count, ck->i_entries_dts,
+                   BOXDATA(p_stts)->pi_sample_count, BOXDATA(p_stts)->pi_sample_delta,
+                   ck->p_sample_count_dts, (int32_t *)ck->p_sample_delta_dts,
+                   NULL, NULL );
+    }
+
+    MP4_Box_t *p_ctts = MP4_BoxGet( p_track->p_stbl, "ctts" );
+    if( ck->i_entries_pts > 0 && p_ctts && BOXDATA(p_ctts) )
+    {
+        uint32_t i_index = ck->i_ctts_index;
+        uint32_t i_left = ck->i_ctts_left;
+
+        ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
+        ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
+        if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
+        {
+            FREENULL( ck->p_sample_count_pts );
+            FREENULL( ck->p_sample_offset_pts );
+            msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
+            ck->i_entries_pts = 0;
+            return VLC_ENOMEM;
+        }
+        xTTS_Walk( &i_index, &i_left, ck->i_sample_count, ck->i_entries_pts,
+                   BOXDATA(p_ctts)->pi_sample_count, BOXDATA(p_ctts)->pi_sample_offset,
+                   ck->p_sample_count_pts, ck->p_sample_offset_pts,
+                   NULL, NULL );
+    }
+
+    return VLC_SUCCESS;
+}
+
 static int TrackCreateSamplesIndex( demux_t *p_demux,
                                     mp4_track_t *p_demux_track )
 {
@@ -2010,18 +2142,10 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     else
     {
-        /* 2: each sample can have a different size */
+        /* 2: each sample can have a different size, the box table is used
+         * as is */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+        p_demux_track->p_sample_size = stsz->i_entry_size;
     }
 
     if ( p_demux_track->i_chunk_count )
@@ -2054,12 +2178,9 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
     /* Use stts table to create a sample number -> dts table.
      * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
-
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
+     *  the box! so each chunk only keeps its position in the stts and ctts
+     *  tables, its "extract" of them being built when it is read, see
+     *  TrackLoadChunkTimes() */
 
     mtime_t i_next_dts = 0;
     /* Find stts
@@ -2077,18 +2198,19 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
 
-        /* Create sample -> dts table per chunk */
+        /* Locate each chunk in the table and compute its dts */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
+            uint64_t i_last_dts = i_next_dts;
 
             /* save first dts */
             ck->i_first_dts = i_next_dts;
-            ck->i_last_dts  = i_next_dts;
+            ck->i_stts_index = i_index;
+            ck->i_stts_left = i_current_index_samples_left;
 
             /* count how many entries are needed for this chunk
              * for p_sample_delta_dts and p_sample_count_dts */
@@ -2102,72 +2224,11 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
             if ( i_ret == VLC_EGENERIC )
                 return i_ret;
 
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        if ( i_current_index_samples_left ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        if ( i_sample_count ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        if ( stts->pi_sample_count[i_index] ) ck->i_last_dts = i_next_dts;
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-            }
+            xTTS_Walk( &i_index, &i_current_index_samples_left,
+                       ck->i_sample_count, ck->i_entries_dts,
+                       stts->pi_sample_count, stts->pi_sample_delta,
+                       NULL, NULL, &i_next_dts, &i_last_dts );
+            ck->i_last_dts = i_last_dts;
         }
     }
 
@@ -2182,14 +2243,16 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
 
-        /* Create pts-dts table per chunk */
+        /* Locate each chunk in the table */
         uint32_t i_index = 0;
         uint32_t i_current_index_samples_left = 0;
 
         for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
         {
             mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
+
+            ck->i_ctts_index = i_index;
+            ck->i_ctts_left = i_current_index_samples_left;
 
             /* count how many entries are needed for this chunk
              * for p_sample_offset_pts and p_sample_count_pts */
@@ -2202,65 +2265,10 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
             if ( i_ret == VLC_EGENERIC )
                 return i_ret;
 
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-            {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
-            }
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index];
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
-            }
+            xTTS_Walk( &i_index, &i_current_index_samples_left,
+                       ck->i_sample_count, ck->i_entries_pts,
+                       ctts->pi_sample_count, ctts->pi_sample_offset,
+                       NULL, NULL, NULL, NULL );
         }
     }
 
@@ -2490,6 +2498,8 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     }
 
     /* *** find sample in the chunk *** */
+    if( TrackLoadChunkTimes( p_demux, p_track, i_chunk ) )
+        return VLC_ENOMEM;
     i_sample = p_track->chunk[i_chunk].i_sample_first;
     i_dts    = p_track->chunk[i_chunk].i_first_dts;
     for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
@@ -2924,15 +2934,13 @@ static void MP4_TrackDestroy( mp4_track_t *p_track )
         }
     }
     FREENULL( p_track->chunk );
+    p_track->i_chunk_cache = 0;
     if( p_track->cchunk ) {
         FreeAndResetChunk( p_track->cchunk );
         FREENULL( p_track->cchunk );
     }
 
-    if( !p_track->i_sample_size )
-    {
-        FREENULL( p_track->p_sample_size );
-    }
+    p_track->p_sample_size = NULL;
 
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
@@ -4753,6 +4761,8 @@ static int LeafParseMDATwithMOOV( demux_t *p_demux )
         }
         /**/
 
+        if( TrackLoadChunkTimes( p_demux, p_track, i_chunk ) )
+            goto error;
         mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
 
         uint32_t i_nb_samples_at_chunk_start = p_chunk->i_sample_first;
@@ -57,6 +57,13 @@ typedef struct
     uint32_t     *p_sample_count_pts;
     int32_t      *p_sample_offset_pts;  /* pts-dts */
 
+    /* position of the first sample in the stts and ctts tables: the
+     * tables above are only built for the chunks being read */
+    uint32_t     i_stts_index;
+    uint32_t     i_stts_left;   /* samples left in the stts entry */
+    uint32_t     i_ctts_index;
+    uint32_t     i_ctts_left;
+
     uint8_t      **p_sample_data;     /* set when b_fragmented is true */
     uint32_t     *p_sample_size;
     /* TODO if needed add pts
@@ -107,12 +114,15 @@ typedef struct
 
     mp4_chunk_t    *chunk; /* always defined  for each chunk */
     mp4_chunk_t    *cchunk; /* current chunk if b_fragmented is true */
+    /* chunks with their dts/pts tables built, last ones used */
+#define MP4_CHUNK_CACHE 4
+    uint32_t       chunk_cache[MP4_CHUNK_CACHE];
+    unsigned       i_chunk_cache; /* number of chunk tables built so far */
 
     /* sample size, p_sample_size defined only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-                                    too much time to do sumations each time*/
+    const uint32_t   *p_sample_size; /* stsz table, not a copy */
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
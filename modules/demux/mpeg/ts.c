@@ -42,6 +42,7 @@
 #include <vlc_epg.h>
 #include <vlc_charset.h>   /* FromCharset, for EIT */
 #include <vlc_bits.h>
+#include <vlc_atomic.h>
 
 #include "../../mux/mpeg/csa.h"
 
@@ -72,6 +73,7 @@
 
 #include "pes.h"
 #include "mpeg4_iod.h"
+#include "ts_index.h"
 
 #ifdef HAVE_ARIBB24
  #include <aribb24/aribb24.h>
@@ -134,9 +136,23 @@ static void Close ( vlc_object_t * );
     "Seek and position based on a percent byte position, not a PCR generated " \
     "time position. If seeking doesn't work property, turn on this option." )
 
+#define SEEK_INDEX_TEXT N_("Store seek index")
+#define SEEK_INDEX_LONGTEXT N_( \
+    "Save the time to position index built during playback in a file " \
+    "next to the recording, so that seeking and duration detection are " \
+    "immediate when it is opened again." )
+
+#define THREADS_TEXT N_("Program threads")
+#define THREADS_LONGTEXT N_( \
+    "Number of threads gathering and sending the elementary streams, " \
+    "each one handling a share of the programs, when all programs of a " \
+    "live stream are output. 0 demuxes everything on the input thread." )
+
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
+#define TS_WORKERS_MAX 64
+
 static const int const arib_mode_list[] =
   { ARIBMODE_AUTO, ARIBMODE_ENABLED, ARIBMODE_DISABLED };
 static const char *const arib_mode_list_text[] =
@@ -169,6 +185,9 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-seek-index", false, SEEK_INDEX_TEXT, SEEK_INDEX_LONGTEXT, true )
+    add_integer( "ts-program-threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true )
+        change_integer_range( 0, TS_WORKERS_MAX )
 
     add_integer( "ts-arib", ARIBMODE_AUTO, SUPPORT_ARIB_TEXT, SUPPORT_ARIB_LONGTEXT, false )
         change_integer_list( arib_mode_list, arib_mode_list_text )
@@ -224,10 +243,13 @@ typedef struct
         mtime_t i_pcroffset;
         bool    b_disable; /* ignore PCR field, use dts */
         bool    b_fix_done;
+        bool    b_fix_request; /* PCR pid switch left to the input thread */
     } pcr;
 
     mtime_t i_last_dts;
 
+    int     i_worker; /* thread demuxing the program, or -1 */
+
 } ts_pmt_t;
 
 typedef struct
@@ -254,8 +276,8 @@ typedef struct
     ts_es_data_type_t data_type;
     int         i_data_size;
     int         i_data_gathered;
-    block_t     *p_data;
-    block_t     **pp_last;
+    block_t     *p_data; /* gathered payload, in a single buffer */
+    size_t      i_data_alloc;
 
     block_t *   p_prepcr_outqueue;
 
@@ -345,6 +367,26 @@ typedef struct
 
 #define PID_ALLOC_CHUNK 16
 
+/* Thread gathering and sending the PES of a share of the programs */
+typedef struct
+{
+    demux_t     *p_demux;
+    int          i_index;
+    vlc_thread_t thread;
+
+    vlc_mutex_t  lock;
+    vlc_cond_t   wait;    /* packets queued, or exit */
+    vlc_cond_t   drained; /* queue taken or processed */
+    block_t     *p_first; /* queued packets */
+    block_t    **pp_last;
+    unsigned     i_depth;
+    bool         b_busy;
+    bool         b_exit;
+} ts_worker_t;
+
+/* Maximum packets queued to a worker before the input thread waits */
+#define TS_WORKER_QUEUE 4096
+
 struct demux_sys_t
 {
     stream_t   *stream;
@@ -361,8 +403,34 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Recycled TS packets blocks */
+    block_pool_t *p_packet_pool;
+
+    /* Program threads, used when all programs are output */
+    struct
+    {
+        ts_worker_t *p_elems;
+        int          i_count;
+        int          i_next;           /* for the next new program */
+        atomic_bool  b_update_filters; /* requested by a worker */
+    } workers;
+
+    /* Packets read at once from the stream, walked in place */
+    struct
+    {
+        uint8_t *p_buffer;
+        size_t   i_size;
+        size_t   i_data;
+        size_t   i_offset;
+        size_t   i_descrambled; /* end of the descrambled packets */
+    } batch;
+
     bool        b_force_seek_per_percent;
 
+    /* PCR to offset index, and its sidecar file */
+    ts_index_t *p_index;
+    char       *psz_index;
+
     struct
     {
         arib_modes_e e_mode;
@@ -370,6 +438,7 @@ struct demux_sys_t
         arib_instance_t *p_instance;
 #endif
         stream_t     *b25stream;
+        bool          b_pending; /* descrambler may be inserted, don't read ahead */
     } arib;
 
     /* All pid */
@@ -381,9 +450,8 @@ struct demux_sys_t
         ts_pid_t **pp_all;
         int        i_all;
         int        i_all_alloc;
-        /* last recently used */
-        uint16_t   i_last_pid;
-        ts_pid_t  *p_last;
+        /* direct lookup by pid, including the commons ones */
+        ts_pid_t  *p_table[0x2000];
     } pids;
 
     bool        b_user_pmt;
@@ -468,22 +536,64 @@ static bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 static void UpdatePESFilters( demux_t *p_demux, bool b_all );
 static inline void FlushESBuffer( ts_pes_t *p_pes );
 static void UpdateScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool );
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
+{
+    return ( (p[1]&0x1f)<<8 )|p[2];
+}
+
+/* Stream position of the next packet, not counting the unread batch */
+static inline int64_t TSTell( demux_sys_t *p_sys )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return stream_Tell( p_sys->stream ) -
+           (int64_t)(p_sys->batch.i_data - p_sys->batch.i_offset);
+}
+
+static inline void TSFlush( demux_sys_t *p_sys )
+{
+    p_sys->batch.i_data = p_sys->batch.i_offset = 0;
+    p_sys->batch.i_descrambled = 0;
+}
+
+static inline int TSSeek( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    TSFlush( p_sys );
+    return stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Whether the PES are handed to the program threads */
+static inline bool ProgramsInParallel( const demux_sys_t *p_sys )
+{
+    return p_sys->workers.i_count > 0 && p_sys->b_es_all &&
+           p_sys->es_creation == CREATE_ES;
+}
+
+/* Thread demuxing the pid, or -1 for the input thread */
+static inline int PIDWorker( const ts_pid_t *pid )
+{
+    if( pid->type != TYPE_PES || !pid->p_parent ||
+        pid->p_parent->type != TYPE_PMT )
+        return -1;
+    return pid->p_parent->u.p_pmt->i_worker;
 }
 
 static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+static int  WorkersStart( demux_t *p_demux, int i_count );
+static void WorkersStop( demux_t *p_demux );
+static void WorkersSync( demux_t *p_demux );
+static void DispatchPacket( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt );
+static void RequestPESFiltersUpdate( demux_t *p_demux );
 static void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
-static block_t* ReadTSPacket( demux_t *p_demux );
+static const uint8_t * ReadTSPacket( demux_t *p_demux );
+static block_t* NewPacketBlock( demux_t *p_demux, const uint8_t *p_pkt );
 static int ProbeStart( demux_t *p_demux, int i_program );
 static int ProbeEnd( demux_t *p_demux, int i_program );
 static int SeekToTime( demux_t *p_demux, ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
+static void PCRFixRequests( demux_t * );
 static int64_t TimeStampWrapAround( ts_pmt_t *, int64_t );
 
 /* MPEG4 related */
@@ -503,6 +613,13 @@ static int  SetPIDFilter( demux_sys_t *, ts_pid_t *, bool b_selected );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Minimum time between two seek index points */
+#define TS_INDEX_INTERVAL TO_SCALE_NZ(CLOCK_FREQ * 2 / 5)
+
+/* Number of packets in a read batch */
+#define TS_BATCH_PACKETS      (7 * 64)
+#define TS_BATCH_PACKETS_LIVE 7
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -997,8 +1114,12 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->b_broken_charset = false;
 
+    atomic_init( &p_sys->workers.b_update_filters, false );
+
     p_sys->pids.dummy.i_pid = 8191;
     p_sys->pids.dummy.i_flags = FLAG_SEEN;
+    p_sys->pids.p_table[0] = &p_sys->pids.pat;
+    p_sys->pids.p_table[0x1FFF] = &p_sys->pids.dummy;
 
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
@@ -1057,6 +1178,8 @@ static int Open( vlc_object_t *p_this )
 
 # undef VLC_DVBPSI_DEMUX_TABLE_INIT
 
+    p_sys->p_packet_pool = block_PoolNew( p_sys->i_packet_size );
+
     p_sys->i_pmt_es = 0;
     p_sys->b_es_all = false;
 
@@ -1131,6 +1254,42 @@ static int Open( vlc_object_t *p_this )
     stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK, &p_sys->b_canfastseek );
 
+    /* Live streams get datagram sized batches, so that we don't add latency */
+    p_sys->batch.i_size = p_sys->i_packet_size *
+        ( p_sys->b_canseek ? TS_BATCH_PACKETS : TS_BATCH_PACKETS_LIVE );
+    /* We could not seek back to hand the batch to the ARIB descrambler */
+    p_sys->arib.b_pending = !p_sys->b_canseek &&
+                            p_sys->arib.e_mode != ARIBMODE_DISABLED;
+    p_sys->batch.p_buffer = malloc( p_sys->batch.i_size );
+    if( !p_sys->batch.p_buffer )
+    {
+        Close( VLC_OBJECT(p_demux) );
+        return VLC_ENOMEM;
+    }
+
+    if( p_sys->b_canseek )
+    {
+        const uint64_t i_size = stream_Size( p_sys->stream );
+
+        if( p_demux->psz_file && var_InheritBool( p_demux, "ts-seek-index" ) &&
+            asprintf( &p_sys->psz_index, "%s.tsidx", p_demux->psz_file ) == -1 )
+            p_sys->psz_index = NULL;
+
+        if( p_sys->psz_index &&
+           (p_sys->p_index = ts_index_Load( p_sys->psz_index, TS_INDEX_INTERVAL, i_size )) )
+            msg_Dbg( p_demux, "using seek index %s", p_sys->psz_index );
+        else
+            p_sys->p_index = ts_index_New( TS_INDEX_INTERVAL, i_size );
+    }
+
+    /* Live streams can have their programs demuxed in parallel */
+    if( !p_sys->b_canseek )
+    {
+        int i_threads = var_InheritInteger( p_demux, "ts-program-threads" );
+        if( i_threads > 0 && WorkersStart( p_demux, i_threads ) != VLC_SUCCESS )
+            msg_Warn( p_demux, "cannot start program threads" );
+    }
+
     /* Preparse time */
     if( p_sys->b_canseek )
     {
@@ -1154,6 +1313,8 @@ static void Close( vlc_object_t *p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    WorkersStop( p_demux );
+
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
     if( p_sys->b_dvb_meta )
@@ -1187,6 +1348,19 @@ static void Close( vlc_object_t *p_this )
 
     vlc_mutex_destroy( &p_sys->csa_lock );
 
+    if( p_sys->p_packet_pool )
+        block_PoolRelease( p_sys->p_packet_pool );
+    free( p_sys->batch.p_buffer );
+
+    if( p_sys->p_index )
+    {
+        if( p_sys->psz_index &&
+            ts_index_Save( p_sys->p_index, p_sys->psz_index ) != VLC_SUCCESS )
+            msg_Warn( p_demux, "cannot write seek index %s", p_sys->psz_index );
+        ts_index_Delete( p_sys->p_index );
+    }
+    free( p_sys->psz_index );
+
     /* Release all non default pids */
     for( int i = 0; i < p_sys->pids.i_all; i++ )
     {
@@ -1236,11 +1410,19 @@ static int Demux( demux_t *p_demux )
     if( p_sys->i_pmt_es == 0 && !SEEN(GetPID(p_sys, 0)) && p_sys->patfix.b_pat_deadline )
         MissingPATPMTFixup( p_demux );
 
+    /* A program thread needs a PCR pid switch, or changed its es */
+    if( atomic_exchange( &p_sys->workers.b_update_filters, false ) )
+    {
+        WorkersSync( p_demux );
+        PCRFixRequests( p_demux );
+        UpdatePESFilters( p_demux, p_sys->b_es_all );
+    }
+
     /* We read at most 100 TS packet or until a frame is completed */
     for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
+        const uint8_t *p_pkt;
         if( !(p_pkt = ReadTSPacket( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
@@ -1256,8 +1438,8 @@ static int Demux( demux_t *p_demux )
         /* Parse the TS packet */
         ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
 
-        if( SCRAMBLED(*p_pid) != !!(p_pkt->p_buffer[3] & 0x80) )
-            UpdateScrambledState( p_demux, p_pid, p_pkt->p_buffer[3] & 0x80 );
+        if( SCRAMBLED(*p_pid) != !!(p_pkt[3] & 0x80) )
+            UpdateScrambledState( p_demux, p_pid, p_pkt[3] & 0x80 );
 
         if( !SEEN(p_pid) )
         {
@@ -1267,34 +1449,36 @@ static int Demux( demux_t *p_demux )
         }
 
         if ( SCRAMBLED(*p_pid) && !p_demux->p_sys->csa )
-        {
-            block_Release( p_pkt );
             continue;
-        }
 
         /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
         if( !SEEN( GetPID( p_sys, 0 ) ) &&
             (p_pid->probed.i_type == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
-            (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-            (p_pkt->p_buffer[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
+            (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+            (p_pkt[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
         {
-            ProbePES( p_demux, p_pid, p_pkt->p_buffer + TS_HEADER_SIZE,
-                      p_pkt->i_buffer - TS_HEADER_SIZE, p_pkt->p_buffer[3] & 0x20 /* Adaptation field */);
+            ProbePES( p_demux, p_pid, p_pkt + TS_HEADER_SIZE,
+                      p_sys->i_packet_size - p_sys->i_packet_header_size - TS_HEADER_SIZE,
+                      p_pkt[3] & 0x20 /* Adaptation field */);
         }
 
         switch( p_pid->type )
         {
         case TYPE_PAT:
-            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pat->handle, (uint8_t *) p_pkt );
             break;
 
         case TYPE_PMT:
-            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+        {
+            /* The PMT callback can probe the stream and reuse the batch */
+            uint8_t pmtpkt[TS_PACKET_SIZE_188];
+            memcpy( pmtpkt, p_pkt, TS_PACKET_SIZE_188 );
+            dvbpsi_packet_push( p_pid->u.p_pmt->handle, pmtpkt );
             break;
+        }
 
         case TYPE_PES:
+        {
             p_sys->b_end_preparse = true;
 
             if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
@@ -1306,25 +1490,38 @@ static int Demux( demux_t *p_demux )
             if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
             {
                 /* That packet is for an unselected ES, don't waste time/memory gathering its data */
-                block_Release( p_pkt );
                 continue;
             }
 
-            b_frame = GatherData( p_demux, p_pid, p_pkt );
+            if( ProgramsInParallel( p_sys ) )
+            {
+                DispatchPacket( p_demux, p_pid, p_pkt );
+                if( PIDWorker( p_pid ) >= 0 )
+                    break;
+            }
+            else
+                PCRHandle( p_demux, p_pid, p_pkt );
+
+            /* Only forwarded packets get their own block */
+            block_t *p_bk = NewPacketBlock( p_demux, p_pkt );
+            if( p_bk )
+                b_frame = GatherData( p_demux, p_pid, p_bk );
             break;
+        }
 
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
             if( p_sys->b_dvb_meta )
-                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+                dvbpsi_packet_push( p_pid->u.p_psi->handle, (uint8_t *) p_pkt );
             break;
 
         default:
             /* We have to handle PCR if present */
-            PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
+            if( ProgramsInParallel( p_sys ) )
+                DispatchPacket( p_demux, p_pid, p_pkt );
+            else
+                PCRHandle( p_demux, p_pid, p_pkt );
             break;
         }
 
@@ -1433,6 +1630,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     ts_pmt_t *p_pmt;
     int i_first_program = ( p_sys->programs.i_size ) ? p_sys->programs.p_elems[0] : 0;
 
+    /* The program threads own the PES and PCR state */
+    WorkersSync( p_demux );
+
     if( PREPARSING || !i_first_program || p_sys->b_default_selection )
     {
         if( likely(GetPID(p_sys, 0)->type == TYPE_PAT) )
@@ -1483,7 +1683,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            int64_t offset = stream_Tell( p_sys->stream );
+            int64_t offset = TSTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -1528,7 +1728,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         i64 = stream_Size( p_sys->stream );
         if( i64 > 0 &&
-            stream_Seek( p_sys->stream, (int64_t)(i64 * f) ) == VLC_SUCCESS )
+            TSSeek( p_sys, (int64_t)(i64 * f) ) == VLC_SUCCESS )
         {
             ReadyQueuesPostSeek( p_demux );
             return VLC_SUCCESS;
@@ -1652,9 +1852,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
+        TSFlush( p_sys );
         return stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
 
     case DEMUX_SET_SEEKPOINT:
+        TSFlush( p_sys );
         return stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args );
 
     case DEMUX_GET_META:
@@ -2445,7 +2647,7 @@ static void ParseTableSection( demux_t *p_demux, ts_pid_t *pid, block_t *p_data
             }
 
             if( b_changed )
-                UpdatePESFilters( p_demux, p_demux->p_sys->b_es_all );
+                RequestPESFiltersUpdate( p_demux );
 
             p_ods->i_version = i_version;
         }
@@ -2470,7 +2672,6 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
     pid->u.p_pes->p_data = NULL;
     pid->u.p_pes->i_data_size = 0;
     pid->u.p_pes->i_data_gathered = 0;
-    pid->u.p_pes->pp_last = &pid->u.p_pes->p_data;
 
     if( pid->u.p_pes->data_type == TS_ES_DATA_PES )
     {
@@ -2486,25 +2687,86 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
     }
 }
 
-static block_t* ReadTSPacket( demux_t *p_demux )
+/* Makes sure at least i_min unread bytes are in the batch */
+static bool FillPacketBatch( demux_sys_t *p_sys, size_t i_min )
+{
+    size_t i_left = p_sys->batch.i_data - p_sys->batch.i_offset;
+    if( i_left >= i_min )
+        return true;
+
+    memmove( p_sys->batch.p_buffer,
+             &p_sys->batch.p_buffer[p_sys->batch.i_offset], i_left );
+    if( p_sys->batch.i_descrambled > p_sys->batch.i_offset )
+        p_sys->batch.i_descrambled -= p_sys->batch.i_offset;
+    else
+        p_sys->batch.i_descrambled = 0;
+    p_sys->batch.i_offset = 0;
+    p_sys->batch.i_data = i_left;
+
+    /* Only read what is needed until the ARIB descrambler is set up */
+    size_t i_toread = p_sys->arib.b_pending ? i_min - i_left
+                                            : p_sys->batch.i_size - i_left;
+    int i_read = stream_Read( p_sys->stream, &p_sys->batch.p_buffer[i_left],
+                              i_toread );
+    if( i_read > 0 )
+        p_sys->batch.i_data += i_read;
+
+    return p_sys->batch.i_data >= i_min;
+}
+
+/* Descrambles the run of synchronized packets starting at the read offset,
+ * all at once */
+static void DescramblePacketBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const unsigned i_size = p_sys->i_packet_size;
+    const unsigned i_header = p_sys->i_packet_header_size;
+    uint8_t *pp_pkts[TS_BATCH_PACKETS];
+    int i_pkts = 0;
+
+    size_t i_pos = p_sys->batch.i_offset;
+    while( i_pkts < TS_BATCH_PACKETS && i_pos + i_size <= p_sys->batch.i_data &&
+           p_sys->batch.p_buffer[i_pos + i_header] == 0x47 )
+    {
+        pp_pkts[i_pkts++] = &p_sys->batch.p_buffer[i_pos + i_header];
+        i_pos += i_size;
+    }
+    p_sys->batch.i_descrambled = i_pos;
+
+    vlc_mutex_lock( &p_sys->csa_lock );
+    if( p_sys->csa )
+        csa_DecryptPackets( p_sys->csa, pp_pkts, i_pkts, p_sys->i_csa_pkt_size );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+}
+
+static block_t* NewPacketBlock( demux_t *p_demux, const uint8_t *p_pkt )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size - p_sys->i_packet_header_size;
+
+    block_t *p_bk = p_sys->p_packet_pool
+                  ? block_PoolAlloc( p_sys->p_packet_pool, i_size )
+                  : block_Alloc( i_size );
+    if( likely(p_bk) )
+        memcpy( p_bk->p_buffer, p_pkt, i_size );
+    return p_bk;
+}
 
-    block_t     *p_pkt;
+/* Returns the next packet, after the BluRay header, in the read batch.
+ * It stays valid until the next read or seek. */
+static const uint8_t * ReadTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const unsigned i_size = p_sys->i_packet_size;
+    const unsigned i_header = p_sys->i_packet_header_size;
 
     /* Get a new TS packet */
-    if( !( p_pkt = stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    if( !FillPacketBatch( p_sys, i_size ) )
     {
         if( stream_Tell( p_sys->stream ) == stream_Size( p_sys->stream ) )
-            msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
+            msg_Dbg( p_demux, "EOF at %"PRId64, TSTell( p_sys ) );
         else
-            msg_Dbg( p_demux, "Can't read TS packet at %"PRId64, stream_Tell(p_sys->stream) );
-        return NULL;
-    }
-
-    if( p_pkt->i_buffer < TS_HEADER_SIZE + p_sys->i_packet_header_size )
-    {
-        block_Release( p_pkt );
+            msg_Dbg( p_demux, "Can't read TS packet at %"PRId64, TSTell( p_sys ) );
         return NULL;
     }
 
@@ -2512,52 +2774,54 @@ static block_t* ReadTSPacket( demux_t *p_demux )
      * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
      * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
      */
-    p_pkt->p_buffer += p_sys->i_packet_header_size;
-    p_pkt->i_buffer -= p_sys->i_packet_header_size;
+    const uint8_t *p_pkt = &p_sys->batch.p_buffer[p_sys->batch.i_offset];
 
     /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
+    if( p_pkt[i_header] != 0x47 )
     {
         msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
         for( ;; )
         {
-            const uint8_t *p_peek;
-            int i_peek = 0;
-            unsigned i_skip = 0;
-
-            i_peek = stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
+            if( !FillPacketBatch( p_sys, i_header + i_size + 1 ) )
             {
                 msg_Dbg( p_demux, "eof ?" );
                 return NULL;
             }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
+            const uint8_t *p_peek = &p_sys->batch.p_buffer[p_sys->batch.i_offset];
+            const size_t i_peek = p_sys->batch.i_data - p_sys->batch.i_offset;
+            size_t i_skip = 0;
+
+            while( i_skip + i_header + i_size < i_peek )
             {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
+                if( p_peek[i_skip + i_header] == 0x47 &&
+                        p_peek[i_skip + i_header + i_size] == 0x47 )
                 {
                     break;
                 }
                 i_skip++;
             }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            stream_Read( p_sys->stream, NULL, i_skip );
+            msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+            p_sys->batch.i_offset += i_skip;
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
+            if( i_skip + i_header + i_size < i_peek )
             {
                 break;
             }
         }
-        if( !( p_pkt = stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+        if( !FillPacketBatch( p_sys, i_size ) )
         {
             msg_Dbg( p_demux, "eof ?" );
             return NULL;
         }
+        p_pkt = &p_sys->batch.p_buffer[p_sys->batch.i_offset];
     }
-    return p_pkt;
+
+    if( p_sys->csa && p_sys->batch.i_offset >= p_sys->batch.i_descrambled )
+        DescramblePacketBatch( p_demux );
+
+    p_sys->batch.i_offset += i_size;
+    return &p_pkt[i_header];
 }
 
 static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
@@ -2569,10 +2833,8 @@ static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
     return i_time + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -2597,6 +2859,8 @@ static void UpdateScrambledState( demux_t *p_demux, ts_pid_t *p_pid, bool b_scra
     msg_Warn( p_demux, "scrambled state changed on pid %d (%d->%d)",
               p_pid->i_pid, SCRAMBLED(*p_pid), b_scrambled );
 
+    WorkersSync( p_demux );
+
     if( b_scrambled )
         p_pid->i_flags |= FLAG_SCRAMBLED;
     else
@@ -2620,9 +2884,8 @@ static inline void FlushESBuffer( ts_pes_t *p_pes )
     if( p_pes->p_data )
     {
         p_pes->i_data_gathered = p_pes->i_data_size = 0;
-        block_ChainRelease( p_pes->p_data );
+        block_Release( p_pes->p_data );
         p_pes->p_data = NULL;
-        p_pes->pp_last = &p_pes->p_data;
     }
 
     if( p_pes->sl.p_data )
@@ -2679,19 +2942,36 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
 
     /* Deal with common but worst binary search case */
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return stream_Seek( p_sys->stream, 0 );
+        return TSSeek( p_sys, 0 );
+
+    /* Points already seen in the index either hit the target,
+     * or narrow the search */
+    ts_index_entry_t before, after;
+    before.i_time = after.i_time = -1;
+    if( p_sys->p_index )
+    {
+        ts_index_Find( p_sys->p_index, p_pmt->i_number, i_scaledtime, &before, &after );
+        if( before.i_time != -1 &&
+            i_scaledtime - before.i_time < TO_SCALE(VLC_TS_0 + CLOCK_FREQ / 2) ) // 500ms
+            return TSSeek( p_sys, before.i_pos );
+    }
 
     if( !p_sys->b_canfastseek )
         return VLC_EGENERIC;
 
-    int64_t i_initial_pos = stream_Tell( p_sys->stream );
+    int64_t i_initial_pos = TSTell( p_sys );
 
     /* Find the time position by using binary search algorithm. */
     int64_t i_head_pos = 0;
     int64_t i_tail_pos = stream_Size( p_sys->stream ) - p_sys->i_packet_size;
+    if( before.i_time != -1 )
+        i_head_pos = before.i_pos;
+    if( after.i_time != -1 && (int64_t)after.i_pos < i_tail_pos )
+        i_tail_pos = after.i_pos;
     if( i_head_pos >= i_tail_pos )
         return VLC_EGENERIC;
 
+    const unsigned i_pkt_size = p_sys->i_packet_size - p_sys->i_packet_header_size;
     bool b_found = false;
     while( (i_head_pos + p_sys->i_packet_size) <= i_tail_pos && !b_found )
     {
@@ -2700,36 +2980,40 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
         int64_t i_div = i_splitpos % p_sys->i_packet_size;
         i_splitpos -= i_div;
 
-        if ( stream_Seek( p_sys->stream, i_splitpos ) != VLC_SUCCESS )
+        if ( TSSeek( p_sys, i_splitpos ) != VLC_SUCCESS )
             break;
 
         int64_t i_pos = i_splitpos;
         while( i_pos > -1 && i_pos < i_tail_pos )
         {
             int64_t i_pcr = -1;
-            block_t *p_pkt = ReadTSPacket( p_demux );
+            const uint8_t *p_pkt = ReadTSPacket( p_demux );
             if( !p_pkt )
             {
                 i_head_pos = i_tail_pos;
                 break;
             }
             else
-                i_pos = stream_Tell( p_sys->stream );
+                i_pos = TSTell( p_sys );
 
             int i_pid = PIDGet( p_pkt );
             if( i_pid != 0x1FFF && GetPID(p_sys, i_pid)->type == TYPE_PES &&
                 GetPID(p_sys, i_pid)->p_parent->u.p_pmt == p_pmt &&
-               (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-               (p_pkt->p_buffer[3] & 0xD0) == 0x10    /* Has payload but is not encrypted */
+               (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+               (p_pkt[3] & 0xD0) == 0x10    /* Has payload but is not encrypted */
             )
             {
                 unsigned i_skip = 4;
-                if ( p_pkt->p_buffer[3] & 0x20 ) // adaptation field
+                if ( p_pkt[3] & 0x20 ) // adaptation field
                 {
-                    if( p_pkt->i_buffer >= 4 + 2 + 5 )
+                    if( i_pkt_size >= 4 + 2 + 5 )
                     {
                         i_pcr = GetPCR( p_pkt );
-                        i_skip += 1 + p_pkt->p_buffer[4];
+                        i_skip += 1 + p_pkt[4];
+                        if( i_pcr != -1 && p_sys->p_index )
+                            ts_index_Add( p_sys->p_index, p_pmt->i_number,
+                                          TimeStampWrapAround( p_pmt, i_pcr ),
+                                          i_pos - p_sys->i_packet_size );
                     }
                 }
                 else
@@ -2737,8 +3021,8 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
                     mtime_t i_dts = -1;
                     mtime_t i_pts = -1;
                     uint8_t i_stream_id;
-                    if ( VLC_SUCCESS == ParsePESHeader( VLC_OBJECT(p_demux), &p_pkt->p_buffer[i_skip],
-                                                        p_pkt->i_buffer - i_skip, &i_skip,
+                    if ( VLC_SUCCESS == ParsePESHeader( VLC_OBJECT(p_demux), &p_pkt[i_skip],
+                                                        i_pkt_size - i_skip, &i_skip,
                                                         &i_dts, &i_pts, &i_stream_id ) )
                     {
                         if( i_dts > -1 )
@@ -2746,8 +3030,6 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
                     }
                 }
             }
-            block_Release( p_pkt );
-
             if( i_pcr != -1 )
             {
                 int64_t i_diff = i_scaledtime - TimeStampWrapAround( p_pmt, i_pcr );
@@ -2768,7 +3050,7 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
-        stream_Seek( p_sys->stream, i_initial_pos );
+        TSSeek( p_sys, i_initial_pos );
         return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
@@ -2776,27 +3058,11 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
 
 static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
 {
-    switch( i_pid )
-    {
-        case 0:
-            return &p_sys->pids.pat;
-        case 0x1FFF:
-            return &p_sys->pids.dummy;
-        default:
-            if( p_sys->pids.i_last_pid == i_pid )
-                return p_sys->pids.p_last;
-        break;
-    }
+    if( unlikely(i_pid > 0x1FFF) )
+        return &p_sys->pids.dummy;
 
-    for( int i=0; i < p_sys->pids.i_all; i++ )
-    {
-        if( p_sys->pids.pp_all[i]->i_pid == i_pid )
-        {
-            p_sys->pids.p_last = p_sys->pids.pp_all[i];
-            p_sys->pids.i_last_pid = i_pid;
-            return p_sys->pids.p_last;
-        }
-    }
+    if( likely(p_sys->pids.p_table[i_pid]) )
+        return p_sys->pids.p_table[i_pid];
 
     if( p_sys->pids.i_all >= p_sys->pids.i_all_alloc )
     {
@@ -2817,9 +3083,7 @@ static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
 
     p_pid->i_pid = i_pid;
     p_sys->pids.pp_all[p_sys->pids.i_all++] = p_pid;
-
-    p_sys->pids.p_last = p_pid;
-    p_sys->pids.i_last_pid = i_pid;
+    p_sys->pids.p_table[i_pid] = p_pid;
 
     return p_pid;
 }
@@ -2846,7 +3110,8 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     int i_count = 0;
-    block_t *p_pkt = NULL;
+    const unsigned i_pkt_size = p_sys->i_packet_size - p_sys->i_packet_header_size;
+    const uint8_t *p_pkt = NULL;
 
     for( ;; )
     {
@@ -2862,17 +3127,17 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 
         p_pid->i_flags |= FLAG_SEEN;
 
-        if( i_pid != 0x1FFF && (p_pkt->p_buffer[1] & 0x80) == 0 ) /* not corrupt */
+        if( i_pid != 0x1FFF && (p_pkt[1] & 0x80) == 0 ) /* not corrupt */
         {
             bool b_pcrresult = true;
-            bool b_adaptfield = p_pkt->p_buffer[3] & 0x20;
+            bool b_adaptfield = p_pkt[3] & 0x20;
 
-            if( b_adaptfield && p_pkt->i_buffer >= 4 + 2 + 5 )
+            if( b_adaptfield && i_pkt_size >= 4 + 2 + 5 )
                 *pi_pcr = GetPCR( p_pkt );
 
             if( *pi_pcr == -1 &&
-                (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* payload start */
-                (p_pkt->p_buffer[3] & 0xD0) == 0x10 && /* Has payload but is not encrypted */
+                (p_pkt[1] & 0xC0) == 0x40 && /* payload start */
+                (p_pkt[3] & 0xD0) == 0x10 && /* Has payload but is not encrypted */
                 p_pid->type == TYPE_PES &&
                 p_pid->u.p_pes->es.fmt.i_cat != UNKNOWN_ES
               )
@@ -2883,10 +3148,10 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
                 uint8_t i_stream_id;
                 unsigned i_skip = 4;
                 if ( b_adaptfield ) // adaptation field
-                    i_skip += 1 + p_pkt->p_buffer[4];
+                    i_skip += 1 + p_pkt[4];
 
-                if ( VLC_SUCCESS == ParsePESHeader( VLC_OBJECT(p_demux), &p_pkt->p_buffer[i_skip],
-                                                    p_pkt->i_buffer - i_skip, &i_skip,
+                if ( VLC_SUCCESS == ParsePESHeader( VLC_OBJECT(p_demux), &p_pkt[i_skip],
+                                                    i_pkt_size - i_skip, &i_skip,
                                                     &i_dts, &i_pts, &i_stream_id ) )
                 {
                     if( i_dts != -1 )
@@ -2905,6 +3170,11 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
                     if( ( p_pmt->i_pid_pcr == p_pid->i_pid ||
                         ( p_pmt->i_pid_pcr == 0x1FFF && p_pid->p_parent == p_pat->programs.p_elems[i] ) ) )
                     {
+                        if( b_pcrresult && p_sys->p_index )
+                            ts_index_Add( p_sys->p_index, p_pmt->i_number,
+                                          TimeStampWrapAround( p_pmt, *pi_pcr ),
+                                          TSTell( p_sys ) - p_sys->i_packet_size );
+
                         if( b_end )
                         {
                             p_pmt->i_last_dts = *pi_pcr;
@@ -2925,8 +3195,6 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
                 }
             }
         }
-
-        block_Release( p_pkt );
     }
 
     return i_count;
@@ -2935,7 +3203,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 static int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const int64_t i_initial_pos = stream_Tell( p_sys->stream );
+    const int64_t i_initial_pos = TSTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = 0;
@@ -2948,7 +3216,7 @@ static int ProbeStart( demux_t *p_demux, int i_program )
         i_pos = p_sys->i_packet_size * i_probe_count;
         i_pos = __MIN( i_pos, i_stream_size );
 
-        if( stream_Seek( p_sys->stream, i_pos ) )
+        if( TSSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, false, &i_pcr, &b_found );
@@ -2957,7 +3225,7 @@ static int ProbeStart( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (2 * PROBE_CHUNK_COUNT) );
 
-    stream_Seek( p_sys->stream, i_initial_pos );
+    TSSeek( p_sys, i_initial_pos );
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
 }
@@ -2965,7 +3233,7 @@ static int ProbeStart( demux_t *p_demux, int i_program )
 static int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const int64_t i_initial_pos = stream_Tell( p_sys->stream );
+    const int64_t i_initial_pos = TSTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = PROBE_CHUNK_COUNT;
@@ -2978,7 +3246,7 @@ static int ProbeEnd( demux_t *p_demux, int i_program )
         i_pos = i_stream_size - (p_sys->i_packet_size * i_probe_count);
         i_pos = __MAX( i_pos, 0 );
 
-        if( stream_Seek( p_sys->stream, i_pos ) )
+        if( TSSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, true, &i_pcr, &b_found );
@@ -2987,7 +3255,7 @@ static int ProbeEnd( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (6 * PROBE_CHUNK_COUNT) );
 
-    stream_Seek( p_sys->stream, i_initial_pos );
+    TSSeek( p_sys, i_initial_pos );
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
 }
@@ -3001,11 +3269,15 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
     if( p_pmt->pcr.i_current == -1 && p_pmt->pcr.b_fix_done )
     {
         mtime_t i_mindts = -1;
+        const int i_worker = p_pmt->i_worker;
 
         ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
         for( int i=0; i< p_pat->programs.i_size; i++ )
         {
             ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+            /* Other threads' queues can't be looked at */
+            if( ProgramsInParallel( p_sys ) && p_pmt->i_worker != i_worker )
+                continue;
             for( int j=0; j<p_pmt->e_streams.i_size; j++ )
             {
                 ts_pid_t *p_pid = p_pmt->e_streams.p_elems[j];
@@ -3039,11 +3311,31 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
     }
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/* Records the PCR of the packet just read */
+static void IndexPCR( demux_sys_t *p_sys, ts_pmt_t *p_pmt, mtime_t i_pcr )
+{
+    if( p_sys->p_index )
+        ts_index_Add( p_sys->p_index, p_pmt->i_number, i_pcr,
+                      TSTell( p_sys ) - p_sys->i_packet_size );
+}
+
+/* Whether the program takes its clock from the pid */
+static bool ProgramTakesPCR( const ts_pid_t *pmtpid, const ts_pid_t *pid )
+{
+    const ts_pmt_t *p_pmt = pmtpid->u.p_pmt;
+
+    if( p_pmt->i_pid_pcr == 0x1FFF ) /* That program has no dedicated PCR pid ISO/IEC 13818-1 2.4.4.9 */
+        return pid->p_parent == pmtpid; /* PCR shall be on pid itself */
+
+    /* Can be dedicated PCR pid (no owned then) or another pid (owner == pmt) */
+    return p_pmt->i_pid_pcr == pid->i_pid;
+}
+
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p_pkt );
     if( i_pcr < 0 )
         return;
 
@@ -3060,26 +3352,13 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     for( int i = 0; i < p_pat->programs.i_size; i++ )
     {
         ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
-        mtime_t i_program_pcr = TimeStampWrapAround( p_pmt, i_pcr );
 
-        if( p_pmt->i_pid_pcr == 0x1FFF ) /* That program has no dedicated PCR pid ISO/IEC 13818-1 2.4.4.9 */
+        if( ProgramTakesPCR( p_pat->programs.p_elems[i], pid ) )
         {
-            if( pid->p_parent == p_pat->programs.p_elems[i] ) /* PCR shall be on pid itself */
-            {
-                /* ? update PCR for the whole group program ? */
-                ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
-            }
-        }
-        else /* set PCR provided by current pid to program(s) referencing it */
-        {
-            /* Can be dedicated PCR pid (no owned then) or another pid (owner == pmt) */
-            if( p_pmt->i_pid_pcr == pid->i_pid ) /* If that program references current pid as PCR */
-            {
-                /* We've found a target group for update */
-                ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
-            }
+            mtime_t i_program_pcr = TimeStampWrapAround( p_pmt, i_pcr );
+            ProgramSetPCR( p_demux, p_pmt, i_program_pcr );
+            IndexPCR( p_sys, p_pmt, i_program_pcr );
         }
-
     }
 }
 
@@ -3122,6 +3401,41 @@ static int FindPCRCandidate( ts_pmt_t *p_pmt )
         return 0x1FFF;
 }
 
+/* Switches to another PCR pid when none has been received on the current
+ * one. Runs on the input thread, which owns the pids. */
+static bool PCRFixSwitch( demux_t *p_demux, ts_pmt_t *p_pmt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_pmt->pcr.i_current >= 0 ||
+        GetPID( p_sys, p_pmt->i_pid_pcr )->probed.i_pcr_count > 0 )
+        return false;
+
+    int i_cand = FindPCRCandidate( p_pmt );
+    p_pmt->i_pid_pcr = i_cand;
+    if ( GetPID( p_sys, p_pmt->i_pid_pcr )->probed.i_pcr_count == 0 )
+        p_pmt->pcr.b_disable = true;
+    msg_Warn( p_demux, "No PCR received for program %d, set up workaround using pid %d",
+              p_pmt->i_number, i_cand );
+    return true;
+}
+
+/* Handles the switches requested by the program threads, once idle */
+static void PCRFixRequests( demux_t *p_demux )
+{
+    ts_pat_t *p_pat = GetPID( p_demux->p_sys, 0 )->u.p_pat;
+
+    for( int i = 0; i < p_pat->programs.i_size; i++ )
+    {
+        ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+        if( p_pmt->pcr.b_fix_request )
+        {
+            p_pmt->pcr.b_fix_request = false;
+            PCRFixSwitch( p_demux, p_pmt );
+        }
+    }
+}
+
 /* Tries to reselect a new PCR when none has been received */
 static void PCRFixHandle( demux_t *p_demux, ts_pmt_t *p_pmt, block_t *p_block )
 {
@@ -3136,21 +3450,55 @@ static void PCRFixHandle( demux_t *p_demux, ts_pmt_t *p_pmt, block_t *p_block )
     }
     else if( p_block->i_dts - p_pmt->pcr.i_first_dts > CLOCK_FREQ / 2 ) /* "PCR repeat rate shall not exceed 100ms" */
     {
-        if( p_pmt->pcr.i_current < 0 &&
-            GetPID( p_demux->p_sys, p_pmt->i_pid_pcr )->probed.i_pcr_count == 0 )
+        demux_sys_t *p_sys = p_demux->p_sys;
+
+        if( ProgramsInParallel( p_sys ) )
         {
-            int i_cand = FindPCRCandidate( p_pmt );
-            p_pmt->i_pid_pcr = i_cand;
-            if ( GetPID( p_demux->p_sys, p_pmt->i_pid_pcr )->probed.i_pcr_count == 0 )
-                p_pmt->pcr.b_disable = true;
-            msg_Warn( p_demux, "No PCR received for program %d, set up workaround using pid %d",
-                      p_pmt->i_number, i_cand );
-            UpdatePESFilters( p_demux, p_demux->p_sys->b_es_all );
+            /* The pids are read and updated by the input thread */
+            p_pmt->pcr.b_fix_request = true;
+            atomic_store( &p_sys->workers.b_update_filters, true );
+        }
+        else if( PCRFixSwitch( p_demux, p_pmt ) )
+        {
+            UpdatePESFilters( p_demux, p_sys->b_es_all );
         }
         p_pmt->pcr.b_fix_done = true;
     }
 }
 
+/* Minimum size of the gathering buffer of PES without length */
+#define PES_GATHER_MIN 4096
+
+/* Appends the payload to the gathered PES. The buffer is allocated from the
+ * PES length when known, and grows geometrically otherwise, so that the PES
+ * is copied once. */
+static void GatherPayload( ts_pes_t *p_pes, const uint8_t *p_payload, size_t i_payload )
+{
+    block_t *p_data = p_pes->p_data;
+    const size_t i_used = p_data ? p_data->i_buffer : 0;
+
+    if( p_data == NULL || p_pes->i_data_alloc < i_used + i_payload )
+    {
+        size_t i_alloc = p_pes->i_data_size > 0 ? (size_t)p_pes->i_data_size
+                                                : __MAX( 2 * i_used, PES_GATHER_MIN );
+        i_alloc = __MAX( i_alloc, i_used + i_payload );
+
+        p_data = p_data ? block_Realloc( p_data, 0, i_alloc )
+                        : block_Alloc( i_alloc );
+        p_pes->p_data = p_data;
+        if( unlikely(p_data == NULL) )
+        {
+            p_pes->i_data_gathered = p_pes->i_data_size = 0;
+            return;
+        }
+        p_data->i_buffer = i_used;
+        p_pes->i_data_alloc = i_alloc;
+    }
+
+    memcpy( &p_data->p_buffer[i_used], p_payload, i_payload );
+    p_data->i_buffer += i_payload;
+}
+
 static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 {
     const uint8_t *p = p_bk->p_buffer;
@@ -3182,13 +3530,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             pid->u.p_pes->p_data->i_flags |= BLOCK_FLAG_CORRUPTED;
     }
 
-    if( p_demux->p_sys->csa )
-    {
-        vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
-        vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
-    }
-
     if( !b_adaptation )
     {
         /* We don't have any adaptation_field, so payload starts
@@ -3252,8 +3593,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
-
     if( i_skip >= 188 )
     {
         block_Release( p_bk );
@@ -3269,13 +3608,7 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         if( pid->u.p_pes->data_type == TS_ES_DATA_TABLE_SECTION && p_bk->i_buffer > 0 )
         {
             int i_pointer_field = __MIN( p_bk->p_buffer[0], p_bk->i_buffer - 1 );
-            block_t *p = block_Duplicate( p_bk );
-            if( p )
-            {
-                p->i_buffer = i_pointer_field;
-                p->p_buffer++;
-                block_ChainLastAppend( &pid->u.p_pes->pp_last, p );
-            }
+            GatherPayload( pid->u.p_pes, &p_bk->p_buffer[1], i_pointer_field );
             p_bk->i_buffer -= 1 + i_pointer_field;
             p_bk->p_buffer += 1 + i_pointer_field;
         }
@@ -3285,7 +3618,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             i_ret = true;
         }
 
-        block_ChainLastAppend( &pid->u.p_pes->pp_last, p_bk );
         if( pid->u.p_pes->data_type == TS_ES_DATA_PES )
         {
             if( p_bk->i_buffer > 6 )
@@ -3304,6 +3636,7 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
                 pid->u.p_pes->i_data_size = 3 + (((p_bk->p_buffer[1] & 0xf) << 8) | p_bk->p_buffer[2]);
             }
         }
+        GatherPayload( pid->u.p_pes, p_bk->p_buffer, p_bk->i_buffer );
         pid->u.p_pes->i_data_gathered += p_bk->i_buffer;
         if( pid->u.p_pes->i_data_size > 0 &&
             pid->u.p_pes->i_data_gathered >= pid->u.p_pes->i_data_size )
@@ -3317,11 +3650,10 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         if( pid->u.p_pes->p_data == NULL )
         {
             /* msg_Dbg( p_demux, "broken packet" ); */
-            block_Release( p_bk );
         }
         else
         {
-            block_ChainLastAppend( &pid->u.p_pes->pp_last, p_bk );
+            GatherPayload( pid->u.p_pes, p_bk->p_buffer, p_bk->i_buffer );
             pid->u.p_pes->i_data_gathered += p_bk->i_buffer;
 
             if( pid->u.p_pes->i_data_size > 0 &&
@@ -3333,9 +3665,229 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
+    block_Release( p_bk );
     return i_ret;
 }
 
+/*****************************************************************************
+ * Program threads: each one gathers the PES of a share of the programs and
+ * sends them. The input thread reads, descrambles and dispatches the
+ * packets, and parses the tables once the threads are idle.
+ *****************************************************************************/
+static void WorkerQueue( ts_worker_t *p_worker, block_t *p_bk )
+{
+    vlc_mutex_lock( &p_worker->lock );
+    while( p_worker->i_depth >= TS_WORKER_QUEUE )
+        vlc_cond_wait( &p_worker->drained, &p_worker->lock );
+
+    if( p_worker->p_first == NULL )
+        vlc_cond_signal( &p_worker->wait );
+    block_ChainLastAppend( &p_worker->pp_last, p_bk );
+    p_worker->i_depth++;
+    vlc_mutex_unlock( &p_worker->lock );
+}
+
+static void WorkerDemux( demux_t *p_demux, int i_worker, block_t *p_bk )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_pid_t *pid = GetPID( p_sys, PIDGet( p_bk->p_buffer ) );
+
+    if( p_bk->i_flags & BLOCK_FLAG_CLOCK )
+    {
+        const mtime_t i_pcr = GetPCR( p_bk->p_buffer );
+        ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
+
+        for( int i = 0; i < p_pat->programs.i_size; i++ )
+        {
+            ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+            if( p_pmt->i_worker == i_worker &&
+                ProgramTakesPCR( p_pat->programs.p_elems[i], pid ) )
+                ProgramSetPCR( p_demux, p_pmt, TimeStampWrapAround( p_pmt, i_pcr ) );
+        }
+        p_bk->i_flags &= ~BLOCK_FLAG_CLOCK;
+    }
+
+    if( PIDWorker( pid ) == i_worker )
+        GatherData( p_demux, pid, p_bk );
+    else
+        block_Release( p_bk );
+}
+
+static void *WorkerThread( void *data )
+{
+    ts_worker_t *p_worker = data;
+
+    vlc_mutex_lock( &p_worker->lock );
+    for( ;; )
+    {
+        while( p_worker->p_first == NULL && !p_worker->b_exit )
+            vlc_cond_wait( &p_worker->wait, &p_worker->lock );
+        if( p_worker->p_first == NULL )
+            break;
+
+        /* Take the whole queue */
+        block_t *p_bk = p_worker->p_first;
+        p_worker->p_first = NULL;
+        p_worker->pp_last = &p_worker->p_first;
+        p_worker->i_depth = 0;
+        p_worker->b_busy = true;
+        vlc_cond_broadcast( &p_worker->drained );
+        vlc_mutex_unlock( &p_worker->lock );
+
+        while( p_bk )
+        {
+            block_t *p_next = p_bk->p_next;
+            p_bk->p_next = NULL;
+            WorkerDemux( p_worker->p_demux, p_worker->i_index, p_bk );
+            p_bk = p_next;
+        }
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->b_busy = false;
+        vlc_cond_broadcast( &p_worker->drained );
+    }
+    vlc_mutex_unlock( &p_worker->lock );
+
+    return NULL;
+}
+
+static int WorkersStart( demux_t *p_demux, int i_count )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    p_sys->workers.p_elems = calloc( i_count, sizeof(ts_worker_t) );
+    if( !p_sys->workers.p_elems )
+        return VLC_ENOMEM;
+
+    for( int i = 0; i < i_count; i++ )
+    {
+        ts_worker_t *p_worker = &p_sys->workers.p_elems[i];
+
+        p_worker->p_demux = p_demux;
+        p_worker->i_index = i;
+        p_worker->pp_last = &p_worker->p_first;
+        vlc_mutex_init( &p_worker->lock );
+        vlc_cond_init( &p_worker->wait );
+        vlc_cond_init( &p_worker->drained );
+
+        if( vlc_clone( &p_worker->thread, WorkerThread, p_worker,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+        {
+            vlc_cond_destroy( &p_worker->drained );
+            vlc_cond_destroy( &p_worker->wait );
+            vlc_mutex_destroy( &p_worker->lock );
+            break;
+        }
+        p_sys->workers.i_count++;
+    }
+
+    if( p_sys->workers.i_count == 0 )
+    {
+        FREENULL( p_sys->workers.p_elems );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_demux, "demuxing programs with %d threads",
+             p_sys->workers.i_count );
+    return VLC_SUCCESS;
+}
+
+/* Processes the queued packets and stops the threads */
+static void WorkersStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( int i = 0; i < p_sys->workers.i_count; i++ )
+    {
+        ts_worker_t *p_worker = &p_sys->workers.p_elems[i];
+
+        vlc_mutex_lock( &p_worker->lock );
+        p_worker->b_exit = true;
+        vlc_cond_signal( &p_worker->wait );
+        vlc_mutex_unlock( &p_worker->lock );
+
+        vlc_join( p_worker->thread, NULL );
+        vlc_cond_destroy( &p_worker->drained );
+        vlc_cond_destroy( &p_worker->wait );
+        vlc_mutex_destroy( &p_worker->lock );
+    }
+
+    free( p_sys->workers.p_elems );
+    p_sys->workers.p_elems = NULL;
+    p_sys->workers.i_count = 0;
+}
+
+/* Waits for the threads to process all queued packets, before the input
+ * thread touches the pids or programs */
+static void WorkersSync( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( int i = 0; i < p_sys->workers.i_count; i++ )
+    {
+        ts_worker_t *p_worker = &p_sys->workers.p_elems[i];
+
+        vlc_mutex_lock( &p_worker->lock );
+        while( p_worker->p_first != NULL || p_worker->b_busy )
+            vlc_cond_wait( &p_worker->drained, &p_worker->lock );
+        vlc_mutex_unlock( &p_worker->lock );
+    }
+}
+
+/* Queues the packet to the thread of its program, and sets its PCR to the
+ * programs taking their clock from it, through their own thread */
+static void DispatchPacket( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int i_owner = PIDWorker( pid );
+    uint64_t i_clocked = 0;
+
+    const mtime_t i_pcr = GetPCR( p_pkt );
+    if( i_pcr >= 0 )
+    {
+        pid->probed.i_pcr_count++;
+
+        ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
+        for( int i = 0; p_sys->i_pmt_es > 0 && i < p_pat->programs.i_size; i++ )
+        {
+            ts_pmt_t *p_pmt = p_pat->programs.p_elems[i]->u.p_pmt;
+
+            if( !ProgramTakesPCR( p_pat->programs.p_elems[i], pid ) )
+                continue;
+            if( p_pmt->i_worker >= 0 )
+                i_clocked |= UINT64_C(1) << p_pmt->i_worker;
+            else
+                ProgramSetPCR( p_demux, p_pmt, TimeStampWrapAround( p_pmt, i_pcr ) );
+        }
+    }
+
+    for( int i = 0; i < p_sys->workers.i_count; i++ )
+    {
+        const bool b_clock = i_clocked & (UINT64_C(1) << i);
+        if( i != i_owner && !b_clock )
+            continue;
+
+        block_t *p_bk = NewPacketBlock( p_demux, p_pkt );
+        if( unlikely(p_bk == NULL) )
+            continue;
+        if( b_clock )
+            p_bk->i_flags |= BLOCK_FLAG_CLOCK;
+        WorkerQueue( &p_sys->workers.p_elems[i], p_bk );
+    }
+}
+
+/* Called while demuxing a program. The program threads can't touch the
+ * other programs, so the input thread does it on its next demux call. */
+static void RequestPESFiltersUpdate( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( ProgramsInParallel( p_sys ) )
+        atomic_store( &p_sys->workers.b_update_filters, true );
+    else
+        UpdatePESFilters( p_demux, p_sys->b_es_all );
+}
+
 static void PIDFillFormat( es_format_t *fmt, int i_stream_type, ts_es_data_type_t *p_datatype )
 {
     switch( i_stream_type )
@@ -5002,6 +5554,8 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
 
     msg_Dbg( p_demux, "PMTCallBack called" );
 
+    WorkersSync( p_demux );
+
     if (unlikely(GetPID(p_sys, 0)->type != TYPE_PAT))
     {
         assert(GetPID(p_sys, 0)->type == TYPE_PAT);
@@ -5385,12 +5939,22 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     {
         if ( p_sys->arib.e_mode == ARIBMODE_ENABLED && !p_sys->arib.b25stream )
         {
-            p_sys->arib.b25stream = stream_FilterNew( p_demux->s, "aribcam" );
-            p_sys->stream = ( p_sys->arib.b25stream ) ? p_sys->arib.b25stream : p_demux->s;
+            /* Hand the packets we read ahead over to the descrambler */
+            if( stream_Seek( p_demux->s, TSTell( p_sys ) ) == VLC_SUCCESS )
+            {
+                TSFlush( p_sys );
+                p_sys->arib.b25stream = stream_FilterNew( p_demux->s, "aribcam" );
+                p_sys->stream = ( p_sys->arib.b25stream ) ? p_sys->arib.b25stream : p_demux->s;
+            }
+            else
+                msg_Err( p_demux, "cannot seek back to insert the ARIB descrambler" );
             if (!p_sys->arib.b25stream)
                 dvbpsi_pmt_delete( p_dvbpsipmt );
         } else dvbpsi_pmt_delete( p_dvbpsipmt );
     }
+    /* The descrambler is set up with the first selected program */
+    if( ProgramIsSelected( p_sys, p_pmt->i_number ) )
+        p_sys->arib.b_pending = false;
 
     /* Decref or clean now unused es */
     for( int i = 0; i < old_es_rm.i_size; i++ )
@@ -5412,8 +5976,19 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     if( p_sys->b_canfastseek && p_pmt->i_last_dts == -1 )
     {
         p_pmt->i_last_dts = 0;
-        ProbeStart( p_demux, p_pmt->i_number );
-        ProbeEnd( p_demux, p_pmt->i_number );
+        if( !p_sys->p_index ||
+            !ts_index_GetBounds( p_sys->p_index, p_pmt->i_number,
+                                 &p_pmt->pcr.i_first, &p_pmt->pcr.i_first_dts,
+                                 &p_pmt->i_last_dts ) )
+        {
+            bool b_probed = ProbeStart( p_demux, p_pmt->i_number ) == VLC_SUCCESS;
+            b_probed &= ProbeEnd( p_demux, p_pmt->i_number ) == VLC_SUCCESS;
+            /* Only cache complete results, so failed probes get retried */
+            if( p_sys->p_index && b_probed )
+                ts_index_SetBounds( p_sys->p_index, p_pmt->i_number,
+                                    p_pmt->pcr.i_first, p_pmt->pcr.i_first_dts,
+                                    p_pmt->i_last_dts );
+        }
     }
 }
 
@@ -5447,6 +6022,8 @@ static void PATCallBack( void *data, dvbpsi_pat_t *p_dvbpsipat )
 
     msg_Dbg( p_demux, "PATCallBack called" );
 
+    WorkersSync( p_demux );
+
     if(unlikely( GetPID(p_sys, 0)->type != TYPE_PAT ))
     {
         msg_Warn( p_demux, "PATCallBack called on invalid pid" );
@@ -5601,6 +6178,13 @@ static ts_pmt_t *ts_pmt_New( demux_t *p_demux )
     pmt->pcr.i_pcroffset = -1;
 
     pmt->pcr.b_fix_done = false;
+    pmt->pcr.b_fix_request = false;
+
+    demux_sys_t *p_sys = p_demux->p_sys;
+    if( p_sys->workers.i_count > 0 )
+        pmt->i_worker = p_sys->workers.i_next++ % p_sys->workers.i_count;
+    else
+        pmt->i_worker = -1;
 
     return pmt;
 }
@@ -5639,7 +6223,7 @@ static ts_pes_t *ts_pes_New( demux_t *p_demux )
     pes->i_data_size = 0;
     pes->i_data_gathered = 0;
     pes->p_data = NULL;
-    pes->pp_last = &pes->p_data;
+    pes->i_data_alloc = 0;
     pes->p_prepcr_outqueue = NULL;
     pes->sl.p_data = NULL;
     pes->sl.pp_last = &pes->sl.p_data;
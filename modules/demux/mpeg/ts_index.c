@@ -0,0 +1,394 @@
+/*****************************************************************************
+ * ts_index.c: MPEG-TS time to byte offset index
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include "ts_index.h"
+
+/* Sidecar layout, big endian:
+ * magic, stream size, program count, then for each program:
+ * number, bounds flag, first, first dts, last, point count,
+ * points (time, pos) */
+static const char psz_magic[8] = { 'V', 'L', 'C', 'T', 'S', 'I', 'X', 2 };
+#define INDEX_MAX_POINTS (1 << 24)
+
+typedef struct
+{
+    int               i_number;
+    bool              b_bounds;
+    int64_t           i_first;
+    int64_t           i_first_dts;
+    int64_t           i_last;
+    ts_index_entry_t *p_entries;
+    size_t            i_count;
+    size_t            i_alloc;
+} ts_index_program_t;
+
+struct ts_index_t
+{
+    int64_t             i_interval;
+    uint64_t            i_size;
+    bool                b_dirty;
+    ts_index_program_t *p_programs;
+    size_t              i_programs;
+};
+
+ts_index_t *ts_index_New( int64_t i_interval, uint64_t i_size )
+{
+    ts_index_t *p_index = malloc( sizeof(*p_index) );
+    if( !p_index )
+        return NULL;
+    p_index->i_interval = i_interval;
+    p_index->i_size = i_size;
+    p_index->b_dirty = false;
+    p_index->p_programs = NULL;
+    p_index->i_programs = 0;
+    return p_index;
+}
+
+void ts_index_Delete( ts_index_t *p_index )
+{
+    for( size_t i = 0; i < p_index->i_programs; i++ )
+        free( p_index->p_programs[i].p_entries );
+    free( p_index->p_programs );
+    free( p_index );
+}
+
+static ts_index_program_t *GetProgram( const ts_index_t *p_index, int i_program )
+{
+    for( size_t i = 0; i < p_index->i_programs; i++ )
+        if( p_index->p_programs[i].i_number == i_program )
+            return &p_index->p_programs[i];
+    return NULL;
+}
+
+static ts_index_program_t *NewProgram( ts_index_t *p_index, int i_program )
+{
+    ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( p_prg )
+        return p_prg;
+
+    p_prg = realloc( p_index->p_programs,
+                     (p_index->i_programs + 1) * sizeof(*p_prg) );
+    if( !p_prg )
+        return NULL;
+    p_index->p_programs = p_prg;
+
+    p_prg = &p_index->p_programs[p_index->i_programs++];
+    p_prg->i_number = i_program;
+    p_prg->b_bounds = false;
+    p_prg->i_first = p_prg->i_last = -1;
+    p_prg->i_first_dts = 0;
+    p_prg->p_entries = NULL;
+    p_prg->i_count = p_prg->i_alloc = 0;
+    return p_prg;
+}
+
+/* Index of the first point after i_pos */
+static size_t FindPos( const ts_index_program_t *p_prg, uint64_t i_pos )
+{
+    size_t i_lo = 0, i_hi = p_prg->i_count;
+    while( i_lo < i_hi )
+    {
+        size_t i_mid = (i_lo + i_hi) / 2;
+        if( p_prg->p_entries[i_mid].i_pos <= i_pos )
+            i_lo = i_mid + 1;
+        else
+            i_hi = i_mid;
+    }
+    return i_lo;
+}
+
+/* Index of the first point after i_time */
+static size_t FindTime( const ts_index_program_t *p_prg, int64_t i_time )
+{
+    size_t i_lo = 0, i_hi = p_prg->i_count;
+    while( i_lo < i_hi )
+    {
+        size_t i_mid = (i_lo + i_hi) / 2;
+        if( p_prg->p_entries[i_mid].i_time <= i_time )
+            i_lo = i_mid + 1;
+        else
+            i_hi = i_mid;
+    }
+    return i_lo;
+}
+
+void ts_index_Add( ts_index_t *p_index, int i_program, int64_t i_time, uint64_t i_pos )
+{
+    if( i_time < 0 )
+        return;
+
+    ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( !p_prg && !(p_prg = NewProgram( p_index, i_program )) )
+        return;
+
+    /* Keep points apart, and ordered by time as well as by offset:
+     * anything around a discontinuity is left out */
+    size_t i = FindPos( p_prg, i_pos );
+    if( i > 0 )
+    {
+        const ts_index_entry_t *p_prev = &p_prg->p_entries[i - 1];
+        if( i_time < p_prev->i_time + p_index->i_interval )
+            return;
+    }
+    if( i < p_prg->i_count )
+    {
+        const ts_index_entry_t *p_next = &p_prg->p_entries[i];
+        if( i_time + p_index->i_interval > p_next->i_time )
+            return;
+    }
+
+    if( p_prg->i_count >= p_prg->i_alloc )
+    {
+        size_t i_alloc = p_prg->i_alloc ? p_prg->i_alloc * 2 : 256;
+        if( i_alloc > INDEX_MAX_POINTS )
+            return;
+        ts_index_entry_t *p_realloc = realloc( p_prg->p_entries,
+                                               i_alloc * sizeof(*p_realloc) );
+        if( !p_realloc )
+            return;
+        p_prg->p_entries = p_realloc;
+        p_prg->i_alloc = i_alloc;
+    }
+
+    memmove( &p_prg->p_entries[i + 1], &p_prg->p_entries[i],
+             (p_prg->i_count - i) * sizeof(*p_prg->p_entries) );
+    p_prg->p_entries[i].i_time = i_time;
+    p_prg->p_entries[i].i_pos = i_pos;
+    p_prg->i_count++;
+    p_index->b_dirty = true;
+}
+
+void ts_index_Find( const ts_index_t *p_index, int i_program, int64_t i_time,
+                    ts_index_entry_t *p_before, ts_index_entry_t *p_after )
+{
+    p_before->i_time = p_after->i_time = -1;
+
+    const ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( !p_prg )
+        return;
+
+    size_t i = FindTime( p_prg, i_time );
+    if( i > 0 )
+        *p_before = p_prg->p_entries[i - 1];
+    if( i < p_prg->i_count )
+        *p_after = p_prg->p_entries[i];
+}
+
+void ts_index_SetBounds( ts_index_t *p_index, int i_program, int64_t i_first,
+                         int64_t i_first_dts, int64_t i_last )
+{
+    ts_index_program_t *p_prg = NewProgram( p_index, i_program );
+    if( !p_prg )
+        return;
+    if( p_prg->b_bounds && p_prg->i_first == i_first &&
+        p_prg->i_first_dts == i_first_dts && p_prg->i_last == i_last )
+        return;
+    p_prg->b_bounds = true;
+    p_prg->i_first = i_first;
+    p_prg->i_first_dts = i_first_dts;
+    p_prg->i_last = i_last;
+    p_index->b_dirty = true;
+}
+
+bool ts_index_GetBounds( const ts_index_t *p_index, int i_program, int64_t *pi_first,
+                         int64_t *pi_first_dts, int64_t *pi_last )
+{
+    const ts_index_program_t *p_prg = GetProgram( p_index, i_program );
+    if( !p_prg || !p_prg->b_bounds )
+        return false;
+    *pi_first = p_prg->i_first;
+    *pi_first_dts = p_prg->i_first_dts;
+    *pi_last = p_prg->i_last;
+    return true;
+}
+
+/*****************************************************************************
+ * Sidecar file
+ *****************************************************************************/
+static bool ReadU32( FILE *p_file, uint32_t *pi_val )
+{
+    uint8_t p_buf[4];
+    if( fread( p_buf, sizeof(p_buf), 1, p_file ) != 1 )
+        return false;
+    *pi_val = GetDWBE( p_buf );
+    return true;
+}
+
+static bool ReadU64( FILE *p_file, uint64_t *pi_val )
+{
+    uint8_t p_buf[8];
+    if( fread( p_buf, sizeof(p_buf), 1, p_file ) != 1 )
+        return false;
+    *pi_val = GetQWBE( p_buf );
+    return true;
+}
+
+static bool WriteU32( FILE *p_file, uint32_t i_val )
+{
+    uint8_t p_buf[4];
+    SetDWBE( p_buf, i_val );
+    return fwrite( p_buf, sizeof(p_buf), 1, p_file ) == 1;
+}
+
+static bool WriteU64( FILE *p_file, uint64_t i_val )
+{
+    uint8_t p_buf[8];
+    SetQWBE( p_buf, i_val );
+    return fwrite( p_buf, sizeof(p_buf), 1, p_file ) == 1;
+}
+
+static bool LoadProgram( ts_index_t *p_index, FILE *p_file )
+{
+    uint32_t i_number, i_bounds, i_count;
+    uint64_t i_first, i_first_dts, i_last;
+
+    if( !ReadU32( p_file, &i_number ) || !ReadU32( p_file, &i_bounds ) ||
+        !ReadU64( p_file, &i_first ) || !ReadU64( p_file, &i_first_dts ) ||
+        !ReadU64( p_file, &i_last ) ||
+        !ReadU32( p_file, &i_count ) || i_count > INDEX_MAX_POINTS ||
+        i_number > UINT16_MAX )
+        return false;
+
+    ts_index_program_t *p_prg = NewProgram( p_index, i_number );
+    if( !p_prg || p_prg->i_count )
+        return false;
+
+    if( i_bounds )
+    {
+        p_prg->b_bounds = true;
+        p_prg->i_first = i_first;
+        p_prg->i_first_dts = i_first_dts;
+        p_prg->i_last = i_last;
+    }
+
+    if( i_count == 0 )
+        return true;
+
+    p_prg->p_entries = malloc( i_count * sizeof(*p_prg->p_entries) );
+    if( !p_prg->p_entries )
+        return false;
+    p_prg->i_alloc = i_count;
+
+    for( uint32_t i = 0; i < i_count; i++ )
+    {
+        uint64_t i_time, i_pos;
+        if( !ReadU64( p_file, &i_time ) || !ReadU64( p_file, &i_pos ) ||
+            (int64_t)i_time < 0 || i_pos >= p_index->i_size )
+            return false;
+
+        /* Both keys must be strictly increasing */
+        if( i > 0 && ( (int64_t)i_time <= p_prg->p_entries[i - 1].i_time ||
+                       i_pos <= p_prg->p_entries[i - 1].i_pos ) )
+            return false;
+
+        p_prg->p_entries[i].i_time = i_time;
+        p_prg->p_entries[i].i_pos = i_pos;
+        p_prg->i_count++;
+    }
+    return true;
+}
+
+ts_index_t *ts_index_Load( const char *psz_path, int64_t i_interval, uint64_t i_size )
+{
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    if( !p_file )
+        return NULL;
+
+    ts_index_t *p_index = ts_index_New( i_interval, i_size );
+    if( !p_index )
+    {
+        fclose( p_file );
+        return NULL;
+    }
+
+    char p_magic[sizeof(psz_magic)];
+    uint64_t i_stream_size;
+    uint32_t i_programs;
+    bool b_ok = fread( p_magic, sizeof(p_magic), 1, p_file ) == 1 &&
+                !memcmp( p_magic, psz_magic, sizeof(psz_magic) ) &&
+                ReadU64( p_file, &i_stream_size ) && i_stream_size == i_size &&
+                ReadU32( p_file, &i_programs ) && i_programs <= UINT16_MAX;
+
+    for( uint32_t i = 0; b_ok && i < i_programs; i++ )
+        b_ok = LoadProgram( p_index, p_file );
+
+    fclose( p_file );
+
+    if( !b_ok )
+    {
+        ts_index_Delete( p_index );
+        return NULL;
+    }
+    return p_index;
+}
+
+int ts_index_Save( ts_index_t *p_index, const char *psz_path )
+{
+    if( !p_index->b_dirty )
+        return VLC_SUCCESS;
+
+    FILE *p_file = vlc_fopen( psz_path, "wb" );
+    if( !p_file )
+        return VLC_EGENERIC;
+
+    bool b_ok = fwrite( psz_magic, sizeof(psz_magic), 1, p_file ) == 1 &&
+                WriteU64( p_file, p_index->i_size ) &&
+                WriteU32( p_file, p_index->i_programs );
+
+    for( size_t i = 0; b_ok && i < p_index->i_programs; i++ )
+    {
+        const ts_index_program_t *p_prg = &p_index->p_programs[i];
+        b_ok = WriteU32( p_file, p_prg->i_number ) &&
+               WriteU32( p_file, p_prg->b_bounds ) &&
+               WriteU64( p_file, p_prg->i_first ) &&
+               WriteU64( p_file, p_prg->i_first_dts ) &&
+               WriteU64( p_file, p_prg->i_last ) &&
+               WriteU32( p_file, p_prg->i_count );
+
+        for( size_t j = 0; b_ok && j < p_prg->i_count; j++ )
+            b_ok = WriteU64( p_file, p_prg->p_entries[j].i_time ) &&
+                   WriteU64( p_file, p_prg->p_entries[j].i_pos );
+    }
+
+    if( fclose( p_file ) )
+        b_ok = false;
+
+    if( !b_ok )
+    {
+        vlc_unlink( psz_path );
+        return VLC_EGENERIC;
+    }
+
+    p_index->b_dirty = false;
+    return VLC_SUCCESS;
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * ts_index.h: MPEG-TS time to byte offset index
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/* Per program list of (PCR, packet offset) points, ordered by both.
+ * Times are in the 90kHz PCR scale. */
+typedef struct ts_index_t ts_index_t;
+
+typedef struct
+{
+    int64_t  i_time;
+    uint64_t i_pos;
+} ts_index_entry_t;
+
+/* i_interval is the minimum time between two points,
+ * i_size the indexed stream size, checked when loading */
+ts_index_t *ts_index_New( int64_t i_interval, uint64_t i_size );
+void ts_index_Delete( ts_index_t * );
+
+void ts_index_Add( ts_index_t *, int i_program, int64_t i_time, uint64_t i_pos );
+
+/* Finds the points around i_time. Missing ones have i_time set to -1. */
+void ts_index_Find( const ts_index_t *, int i_program, int64_t i_time,
+                    ts_index_entry_t *p_before, ts_index_entry_t *p_after );
+
+/* First PCR, first timestamp (in mtime_t) for streams without PCR at start,
+ * and last timestamp found by probing the stream boundaries */
+void ts_index_SetBounds( ts_index_t *, int i_program, int64_t i_first,
+                         int64_t i_first_dts, int64_t i_last );
+bool ts_index_GetBounds( const ts_index_t *, int i_program, int64_t *pi_first,
+                         int64_t *pi_first_dts, int64_t *pi_last );
+
+/* Sidecar file storage */
+ts_index_t *ts_index_Load( const char *psz_path, int64_t i_interval, uint64_t i_size );
+int ts_index_Save( ts_index_t *, const char *psz_path );
+
+#endif
@@ -610,3 +610,587 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+
+/*****************************************************************************
+ * Batches
+ *****************************************************************************
+ * The stream cypher runs bit sliced: each bit of a word belongs to another
+ * packet, so that one pass produces the key stream of a whole batch. The
+ * block cypher chaining stays per packet, as in the functions above.
+ *****************************************************************************/
+#if defined(__AVX2__)
+#   define CSA_WORD_SIZE 32
+#elif defined(__SSE2__) || defined(__ARM_NEON__)
+#   define CSA_WORD_SIZE 16
+#else
+#   define CSA_WORD_SIZE 8
+#endif
+#define CSA_LANES (CSA_WORD_SIZE * 8)
+
+/* Below that, the per packet code is faster */
+#define CSA_BATCH_MIN 8
+
+typedef uint64_t csa_word_t __attribute__((vector_size(CSA_WORD_SIZE)));
+
+/* Steps between two moves of the shift registers */
+#define CSA_BS_SHIFTS 64
+
+typedef struct
+{
+    /* nibbles as 4 bit slices, least significant first.
+     * A and B are windows sliding down their buffers on every step */
+    csa_word_t a[CSA_BS_SHIFTS + 11][4];
+    csa_word_t b[CSA_BS_SHIFTS + 11][4];
+    csa_word_t (*A)[4];
+    csa_word_t (*B)[4];
+    csa_word_t X[4], Y[4], Z[4];
+    csa_word_t D[4], E[4], F[4];
+    csa_word_t p, q, r;
+} csa_bs_t;
+
+typedef struct
+{
+    uint8_t       *pkt;
+    uint8_t       *kk;
+    const uint8_t *ck;
+    int            i_hdr;
+    int            n;
+    /* key stream is xored from p_data, i_data bytes */
+    uint8_t       *p_data;
+    int            i_data;
+} csa_lane_t;
+
+static inline void csa_BsSet( csa_word_t *w, int i_lane, unsigned i_bit )
+{
+    (*w)[i_lane / 64] |= (uint64_t)i_bit << (i_lane % 64);
+}
+
+static inline unsigned csa_BsGet( const csa_word_t *w, int i_lane )
+{
+    return ((*w)[i_lane / 64] >> (i_lane % 64)) & 1;
+}
+
+/* The s-boxes above as trees of multiplexers over their input bits,
+ * least significant index bit first */
+static inline void csa_Sbox1( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = in[0] ^ in[1];
+    const csa_word_t t3 = t1 & ~in[1];
+    const csa_word_t t4 = in[0] | ~in[1];
+    const csa_word_t t5 = in[1] & in[0];
+    const csa_word_t t6 = t1 | ~in[1];
+    const csa_word_t t7 = in[1] ^ (in[2] & (in[1] ^ t2));
+    const csa_word_t t8 = t3 ^ (in[2] & (t3 ^ t4));
+    const csa_word_t t9 = t2 ^ (in[2] & (t2 ^ in[1]));
+    const csa_word_t t10 = t5 ^ (in[2] & (t5 ^ t6));
+    const csa_word_t t11 = t7 ^ (in[3] & (t7 ^ t8));
+    const csa_word_t t12 = t9 ^ (in[3] & (t9 ^ t10));
+    const csa_word_t t13 = t11 ^ (in[4] & (t11 ^ t12));
+    const csa_word_t t14 = ~in[1];
+    const csa_word_t t15 = in[1] & t1;
+    const csa_word_t t16 = t3 ^ (in[2] & (t3 ^ t6));
+    const csa_word_t t17 = t6 ^ (in[2] & (t6 ^ t5));
+    const csa_word_t t18 = t2 ^ (in[2] & (t2 ^ t14));
+    const csa_word_t t19 = t4 ^ (in[2] & (t4 ^ t15));
+    const csa_word_t t20 = t16 ^ (in[3] & (t16 ^ t17));
+    const csa_word_t t21 = t18 ^ (in[3] & (t18 ^ t19));
+    const csa_word_t t22 = t20 ^ (in[4] & (t20 ^ t21));
+    *o0 = t13;
+    *o1 = t22;
+}
+
+static inline void csa_Sbox2( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = ~in[1];
+    const csa_word_t t3 = in[0] ^ in[1];
+    const csa_word_t t4 = in[0] | ~in[1];
+    const csa_word_t t5 = in[1] & t1;
+    const csa_word_t t6 = t1 & ~in[1];
+    const csa_word_t t7 = in[0] | in[1];
+    const csa_word_t t8 = t2 ^ (in[2] & (t2 ^ t3));
+    const csa_word_t t9 = t4 ^ (in[2] & (t4 ^ t5));
+    const csa_word_t t10 = t4 ^ (in[2] & (t4 ^ t6));
+    const csa_word_t t11 = t5 ^ (in[2] & (t5 ^ t7));
+    const csa_word_t t12 = t8 ^ (in[3] & (t8 ^ t9));
+    const csa_word_t t13 = t10 ^ (in[3] & (t10 ^ t11));
+    const csa_word_t t14 = t12 ^ (in[4] & (t12 ^ t13));
+    const csa_word_t t15 = t1 ^ in[1];
+    const csa_word_t t16 = t1 | ~in[1];
+    const csa_word_t t17 = in[1] & in[0];
+    const csa_word_t t18 = t15 ^ (in[2] & (t15 ^ t16));
+    const csa_word_t t19 = t3 ^ (in[2] & (t3 ^ t17));
+    const csa_word_t t20 = t15 ^ (in[2] & (t15 ^ t4));
+    const csa_word_t t21 = t17 ^ (in[2] & (t17 ^ t1));
+    const csa_word_t t22 = t18 ^ (in[3] & (t18 ^ t19));
+    const csa_word_t t23 = t20 ^ (in[3] & (t20 ^ t21));
+    const csa_word_t t24 = t22 ^ (in[4] & (t22 ^ t23));
+    *o0 = t14;
+    *o1 = t24;
+}
+
+static inline void csa_Sbox3( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = in[1] & t1;
+    const csa_word_t t3 = in[0] | in[1];
+    const csa_word_t t4 = in[0] | ~in[1];
+    const csa_word_t t5 = t1 & ~in[1];
+    const csa_word_t t6 = t2 ^ (in[2] & (t2 ^ t3));
+    const csa_word_t t7 = t4 ^ (in[2] & (t4 ^ t5));
+    const csa_word_t t8 = t6 ^ (in[3] & (t6 ^ t7));
+    const csa_word_t t9 = t7 ^ (in[3] & (t7 ^ t6));
+    const csa_word_t t10 = t8 ^ (in[4] & (t8 ^ t9));
+    const csa_word_t t11 = t1 ^ in[1];
+    const csa_word_t t12 = t1 | ~in[1];
+    const csa_word_t t13 = in[1] & in[0];
+    const csa_word_t t14 = in[0] & ~in[1];
+    const csa_word_t t15 = t1 | in[1];
+    const csa_word_t t16 = in[0] ^ in[1];
+    const csa_word_t t17 = t11 ^ (in[2] & (t11 ^ t12));
+    const csa_word_t t18 = t13 ^ (in[2] & (t13 ^ t1));
+    const csa_word_t t19 = t14 ^ (in[2] & (t14 ^ t15));
+    const csa_word_t t20 = t11 ^ (in[2] & (t11 ^ t16));
+    const csa_word_t t21 = t17 ^ (in[3] & (t17 ^ t18));
+    const csa_word_t t22 = t19 ^ (in[3] & (t19 ^ t20));
+    const csa_word_t t23 = t21 ^ (in[4] & (t21 ^ t22));
+    *o0 = t10;
+    *o1 = t23;
+}
+
+static inline void csa_Sbox4( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = in[0] | ~in[1];
+    const csa_word_t t3 = in[1] & t1;
+    const csa_word_t t4 = t1 ^ in[1];
+    const csa_word_t t5 = t1 | in[1];
+    const csa_word_t t6 = in[0] & ~in[1];
+    const csa_word_t t7 = t2 ^ (in[2] & (t2 ^ t3));
+    const csa_word_t t8 = t5 ^ (in[2] & (t5 ^ in[0]));
+    const csa_word_t t9 = t6 ^ (in[2] & (t6 ^ t4));
+    const csa_word_t t10 = t7 ^ (in[3] & (t7 ^ t4));
+    const csa_word_t t11 = t8 ^ (in[3] & (t8 ^ t9));
+    const csa_word_t t12 = t10 ^ (in[4] & (t10 ^ t11));
+    const csa_word_t t13 = in[0] ^ in[1];
+    const csa_word_t t14 = t3 ^ (in[2] & (t3 ^ t2));
+    const csa_word_t t15 = t14 ^ (in[3] & (t14 ^ t13));
+    const csa_word_t t16 = t11 ^ (in[4] & (t11 ^ t15));
+    *o0 = t12;
+    *o1 = t16;
+}
+
+static inline void csa_Sbox5( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = in[1] & in[0];
+    const csa_word_t t3 = in[0] | in[1];
+    const csa_word_t t4 = t1 ^ in[1];
+    const csa_word_t t5 = in[0] & ~in[1];
+    const csa_word_t t6 = ~in[1];
+    const csa_word_t t7 = t2 ^ (in[2] & (t2 ^ t1));
+    const csa_word_t t8 = t3 ^ (in[2] & (t3 ^ t4));
+    const csa_word_t t9 = t5 ^ (in[2] & (t5 ^ t3));
+    const csa_word_t t10 = t1 ^ (in[2] & (t1 ^ t6));
+    const csa_word_t t11 = t7 ^ (in[3] & (t7 ^ t8));
+    const csa_word_t t12 = t9 ^ (in[3] & (t9 ^ t10));
+    const csa_word_t t13 = t11 ^ (in[4] & (t11 ^ t12));
+    const csa_word_t t14 = t1 & ~in[1];
+    const csa_word_t t15 = in[1] & t1;
+    const csa_word_t t16 = t1 | ~in[1];
+    const csa_word_t t17 = t14 | in[2];
+    const csa_word_t t18 = in[1] ^ (in[2] & (in[1] ^ t15));
+    const csa_word_t t19 = t16 ^ (in[2] & (t16 ^ t5));
+    const csa_word_t t20 = in[1] ^ (in[2] & (in[1] ^ t4));
+    const csa_word_t t21 = t17 ^ (in[3] & (t17 ^ t18));
+    const csa_word_t t22 = t19 ^ (in[3] & (t19 ^ t20));
+    const csa_word_t t23 = t21 ^ (in[4] & (t21 ^ t22));
+    *o0 = t13;
+    *o1 = t23;
+}
+
+static inline void csa_Sbox6( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = t1 & ~in[1];
+    const csa_word_t t3 = in[0] ^ in[1];
+    const csa_word_t t4 = in[0] | in[1];
+    const csa_word_t t5 = in[0] & ~in[1];
+    const csa_word_t t6 = t1 | in[1];
+    const csa_word_t t7 = in[0] ^ (in[2] & (in[0] ^ t2));
+    const csa_word_t t8 = t3 ^ (in[2] & (t3 ^ t4));
+    const csa_word_t t9 = t5 ^ (in[2] & (t5 ^ t6));
+    const csa_word_t t10 = t7 ^ (in[3] & (t7 ^ t8));
+    const csa_word_t t11 = t9 ^ (in[3] & (t9 ^ t3));
+    const csa_word_t t12 = t10 ^ (in[4] & (t10 ^ t11));
+    const csa_word_t t13 = in[1] & t1;
+    const csa_word_t t14 = in[0] | ~in[1];
+    const csa_word_t t15 = t1 ^ in[1];
+    const csa_word_t t16 = in[1] ^ (in[2] & (in[1] ^ t3));
+    const csa_word_t t17 = t13 ^ (in[2] & (t13 ^ t14));
+    const csa_word_t t18 = t14 ^ (in[2] & (t14 ^ t2));
+    const csa_word_t t19 = t15 ^ (in[2] & (t15 ^ t3));
+    const csa_word_t t20 = t16 ^ (in[3] & (t16 ^ t17));
+    const csa_word_t t21 = t18 ^ (in[3] & (t18 ^ t19));
+    const csa_word_t t22 = t20 ^ (in[4] & (t20 ^ t21));
+    *o0 = t12;
+    *o1 = t22;
+}
+
+static inline void csa_Sbox7( const csa_word_t in[5], csa_word_t *o0, csa_word_t *o1 )
+{
+    const csa_word_t t1 = ~in[0];
+    const csa_word_t t2 = in[0] & ~in[1];
+    const csa_word_t t3 = t1 ^ in[1];
+    const csa_word_t t4 = t1 | in[1];
+    const csa_word_t t5 = in[0] ^ in[1];
+    const csa_word_t t6 = t2 ^ (in[2] & (t2 ^ t3));
+    const csa_word_t t7 = t4 ^ (in[2] & (t4 ^ t3));
+    const csa_word_t t8 = t4 ^ (in[2] & (t4 ^ t5));
+    const csa_word_t t9 = t5 ^ (in[2] & (t5 ^ t2));
+    const csa_word_t t10 = t6 ^ (in[3] & (t6 ^ t7));
+    const csa_word_t t11 = t8 ^ (in[3] & (t8 ^ t9));
+    const csa_word_t t12 = t10 ^ (in[4] & (t10 ^ t11));
+    const csa_word_t t13 = in[0] | in[1];
+    const csa_word_t t14 = t1 & ~in[1];
+    const csa_word_t t15 = in[1] & in[0];
+    const csa_word_t t16 = ~in[1];
+    const csa_word_t t17 = in[0] | ~in[1];
+    const csa_word_t t18 = t13 ^ (in[2] & (t13 ^ t14));
+    const csa_word_t t19 = t3 ^ (in[2] & (t3 ^ t5));
+    const csa_word_t t20 = in[1] ^ (in[2] & (in[1] ^ t15));
+    const csa_word_t t21 = t16 ^ (in[2] & (t16 ^ t17));
+    const csa_word_t t22 = t18 ^ (in[3] & (t18 ^ t19));
+    const csa_word_t t23 = t20 ^ (in[3] & (t20 ^ t21));
+    const csa_word_t t24 = t22 ^ (in[4] & (t22 ^ t23));
+    *o0 = t12;
+    *o1 = t24;
+}
+
+/* Two bits step of csa_StreamCypher, on all lanes.
+ * in_a/in_b are the input nibbles while initialising, NULL afterwards */
+static inline void csa_BsStep( csa_bs_t *s, const csa_word_t *in_a, const csa_word_t *in_b,
+                               csa_word_t *o_hi, csa_word_t *o_lo )
+{
+    csa_word_t (*A)[4] = s->A;
+    csa_word_t (*B)[4] = s->B;
+    csa_word_t s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+
+    const csa_word_t i1[5] = { A[9][0], A[7][3], A[6][1], A[1][2], A[4][0] };
+    const csa_word_t i2[5] = { A[9][1], A[7][0], A[6][3], A[3][2], A[2][1] };
+    const csa_word_t i3[5] = { A[6][2], A[5][3], A[5][1], A[2][0], A[1][3] };
+    const csa_word_t i4[5] = { A[8][0], A[4][2], A[2][3], A[1][1], A[3][3] };
+    const csa_word_t i5[5] = { A[9][2], A[8][1], A[6][0], A[4][3], A[5][2] };
+    const csa_word_t i6[5] = { A[9][3], A[7][2], A[5][0], A[4][1], A[3][1] };
+    const csa_word_t i7[5] = { A[8][3], A[8][2], A[7][1], A[3][0], A[2][2] };
+    csa_Sbox1( i1, &s1[0], &s1[1] );
+    csa_Sbox2( i2, &s2[0], &s2[1] );
+    csa_Sbox3( i3, &s3[0], &s3[1] );
+    csa_Sbox4( i4, &s4[0], &s4[1] );
+    csa_Sbox5( i5, &s5[0], &s5[1] );
+    csa_Sbox6( i6, &s6[0], &s6[1] );
+    csa_Sbox7( i7, &s7[0], &s7[1] );
+
+    /* extra nibble for T3 */
+    const csa_word_t extra_B[4] = {
+        B[9][2] ^ B[6][3] ^ B[3][1] ^ B[8][0],
+        B[5][3] ^ B[8][2] ^ B[4][0] ^ B[5][1],
+        B[6][0] ^ B[8][1] ^ B[3][3] ^ B[4][2],
+        B[3][0] ^ B[6][1] ^ B[7][2] ^ B[9][3],
+    };
+
+    csa_word_t next_A1[4], next_B1[4], rot_B1[4], next_E[4];
+    for( int k = 0; k < 4; k++ )
+    {
+        next_A1[k] = A[10][k] ^ s->X[k];
+        next_B1[k] = B[7][k] ^ B[10][k] ^ s->Y[k];
+        if( in_a )
+        {
+            next_A1[k] ^= s->D[k] ^ in_a[k];
+            next_B1[k] ^= in_b[k];
+        }
+    }
+
+    /* if p=1, rotate left */
+    for( int k = 0; k < 4; k++ )
+        rot_B1[k] = next_B1[(k + 3) % 4];
+    for( int k = 0; k < 4; k++ )
+        next_B1[k] ^= s->p & ( next_B1[k] ^ rot_B1[k] );
+
+    /* T3 */
+    for( int k = 0; k < 4; k++ )
+        s->D[k] = s->E[k] ^ s->Z[k] ^ extra_B[k];
+
+    /* T4: if q=1, F = Z + E + r, else F = E */
+    csa_word_t carry = s->r;
+    for( int k = 0; k < 4; k++ )
+    {
+        const csa_word_t t = s->Z[k] ^ s->E[k];
+        const csa_word_t sum = t ^ carry;
+        carry = ( s->Z[k] & s->E[k] ) | ( carry & t );
+        next_E[k] = s->F[k];
+        s->F[k] = s->E[k] ^ ( s->q & ( sum ^ s->E[k] ) );
+        s->E[k] = next_E[k];
+    }
+    s->r ^= s->q & ( carry ^ s->r );
+
+    if( s->A == s->a )
+    {
+        memmove( &s->a[CSA_BS_SHIFTS], &s->a[0], 11 * sizeof(s->a[0]) );
+        memmove( &s->b[CSA_BS_SHIFTS], &s->b[0], 11 * sizeof(s->b[0]) );
+        s->A = &s->a[CSA_BS_SHIFTS];
+        s->B = &s->b[CSA_BS_SHIFTS];
+    }
+    A = --s->A;
+    B = --s->B;
+    memcpy( A[1], next_A1, sizeof(A[1]) );
+    memcpy( B[1], next_B1, sizeof(B[1]) );
+
+    s->X[0] = s1[1]; s->X[1] = s2[1]; s->X[2] = s3[0]; s->X[3] = s4[0];
+    s->Y[0] = s3[1]; s->Y[1] = s4[1]; s->Y[2] = s5[0]; s->Y[3] = s6[0];
+    s->Z[0] = s5[1]; s->Z[1] = s6[1]; s->Z[2] = s1[0]; s->Z[3] = s2[0];
+    s->p = s7[1];
+    s->q = s7[0];
+
+    /* 2 output bits are a function of the 4 bits of D */
+    *o_hi = s->D[3] ^ s->D[2];
+    *o_lo = s->D[1] ^ s->D[0];
+}
+
+/* Initialises the stream cypher of each lane with its control word and the
+ * 8 bytes at pkt + i_hdr, then xors the key stream over its data */
+static void csa_BsStreamCypher( const csa_lane_t *p_lanes, int i_lanes )
+{
+    csa_bs_t s;
+    csa_word_t sb[8][8];
+    csa_word_t hi, lo;
+    int i_data = 0;
+
+    memset( &s, 0, sizeof(s) );
+    memset( sb, 0, sizeof(sb) );
+    s.A = &s.a[CSA_BS_SHIFTS];
+    s.B = &s.b[CSA_BS_SHIFTS];
+
+    for( int l = 0; l < i_lanes; l++ )
+    {
+        const uint8_t *ck = p_lanes[l].ck;
+        const uint8_t *p_init = &p_lanes[l].pkt[p_lanes[l].i_hdr];
+
+        /* first 32 bits of CK into A[1]..A[8], last 32 bits into B[1]..B[8] */
+        for( int i = 0; i < 4; i++ )
+            for( int k = 0; k < 4; k++ )
+            {
+                csa_BsSet( &s.A[1+2*i+0][k], l, ( ck[i] >> (4+k) )&1 );
+                csa_BsSet( &s.A[1+2*i+1][k], l, ( ck[i] >> k )&1 );
+                csa_BsSet( &s.B[1+2*i+0][k], l, ( ck[4+i] >> (4+k) )&1 );
+                csa_BsSet( &s.B[1+2*i+1][k], l, ( ck[4+i] >> k )&1 );
+            }
+
+        for( int i = 0; i < 8; i++ )
+            for( int k = 0; k < 8; k++ )
+                csa_BsSet( &sb[i][k], l, ( p_init[i] >> k )&1 );
+
+        i_data = __MAX( i_data, p_lanes[l].i_data );
+    }
+
+    for( int i = 0; i < 8; i++ )
+    {
+        const csa_word_t *in1 = &sb[i][4];
+        const csa_word_t *in2 = &sb[i][0];
+        for( int j = 0; j < 4; j++ )
+            csa_BsStep( &s, (j % 2) ? in2 : in1, (j % 2) ? in1 : in2, &hi, &lo );
+    }
+
+    for( int i_pos = 0; i_pos < i_data; i_pos += 8 )
+    {
+        csa_word_t stream[8][8];
+
+        for( int i = 0; i < 8; i++ )
+            for( int j = 0; j < 4; j++ )
+                csa_BsStep( &s, NULL, NULL, &stream[i][7-2*j], &stream[i][6-2*j] );
+
+        for( int l = 0; l < i_lanes; l++ )
+        {
+            const int i_count = __MIN( 8, p_lanes[l].i_data - i_pos );
+            for( int i = 0; i < i_count; i++ )
+            {
+                unsigned op = 0;
+                for( int k = 0; k < 8; k++ )
+                    op |= csa_BsGet( &stream[i][k], l ) << k;
+                p_lanes[l].p_data[i_pos + i] ^= op;
+            }
+        }
+    }
+}
+
+static void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
+{
+    csa_lane_t lanes[CSA_LANES];
+    int i_lanes = 0;
+
+    for( int i = 0; i < i_pkts; i++ )
+        if( pp_pkts[i][3]&0x80 )
+            i_lanes++;
+    if( i_lanes < CSA_BATCH_MIN )
+    {
+        for( int i = 0; i < i_pkts; i++ )
+            csa_Decrypt( c, pp_pkts[i], i_pkt_size );
+        return;
+    }
+
+    i_lanes = 0;
+    for( int i = 0; i < i_pkts; i++ )
+    {
+        uint8_t *pkt = pp_pkts[i];
+        csa_lane_t *p_lane = &lanes[i_lanes];
+
+        /* transport scrambling control */
+        if( (pkt[3]&0x80) == 0 )
+            continue;
+        if( pkt[3]&0x40 )
+        {
+            p_lane->ck = c->o_ck;
+            p_lane->kk = c->o_kk;
+        }
+        else
+        {
+            p_lane->ck = c->e_ck;
+            p_lane->kk = c->e_kk;
+        }
+        pkt[3] &= 0x3f;
+
+        int i_hdr = 4;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+        if( 188 - i_hdr < 8 )
+            continue;
+
+        const int n = (i_pkt_size - i_hdr) / 8;
+        const int i_residue = (i_pkt_size - i_hdr) % 8;
+        if( n < 0 || ( n == 0 && i_residue <= 0 ) )
+            continue;
+
+        p_lane->pkt = pkt;
+        p_lane->i_hdr = i_hdr;
+        p_lane->n = n;
+        p_lane->p_data = &pkt[n > 0 ? i_hdr + 8 : i_hdr];
+        p_lane->i_data = &pkt[i_pkt_size] - p_lane->p_data;
+        i_lanes++;
+    }
+
+    /* xor the key stream first, the chaining reads the result */
+    csa_BsStreamCypher( lanes, i_lanes );
+
+    for( int l = 0; l < i_lanes; l++ )
+    {
+        uint8_t *p = &lanes[l].pkt[lanes[l].i_hdr];
+        const int n = lanes[l].n;
+        uint8_t ib[8], block[8];
+
+        memcpy( ib, p, 8 );
+        for( int i = 1; i < n + 1; i++ )
+        {
+            csa_BlockDecypher( lanes[l].kk, ib, block );
+            if( i != n )
+                memcpy( ib, &p[8*i], 8 );
+            else
+                memset( ib, 0, 8 );
+            for( int j = 0; j < 8; j++ )
+                p[8*(i-1)+j] = ib[j] ^ block[j];
+        }
+    }
+}
+
+static void csa_EncryptBatch( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
+{
+    csa_lane_t lanes[CSA_LANES];
+    int i_lanes = 0;
+
+    if( i_pkts < CSA_BATCH_MIN )
+    {
+        for( int i = 0; i < i_pkts; i++ )
+            csa_Encrypt( c, pp_pkts[i], i_pkt_size );
+        return;
+    }
+
+    for( int i = 0; i < i_pkts; i++ )
+    {
+        uint8_t *pkt = pp_pkts[i];
+        csa_lane_t *p_lane = &lanes[i_lanes];
+
+        /* set transport scrambling control */
+        pkt[3] |= 0x80;
+        if( c->use_odd )
+        {
+            pkt[3] |= 0x40;
+            p_lane->ck = c->o_ck;
+            p_lane->kk = c->o_kk;
+        }
+        else
+        {
+            p_lane->ck = c->e_ck;
+            p_lane->kk = c->e_kk;
+        }
+
+        int i_hdr = 4;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+
+        const int n = (i_pkt_size - i_hdr) / 8;
+        if( n <= 0 )
+        {
+            pkt[3] &= 0x3f;
+            continue;
+        }
+
+        /* chain backwards, the stream cypher is initialised with the result */
+        uint8_t *p = &pkt[i_hdr];
+        uint8_t ib[8], block[8];
+        memset( ib, 0, 8 );
+        for( int i = n; i > 0; i-- )
+        {
+            for( int j = 0; j < 8; j++ )
+                block[j] = p[8*(i-1)+j] ^ ib[j];
+            csa_BlockCypher( p_lane->kk, block, ib );
+            memcpy( &p[8*(i-1)], ib, 8 );
+        }
+
+        p_lane->pkt = pkt;
+        p_lane->i_hdr = i_hdr;
+        p_lane->n = n;
+        p_lane->p_data = &p[8];
+        p_lane->i_data = &pkt[i_pkt_size] - p_lane->p_data;
+        i_lanes++;
+    }
+
+    csa_BsStreamCypher( lanes, i_lanes );
+}
+
+/*****************************************************************************
+ * csa_DecryptPackets:
+ *****************************************************************************/
+void csa_DecryptPackets( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
+{
+    while( i_pkts > 0 )
+    {
+        const int i_batch = __MIN( i_pkts, CSA_LANES );
+        csa_DecryptBatch( c, pp_pkts, i_batch, i_pkt_size );
+        pp_pkts += i_batch;
+        i_pkts -= i_batch;
+    }
+}
+
+/*****************************************************************************
+ * csa_EncryptPackets:
+ *****************************************************************************/
+void csa_EncryptPackets( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
+{
+    while( i_pkts > 0 )
+    {
+        const int i_batch = __MIN( i_pkts, CSA_LANES );
+        csa_EncryptBatch( c, pp_pkts, i_batch, i_pkt_size );
+        pp_pkts += i_batch;
+        i_pkts -= i_batch;
+    }
+}
@@ -180,6 +180,7 @@ static void    Close  ( vlc_object_t * );
 #define SOUT_CFG_PREFIX "sout-ts-"
 #define MAX_PMT 64       /* Maximum number of programs. FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #define MAX_PMT_PID 64       /* Maximum pids in each pmt.  FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
+#define SCRAMBLE_BATCH 256   /* Maximum packets scrambled at once */
 #if MAX_SDT_DESC < MAX_PMT
   #error "MAX_SDT_DESC < MAX_PMT"
 #endif
@@ -332,6 +333,9 @@ struct sout_mux_sys_t
 
     vlc_mutex_t     csa_lock;
 
+    block_pool_t    *p_pool;          /* TS packets and output blocks */
+    unsigned        i_block_packets;  /* TS packets per output block */
+
     dvbpsi_t        *p_dvbpsi;
     bool            b_es_id_pid;
     bool            b_sdt;
@@ -544,6 +548,18 @@ static int Open( vlc_object_t *p_this )
     }
     p_sys->p_dvbpsi->p_sys = (void *) p_mux;
 
+    /* Output as many packets at once as fit in a datagram */
+    p_sys->i_block_packets = var_InheritInteger( p_mux, "mtu" ) / 188;
+    if( p_sys->i_block_packets < 1 )
+        p_sys->i_block_packets = 1;
+    p_sys->p_pool = block_PoolNew( p_sys->i_block_packets * 188 );
+    if( !p_sys->p_pool )
+    {
+        dvbpsi_delete( p_sys->p_dvbpsi );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+
     p_sys->b_es_id_pid = var_GetBool( p_mux, SOUT_CFG_PREFIX "es-id-pid" );
 
     /*
@@ -752,6 +768,8 @@ static void Close( vlc_object_t * p_this )
         vlc_mutex_destroy( &p_sys->csa_lock );
     }
 
+    block_PoolRelease( p_sys->p_pool );
+
     for (int i = 0; i < MAX_SDT_DESC; i++ )
     {
         free( p_sys->sdt.desc[i].psz_service_name );
@@ -1598,7 +1616,6 @@ static int Mux( sout_mux_t *p_mux )
 #define STD_PES_PAYLOAD 170
 static block_t *FixPES( sout_mux_t *p_mux, block_fifo_t *p_fifo )
 {
-    VLC_UNUSED(p_mux);
     block_t *p_data;
     size_t i_size;
 
@@ -1611,7 +1628,8 @@ static block_t *FixPES( sout_mux_t *p_mux, block_fifo_t *p_fifo )
     }
     else if( i_size > STD_PES_PAYLOAD )
     {
-        block_t *p_new = block_Alloc( STD_PES_PAYLOAD );
+        block_t *p_new = block_PoolAlloc( p_mux->p_sys->p_pool,
+                                          STD_PES_PAYLOAD );
         memcpy( p_new->p_buffer, p_data->p_buffer, STD_PES_PAYLOAD );
         p_new->i_pts = p_data->i_pts;
         p_new->i_dts = p_data->i_dts;
@@ -1781,37 +1799,94 @@ static void TSDate( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
     }
 
     /* msg_Dbg( p_mux, "real pck=%d", i_packet_count ); */
-    for (int i = 0; i < i_packet_count; i++ )
-    {
-        block_t *p_ts = BufferChainGet( p_chain_ts );
-        mtime_t i_new_dts = i_pcr_dts + i_pcr_length * i / i_packet_count;
+    const size_t i_block_size = p_sys->i_block_packets * 188;
+    block_t *p_out = NULL;
 
-        p_ts->i_dts    = i_new_dts;
-        p_ts->i_length = i_pcr_length / i_packet_count;
+    for (int i = 0; i < i_packet_count; )
+    {
+        block_t *pp_ts[SCRAMBLE_BATCH];
+        uint8_t *pp_scrambled[SCRAMBLE_BATCH];
+        const int i_batch = __MIN( i_packet_count - i, SCRAMBLE_BATCH );
+        int i_scrambled = 0;
 
-        if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
+        for( int j = 0; j < i_batch; j++, i++ )
         {
-            /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
-            TSSetPCR( p_ts, p_ts->i_dts - p_sys->i_dts_delay - p_sys->first_dts );
+            block_t *p_ts = BufferChainGet( p_chain_ts );
+            mtime_t i_new_dts = i_pcr_dts + i_pcr_length * i / i_packet_count;
+
+            p_ts->i_dts    = i_new_dts;
+            p_ts->i_length = i_pcr_length / i_packet_count;
+
+            if( p_ts->i_flags & BLOCK_FLAG_CLOCK )
+            {
+                /* msg_Dbg( p_mux, "pcr=%lld ms", p_ts->i_dts / 1000 ); */
+                TSSetPCR( p_ts, p_ts->i_dts - p_sys->i_dts_delay - p_sys->first_dts );
+            }
+            if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+                pp_scrambled[i_scrambled++] = p_ts->p_buffer;
+
+            pp_ts[j] = p_ts;
         }
-        if( p_ts->i_flags & BLOCK_FLAG_SCRAMBLED )
+
+        /* Scrambling is much cheaper on many packets at once */
+        if( i_scrambled > 0 )
         {
             vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Encrypt( p_sys->csa, p_ts->p_buffer, p_sys->i_csa_pkt_size );
+            csa_EncryptPackets( p_sys->csa, pp_scrambled, i_scrambled,
+                                p_sys->i_csa_pkt_size );
             vlc_mutex_unlock( &p_sys->csa_lock );
         }
 
-        /* latency */
-        p_ts->i_dts += p_sys->i_shaping_delay * 3 / 2;
+        /* Pack the packets in output blocks. Headers and key frames start
+         * a new block, so that access outputs can still split on them. */
+        for( int j = 0; j < i_batch; j++ )
+        {
+            block_t *p_ts = pp_ts[j];
+
+            if( p_out != NULL &&
+                ( ( p_ts->i_flags & BLOCK_FLAG_TYPE_I ) ||
+                  ( ( p_ts->i_flags ^ p_out->i_flags ) & BLOCK_FLAG_HEADER ) ) )
+            {
+                sout_AccessOutWrite( p_mux->p_access, p_out );
+                p_out = NULL;
+            }
+
+            if( p_out == NULL )
+            {
+                p_out = block_PoolAlloc( p_sys->p_pool, i_block_size );
+                if( unlikely(p_out == NULL) )
+                {
+                    block_Release( p_ts );
+                    continue;
+                }
+                p_out->i_buffer = 0;
+                p_out->i_flags  = p_ts->i_flags & BLOCK_FLAG_HEADER;
+                /* latency */
+                p_out->i_dts    = p_ts->i_dts + p_sys->i_shaping_delay * 3 / 2;
+                p_out->i_length = 0;
+            }
+
+            memcpy( &p_out->p_buffer[p_out->i_buffer], p_ts->p_buffer, 188 );
+            p_out->i_buffer += 188;
+            p_out->i_length += p_ts->i_length;
+            p_out->i_flags  |= p_ts->i_flags & (BLOCK_FLAG_CLOCK|BLOCK_FLAG_TYPE_I);
+            block_Release( p_ts );
 
-        sout_AccessOutWrite( p_mux->p_access, p_ts );
+            if( p_out->i_buffer >= i_block_size )
+            {
+                sout_AccessOutWrite( p_mux->p_access, p_out );
+                p_out = NULL;
+            }
+        }
     }
+
+    if( p_out != NULL )
+        sout_AccessOutWrite( p_mux->p_access, p_out );
 }
 
 static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
                        bool b_pcr )
 {
-    VLC_UNUSED(p_mux);
     block_t *p_pes = p_stream->state.chain_pes.p_first;
 
     bool b_new_pes = false;
@@ -1831,7 +1906,7 @@ static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream,
         b_adaptation_field = true;
     }
 
-    block_t *p_ts = block_Alloc( 188 );
+    block_t *p_ts = block_PoolAlloc( p_mux->p_sys->p_pool, 188 );
 
     if (b_new_pes && !(p_pes->i_flags & BLOCK_FLAG_NO_KEYFRAME) && p_pes->i_flags & BLOCK_FLAG_TYPE_I)
     {
@@ -34,6 +34,7 @@
 
 static bool SkipID3Tag( demux_t * );
 static bool SkipAPETag( demux_t *p_demux );
+static module_t *ProbeHinted( demux_t *, const char *psz_ext_module );
 
 /* Decode URL (which has had its scheme stripped earlier) to a file path. */
 /* XXX: evil code duplication from access.c */
@@ -179,9 +180,13 @@ demux_t *demux_New( vlc_object_t *p_obj, input_thread_t *p_parent_input,
           ;
         SkipAPETag( p_demux );
 
-        p_demux->p_module =
-            module_need( p_demux, "demux", psz_module,
-                         !strcmp( psz_module, p_demux->psz_demux ) );
+        if( !strcmp( p_demux->psz_demux, "any" )
+         && var_InheritBool( p_obj, "demux-probe-cache" ) )
+            p_demux->p_module = ProbeHinted( p_demux, psz_module );
+        else
+            p_demux->p_module =
+                module_need( p_demux, "demux", psz_module,
+                             !strcmp( psz_module, p_demux->psz_demux ) );
     }
     else
     {
@@ -202,6 +207,63 @@ error:
     return NULL;
 }
 
+/*****************************************************************************
+ * ProbeHinted: tries the cached and signature matched demuxers first
+ *****************************************************************************/
+#define PROBE_HINT_SIZE 4096
+
+static module_t *ProbeHinted( demux_t *p_demux, const char *psz_ext_module )
+{
+    const uint8_t *p_peek;
+    int i_peek = stream_Peek( p_demux->s, &p_peek, PROBE_HINT_SIZE );
+    if( i_peek <= 0 )
+        return module_need( p_demux, "demux", psz_ext_module,
+                            !strcmp( psz_ext_module, "any" ) );
+
+    const char *psz_ext = p_demux->psz_file != NULL
+                        ? strrchr( p_demux->psz_file, '.' ) : NULL;
+    char *psz_mime = stream_ContentType( p_demux->s );
+    uint64_t i_key = demux_ProbeKey( p_peek, i_peek, psz_ext, psz_mime );
+    free( psz_mime );
+
+    /* The candidates are only tried first: each one still probes the stream
+     * and the other demuxers follow, as with the extension table. */
+    const char *hints[3] = {
+        NULL, demux_ProbeMagic( p_peek, i_peek ), psz_ext_module
+    };
+    char *psz_cached = demux_ProbeCacheGet( VLC_OBJECT(p_demux), i_key );
+    hints[0] = psz_cached;
+
+    char psz_list[3 * 32];
+    size_t i_list = 0;
+    for( unsigned i = 0; i < ARRAY_SIZE(hints); i++ )
+    {
+        if( hints[i] == NULL || !strcmp( hints[i], "any" ) )
+            continue;
+        for( unsigned j = 0; j < i; j++ )
+            if( hints[j] != NULL && !strcmp( hints[i], hints[j] ) )
+                goto next;
+        i_list += snprintf( &psz_list[i_list], sizeof(psz_list) - i_list,
+                            "%s%s", i_list ? "," : "", hints[i] );
+next:   ;
+    }
+    free( psz_cached );
+
+    module_t *p_module;
+    if( i_list > 0 )
+    {
+        msg_Dbg( p_demux, "demux probing hints: %s", psz_list );
+        p_module = module_need( p_demux, "demux", psz_list, false );
+    }
+    else
+        p_module = module_need( p_demux, "demux", "any", true );
+
+    if( p_module != NULL )
+        demux_ProbeCachePut( VLC_OBJECT(p_demux), i_key,
+                             module_get_object( p_module ) );
+    return p_module;
+}
+
 /*****************************************************************************
  * demux_Delete:
  *****************************************************************************/
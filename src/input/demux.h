@@ -36,6 +36,12 @@ demux_t *demux_New( vlc_object_t *p_obj, input_thread_t *p_parent_input, const c
 
 void demux_Delete( demux_t * );
 
+/* Probing hints (demux_probe.c) */
+const char *demux_ProbeMagic( const uint8_t *, size_t );
+uint64_t demux_ProbeKey( const uint8_t *, size_t, const char *psz_ext, const char *psz_mime );
+char *demux_ProbeCacheGet( vlc_object_t *, uint64_t i_key );
+void demux_ProbeCachePut( vlc_object_t *, uint64_t i_key, const char *psz_demux );
+
 static inline int demux_Demux( demux_t *p_demux )
 {
     if( !p_demux->pf_demux )
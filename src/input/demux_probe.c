@@ -0,0 +1,333 @@
+/*****************************************************************************
+ * demux_probe.c: demux module probing hints
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "demux.h"
+#include <vlc_fs.h>
+#include <vlc_configuration.h>
+
+/*****************************************************************************
+ * Signatures
+ *****************************************************************************/
+/* NOTE: only formats that cannot be mistaken for another one belong here;
+ * the demuxer still probes the stream itself. RIFF and FORM containers are
+ * matched by their form type. */
+static const struct
+{
+    uint8_t i_offset;
+    uint8_t i_size;
+    char    magic[14];
+    char    demux[6];
+} magictodemux[] =
+{
+    { 0, 4, "\x1A\x45\xDF\xA3", "mkv" },
+    { 0, 4, "OggS", "ogg" },
+    { 0, 4, "fLaC", "flac" },
+    { 8, 4, "AVI ", "avi" },
+    { 0, 8, "\x30\x26\xB2\x75\x8E\x66\xCF\x11", "asf" },
+    { 4, 4, "ftyp", "mp4" },
+    { 4, 4, "moov", "mp4" },
+    { 8, 4, "AIFF", "aiff" },
+    { 0, 4, ".snd", "au" },
+    { 0, 4, "MThd", "smf" },
+    { 0, 4, "NSVf", "nsv" },
+    { 0, 4, "NSVs", "nsv" },
+    { 0, 7, "#EXTM3U", "m3u" },
+    { 0, 13, "Creative Voic", "voc" },
+};
+
+/**
+ * Returns the demux shortcut matching the stream start, or NULL.
+ */
+const char *demux_ProbeMagic( const uint8_t *p_peek, size_t i_peek )
+{
+    for( size_t i = 0; i < ARRAY_SIZE(magictodemux); i++ )
+    {
+        size_t i_end = magictodemux[i].i_offset + magictodemux[i].i_size;
+
+        if( i_peek >= i_end
+         && !memcmp( &p_peek[magictodemux[i].i_offset], magictodemux[i].magic,
+                     magictodemux[i].i_size ) )
+            return magictodemux[i].demux;
+    }
+
+    if( i_peek >= 3 * 188 && p_peek[0] == 0x47 && p_peek[188] == 0x47
+     && p_peek[2 * 188] == 0x47 )
+        return "ts";
+    return NULL;
+}
+
+/*****************************************************************************
+ * Probe cache
+ *****************************************************************************
+ * Remembers which demux opened a given stream start, extension and MIME type.
+ * Entries are appended to a file in the user cache directory, the file being
+ * rewritten once it holds too many stale records.
+ *****************************************************************************/
+#define PROBE_CACHE_NAME "demux-probe.dat"
+#define PROBE_CACHE_MAGIC "VLCprobe"
+#define PROBE_CACHE_SIZE 1024
+#define PROBE_CACHE_FILE_MAX (4 * PROBE_CACHE_SIZE)
+
+typedef struct
+{
+    uint64_t i_key;
+    char     psz_demux[24];
+} probe_entry_t;
+
+static vlc_mutex_t probe_lock = VLC_STATIC_MUTEX;
+static probe_entry_t probe_cache[PROBE_CACHE_SIZE];
+static unsigned probe_count; /* valid entries */
+static unsigned probe_next;  /* next entry to replace */
+static unsigned probe_records; /* records in the file */
+static bool probe_loaded;
+
+static uint64_t Fnv1a( uint64_t i_hash, const void *p_data, size_t i_data )
+{
+    const uint8_t *p = p_data;
+
+    for( size_t i = 0; i < i_data; i++ )
+    {
+        i_hash ^= p[i];
+        i_hash *= UINT64_C(0x100000001b3);
+    }
+    return i_hash;
+}
+
+/**
+ * Computes the cache key of a stream from its first bytes,
+ * its file extension and its content type.
+ */
+uint64_t demux_ProbeKey( const uint8_t *p_peek, size_t i_peek,
+                         const char *psz_ext, const char *psz_mime )
+{
+    uint64_t i_hash = UINT64_C(0xcbf29ce484222325);
+
+    /* Keep the terminating nul so that fields cannot run into each other */
+    if( psz_ext != NULL )
+        i_hash = Fnv1a( i_hash, psz_ext, strlen( psz_ext ) + 1 );
+    i_hash = Fnv1a( i_hash, "", 1 );
+    if( psz_mime != NULL )
+        i_hash = Fnv1a( i_hash, psz_mime, strlen( psz_mime ) + 1 );
+    i_hash = Fnv1a( i_hash, "", 1 );
+    return Fnv1a( i_hash, p_peek, i_peek );
+}
+
+static char *ProbeCachePath( void )
+{
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path;
+
+    if( psz_dir == NULL )
+        return NULL;
+    if( asprintf( &psz_path, "%s"DIR_SEP PROBE_CACHE_NAME, psz_dir ) == -1 )
+        psz_path = NULL;
+    free( psz_dir );
+    return psz_path;
+}
+
+static probe_entry_t *ProbeCacheFind( uint64_t i_key )
+{
+    for( unsigned i = 0; i < probe_count; i++ )
+        if( probe_cache[i].i_key == i_key )
+            return &probe_cache[i];
+    return NULL;
+}
+
+static void ProbeCacheInsert( const probe_entry_t *p_entry )
+{
+    probe_entry_t *p_old = ProbeCacheFind( p_entry->i_key );
+
+    if( p_old == NULL )
+    {
+        p_old = &probe_cache[probe_next];
+        probe_next = (probe_next + 1) % PROBE_CACHE_SIZE;
+        if( probe_count < PROBE_CACHE_SIZE )
+            probe_count++;
+    }
+    *p_old = *p_entry;
+}
+
+/* Rewrites the file with the entries in memory, oldest first */
+static void ProbeCacheCompact( vlc_object_t *p_obj, const char *psz_path )
+{
+    char *psz_tmp;
+
+    if( asprintf( &psz_tmp, "%s.%"PRIu32, psz_path, (uint32_t)getpid() ) == -1 )
+        return;
+
+    FILE *file = vlc_fopen( psz_tmp, "wb" );
+    if( file == NULL )
+    {
+        free( psz_tmp );
+        return;
+    }
+
+    unsigned i_first = probe_count < PROBE_CACHE_SIZE ? 0 : probe_next;
+    bool b_error = fwrite( PROBE_CACHE_MAGIC, 8, 1, file ) != 1;
+
+    for( unsigned i = 0; i < probe_count && !b_error; i++ )
+        b_error = fwrite( &probe_cache[(i_first + i) % PROBE_CACHE_SIZE],
+                          sizeof(probe_entry_t), 1, file ) != 1;
+
+    if( fclose( file ) || b_error )
+    {
+        msg_Warn( p_obj, "cannot write %s: %s", psz_tmp,
+                  vlc_strerror_c(errno) );
+        vlc_unlink( psz_tmp );
+    }
+    else
+    {
+#if defined( _WIN32 ) || defined( __OS2__ )
+        vlc_unlink( psz_path );
+#endif
+        if( vlc_rename( psz_tmp, psz_path ) == 0 )
+            probe_records = probe_count;
+        else
+            vlc_unlink( psz_tmp );
+    }
+    free( psz_tmp );
+}
+
+static void ProbeCacheLoad( vlc_object_t *p_obj )
+{
+    probe_loaded = true;
+
+    char *psz_path = ProbeCachePath();
+    if( psz_path == NULL )
+        return;
+
+    FILE *file = vlc_fopen( psz_path, "rb" );
+    if( file == NULL )
+    {
+        free( psz_path );
+        return;
+    }
+
+    char magic[8];
+    probe_entry_t entry;
+
+    if( fread( magic, sizeof(magic), 1, file ) == 1
+     && !memcmp( magic, PROBE_CACHE_MAGIC, sizeof(magic) ) )
+    {
+        while( fread( &entry, sizeof(entry), 1, file ) == 1 )
+        {
+            probe_records++;
+            if( memchr( entry.psz_demux, '\0', sizeof(entry.psz_demux) ) )
+                ProbeCacheInsert( &entry );
+        }
+    }
+    else
+        probe_records = PROBE_CACHE_FILE_MAX; /* foreign file: rewrite */
+    fclose( file );
+
+    msg_Dbg( p_obj, "loaded %u demux probe results from %s",
+             probe_count, psz_path );
+    if( probe_records >= PROBE_CACHE_FILE_MAX )
+        ProbeCacheCompact( p_obj, psz_path );
+    free( psz_path );
+}
+
+/**
+ * Looks up the demux that last opened a stream with the given key.
+ * \return a heap-allocated shortcut or NULL if unknown
+ */
+char *demux_ProbeCacheGet( vlc_object_t *p_obj, uint64_t i_key )
+{
+    char *psz_demux = NULL;
+
+    vlc_mutex_lock( &probe_lock );
+    if( !probe_loaded )
+        ProbeCacheLoad( p_obj );
+
+    const probe_entry_t *p_entry = ProbeCacheFind( i_key );
+    if( p_entry != NULL )
+        psz_demux = strdup( p_entry->psz_demux );
+    vlc_mutex_unlock( &probe_lock );
+    return psz_demux;
+}
+
+/**
+ * Records the demux that opened a stream with the given key.
+ */
+void demux_ProbeCachePut( vlc_object_t *p_obj, uint64_t i_key,
+                          const char *psz_demux )
+{
+    probe_entry_t entry;
+
+    if( strlen( psz_demux ) >= sizeof(entry.psz_demux) )
+        return;
+
+    memset( &entry, 0, sizeof(entry) );
+    entry.i_key = i_key;
+    strcpy( entry.psz_demux, psz_demux );
+
+    vlc_mutex_lock( &probe_lock );
+    if( !probe_loaded )
+        ProbeCacheLoad( p_obj );
+
+    const probe_entry_t *p_old = ProbeCacheFind( i_key );
+    if( p_old != NULL && !strcmp( p_old->psz_demux, psz_demux ) )
+        goto out;
+    ProbeCacheInsert( &entry );
+
+    char *psz_path = ProbeCachePath();
+    if( psz_path == NULL )
+        goto out;
+
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_dir != NULL )
+    {
+        vlc_mkdir( psz_dir, 0700 );
+        free( psz_dir );
+    }
+
+    if( probe_records + 1 >= PROBE_CACHE_FILE_MAX )
+    {
+        ProbeCacheCompact( p_obj, psz_path );
+        free( psz_path );
+        goto out;
+    }
+
+    FILE *file = vlc_fopen( psz_path, "ab" );
+    if( file != NULL )
+    {
+        bool b_ok = !fseek( file, 0, SEEK_END );
+
+        if( b_ok && ftell( file ) == 0 )
+            b_ok = fwrite( PROBE_CACHE_MAGIC, 8, 1, file ) == 1;
+        if( b_ok && fwrite( &entry, sizeof(entry), 1, file ) == 1 )
+            probe_records++;
+        fclose( file );
+    }
+    else if( errno != EACCES && errno != ENOENT )
+        msg_Warn( p_obj, "cannot open %s: %s", psz_path,
+                  vlc_strerror_c(errno) );
+    free( psz_path );
+out:
+    vlc_mutex_unlock( &probe_lock );
+}
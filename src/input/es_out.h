@@ -66,11 +66,15 @@ enum es_out_query_private_e
     ES_OUT_SET_RATE,                                /* arg1=int i_source_rate arg2=int i_rate                  res=can fail */
 
     /* Set a new time */
-    ES_OUT_SET_TIME,                                /* arg1=mtime_t             res=can fail */
+    ES_OUT_SET_TIME,                                /* arg1=mtime_t (-1 to reset, or a time to seek the timeshift to) res=can fail */
 
     /* Set next frame */
     ES_OUT_SET_FRAME_NEXT,                          /*                          res=can fail */
 
+    /* Forget the timeshift window before the last ES_OUT_SET_TIME(-1), the
+     * input seeked since */
+    ES_OUT_RESET_WINDOW,                            /*                          res=cannot fail */
+
     /* Set position/time/length */
     ES_OUT_SET_TIMES,                               /* arg1=double f_position arg2=mtime_t i_time arg3=mtime_t i_length res=cannot fail */
 
@@ -138,6 +142,11 @@ static inline int es_out_SetFrameNext( es_out_t *p_out )
 {
     return es_out_Control( p_out, ES_OUT_SET_FRAME_NEXT );
 }
+static inline void es_out_ResetWindow( es_out_t *p_out )
+{
+    int i_ret = es_out_Control( p_out, ES_OUT_RESET_WINDOW );
+    assert( !i_ret );
+}
 static inline void es_out_SetTimes( es_out_t *p_out, double f_position, mtime_t i_time, mtime_t i_length )
 {
     int i_ret = es_out_Control( p_out, ES_OUT_SET_TIMES, f_position, i_time, i_length );
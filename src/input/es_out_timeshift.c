@@ -36,6 +36,9 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_MMAP
+#  include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -66,6 +69,7 @@ enum
     C_SEND,
     C_DEL,
     C_CONTROL,
+    C_PLAYED, /* Executed command kept in the storage, not to be replayed */
 };
 
 typedef struct attribute_packed
@@ -150,6 +154,31 @@ typedef struct attribute_packed
     } u;
 } ts_cmd_t;
 
+/* Header of a block in the storage files, followed by its data */
+typedef struct
+{
+    int64_t  i_pts;
+    int64_t  i_dts;
+    int64_t  i_length;
+    uint32_t i_flags;
+    uint32_t i_nb_samples;
+    uint32_t i_buffer;
+} ts_record_t;
+
+#define TS_RECORD_ALIGN(x) ( ((x) + 7) & ~(size_t)7 )
+
+typedef struct
+{
+    mtime_t i_date;
+    mtime_t i_time; /* Last stream time pushed before the command, or -1 */
+    int     i_cmd;
+} ts_storage_index_t;
+
+/* Commands per storage */
+#define TS_STORAGE_CMD_MAX (30000)
+/* Minimal duration between two points of the storage time index */
+#define TS_STORAGE_INDEX_INTERVAL (CLOCK_FREQ)
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
@@ -159,14 +188,22 @@ struct ts_storage_t
     char    *psz_file;  /* Filename */
     size_t  i_file_max; /* Max size in bytes */
     int64_t i_file_size;/* Current size in bytes */
-    FILE    *p_filew;   /* FILE handle for data writing */
-    FILE    *p_filer;   /* FILE handle for data reading */
+    int     fd;
+#ifdef HAVE_MMAP
+    uint8_t *p_map;     /* The whole file, while it is read or written */
+#endif
 
     /* */
     int      i_cmd_r;
     int      i_cmd_w;
     int      i_cmd_max;
+    int      i_cmd_first; /* First command that can be replayed */
     ts_cmd_t *p_cmd;
+
+    /* Command dates, at most one per TS_STORAGE_INDEX_INTERVAL */
+    int                i_index;
+    int                i_index_max;
+    ts_storage_index_t *p_index;
 };
 
 typedef struct
@@ -176,6 +213,7 @@ typedef struct
     es_out_t       *p_out;
     int64_t        i_tmp_size_max;
     const char     *psz_tmp_path;
+    mtime_t        i_window;
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -194,12 +232,29 @@ typedef struct
     /* */
     mtime_t        i_buffering_delay;
 
-    /* */
+    /* Storages from p_storage_first to p_storage_r have already been
+     * played, and are kept to seek back within the window */
+    ts_storage_t   *p_storage_first;
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
+    ts_storage_t   *p_storage_spare; /* Emptied storage, to be reused */
+
+    /* Read point of the last flush, the stream before it is forgotten
+     * once the input seek that followed it succeeded */
+    ts_storage_t   *p_storage_flush;
+    int            i_cmd_flush;
 
     mtime_t        i_cmd_delay;
 
+    /* */
+    mtime_t        i_time_start;
+    mtime_t        i_time_end;
+    unsigned       i_seek;
+
+    /* The thread holds a popped command until it is executed */
+    bool           b_cmd_held;
+    vlc_cond_t     wait_cmd;
+
 } ts_thread_t;
 
 struct es_out_id_t
@@ -215,6 +270,7 @@ struct es_out_sys_t
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
     char           *psz_tmp_path;     /* Path for temporary files */
+    mtime_t        i_window;          /* Played duration kept for seeking */
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -244,25 +300,34 @@ static int          TsStart( es_out_t * );
 static void         TsAutoStop( es_out_t * );
 
 static void         TsStop( ts_thread_t * );
+static void         TsDropHistory( ts_thread_t * );
 static void         TsPushCmd( ts_thread_t *, ts_cmd_t * );
 static int          TsPopCmdLocked( ts_thread_t *, ts_cmd_t *, bool b_flush );
 static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
+static int          TsSeek( ts_thread_t *, mtime_t i_time );
+static int          TsFlush( ts_thread_t * );
+static void         TsResetWindow( ts_thread_t * );
 
 static void         *TsRun( void * );
 
 static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
 static void         TsStorageDelete( ts_storage_t * );
+static int          TsStorageReset( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
+static void         TsStorageUnmap( ts_storage_t *p_storage );
+static size_t       TsStorageCmdSize( const ts_cmd_t *p_cmd );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
+static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, mtime_t i_time );
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
 
 static void CmdClean( ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
+static bool CmdIsReplayable( const ts_cmd_t * );
+static void CmdExecute( es_out_t *, ts_cmd_t * );
 
 static int  CmdInitAdd    ( ts_cmd_t *, es_out_id_t *, const es_format_t *, bool b_copy );
 static void CmdInitSend   ( ts_cmd_t *, es_out_id_t *, block_t * );
@@ -282,7 +347,7 @@ static int  CmdExecuteControl( es_out_t *, ts_cmd_t * );
 
 /* File helpers */
 static char *GetTmpPath( char *psz_path );
-static FILE *GetTmpFile( char **ppsz_file, const char *psz_path );
+static int   GetTmpFile( char **ppsz_file, const char *psz_path );
 
 /*****************************************************************************
  * input_EsOutTimeshiftNew:
@@ -336,6 +401,17 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     msg_Dbg( p_input, "using timeshift granularity of %d MiB, in path '%s'",
              (int)p_sys->i_tmp_size_max/(1024*1024), p_sys->psz_tmp_path );
 
+    const int i_window = var_CreateGetInteger( p_input, "input-timeshift-window" );
+    p_sys->i_window = __MAX( i_window, 0 ) * CLOCK_FREQ;
+    if( p_sys->i_window > 0 )
+    {
+        /* Everything goes through the storage to be seekable */
+        var_Create( p_input, "timeshift-start", VLC_VAR_INTEGER );
+        var_Create( p_input, "timeshift-end", VLC_VAR_INTEGER );
+        msg_Dbg( p_input, "keeping %d s of played timeshift", i_window );
+        TsStart( p_out );
+    }
+
 #if 0
 #define S(t) msg_Err( p_input, "SIZEOF("#t")=%d", sizeof(t) )
     S(ts_cmd_t);
@@ -556,9 +632,21 @@ static int ControlLockedSetTime( es_out_t *p_out, mtime_t i_date )
 {
     es_out_sys_t *p_sys = p_out->p_sys;
 
+    /* A stream time seeks within the timeshift window */
+    if( i_date >= 0 )
+    {
+        if( !p_sys->b_delayed || p_sys->i_window <= 0 )
+            return VLC_EGENERIC;
+        return TsSeek( p_sys->p_ts, i_date );
+    }
+
     if( !p_sys->b_delayed )
         return es_out_SetTime( p_sys->p_out, i_date );
 
+    /* The window keeps the timeshift running across the input seeks */
+    if( p_sys->i_window > 0 )
+        return TsFlush( p_sys->p_ts );
+
     /* TODO */
     msg_Err( p_sys->p_input, "EsOutTimeshift does not yet support time change" );
     return VLC_EGENERIC;
@@ -672,6 +760,12 @@ static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
     {
         return ControlLockedSetFrameNext( p_out );
     }
+    case ES_OUT_RESET_WINDOW:
+    {
+        if( p_sys->b_delayed && p_sys->i_window > 0 )
+            TsResetWindow( p_sys->p_ts );
+        return VLC_SUCCESS;
+    }
     case ES_OUT_GET_PCR_SYSTEM:
     {
         if( p_sys->b_delayed )
@@ -725,6 +819,7 @@ static int Control( es_out_t *p_out, int i_query, va_list args )
  *****************************************************************************/
 static void TsDestroy( ts_thread_t *p_ts )
 {
+    vlc_cond_destroy( &p_ts->wait_cmd );
     vlc_cond_destroy( &p_ts->wait );
     vlc_mutex_destroy( &p_ts->lock );
     free( p_ts );
@@ -742,10 +837,12 @@ static int TsStart( es_out_t *p_out )
 
     p_ts->i_tmp_size_max = p_sys->i_tmp_size_max;
     p_ts->psz_tmp_path = p_sys->psz_tmp_path;
+    p_ts->i_window = p_sys->i_window;
     p_ts->p_input = p_sys->p_input;
     p_ts->p_out = p_sys->p_out;
     vlc_mutex_init( &p_ts->lock );
     vlc_cond_init( &p_ts->wait );
+    vlc_cond_init( &p_ts->wait_cmd );
     p_ts->b_paused = p_sys->b_input_paused && !p_sys->b_input_paused_source;
     p_ts->i_pause_date = p_ts->b_paused ? mdate() : -1;
     p_ts->i_rate_source = p_sys->i_input_rate_source;
@@ -754,8 +851,15 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_rate_delay = 0;
     p_ts->i_buffering_delay = 0;
     p_ts->i_cmd_delay = 0;
+    p_ts->p_storage_first = NULL;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->p_storage_spare = NULL;
+    p_ts->p_storage_flush = NULL;
+    p_ts->i_time_start = -1;
+    p_ts->i_time_end = -1;
+    p_ts->i_seek = 0;
+    p_ts->b_cmd_held = false;
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -797,9 +901,12 @@ static void TsStop( ts_thread_t *p_ts )
 
         CmdClean( &cmd );
     }
+    TsDropHistory( p_ts );
     assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
     if( p_ts->p_storage_r )
         TsStorageDelete( p_ts->p_storage_r );
+    if( p_ts->p_storage_spare )
+        TsStorageDelete( p_ts->p_storage_spare );
     vlc_mutex_unlock( &p_ts->lock );
 
     TsDestroy( p_ts );
@@ -810,7 +917,20 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        const size_t i_size = TsStorageCmdSize( p_cmd );
+        ts_storage_t *p_storage;
+
+        /* Go round the already mapped files when possible */
+        if( p_ts->p_storage_spare && p_ts->p_storage_spare->i_file_max >= i_size )
+        {
+            p_storage = p_ts->p_storage_spare;
+            p_ts->p_storage_spare = NULL;
+        }
+        else
+        {
+            p_storage = TsStorageNew( p_ts->psz_tmp_path,
+                                      __MAX( p_ts->i_tmp_size_max, (int64_t)i_size ) );
+        }
 
         if( !p_storage )
         {
@@ -822,42 +942,130 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
         if( !p_ts->p_storage_w )
         {
+            p_ts->p_storage_first = p_storage;
             p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
         }
         else
         {
             TsStoragePack( p_ts->p_storage_w );
+            if( p_ts->p_storage_w != p_ts->p_storage_r )
+                TsStorageUnmap( p_ts->p_storage_w );
             p_ts->p_storage_w->p_next = p_storage;
             p_ts->p_storage_w = p_storage;
         }
     }
 
+    if( p_cmd->i_type == C_CONTROL && p_cmd->u.control.i_query == ES_OUT_SET_TIMES &&
+        p_ts->i_window > 0 )
+    {
+        p_ts->i_time_end = p_cmd->u.control.u.times.i_time;
+        var_SetInteger( p_ts->p_input, "timeshift-end", p_ts->i_time_end );
+    }
+
     /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->i_time_end );
 
     vlc_cond_signal( &p_ts->wait );
 
     vlc_mutex_unlock( &p_ts->lock );
 }
-static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
+/* Releases a storage that will not be read anymore */
+static void TsReleaseStorage( ts_thread_t *p_ts, ts_storage_t *p_storage )
 {
-    vlc_assert_locked( &p_ts->lock );
-
-    if( TsStorageIsEmpty( p_ts->p_storage_r ) )
-        return VLC_EGENERIC;
+    if( p_ts->p_storage_flush == p_storage )
+        p_ts->p_storage_flush = NULL;
+    if( !p_ts->p_storage_spare && !TsStorageReset( p_storage ) )
+        p_ts->p_storage_spare = p_storage;
+    else
+        TsStorageDelete( p_storage );
+}
+/* Updates the start of the window from the oldest replayable command */
+static void TsUpdateWindow( ts_thread_t *p_ts )
+{
+    mtime_t i_start = -1;
 
-    TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+    for( ts_storage_t *p = p_ts->p_storage_first; p && i_start < 0; p = p->p_next )
+    {
+        for( int i = 0; i < p->i_index && i_start < 0; i++ )
+        {
+            if( p->p_index[i].i_cmd >= p->i_cmd_first )
+                i_start = p->p_index[i].i_time;
+        }
+    }
+    if( i_start != p_ts->i_time_start )
+    {
+        p_ts->i_time_start = i_start;
+        var_SetInteger( p_ts->p_input, "timeshift-start", i_start );
+    }
+}
+static void TsDropHistory( ts_thread_t *p_ts )
+{
+    while( p_ts->p_storage_first != p_ts->p_storage_r )
+    {
+        ts_storage_t *p_next = p_ts->p_storage_first->p_next;
+        TsReleaseStorage( p_ts, p_ts->p_storage_first );
+        p_ts->p_storage_first = p_next;
+    }
+}
+/* Forgets the played storages older than the window */
+static void TsTrimHistory( ts_thread_t *p_ts )
+{
+    const ts_storage_t *p_last = p_ts->p_storage_w;
+    if( !p_last || p_last->i_cmd_w <= 0 )
+        return;
+    const mtime_t i_limit = p_last->p_cmd[p_last->i_cmd_w - 1].i_date - p_ts->i_window;
 
-    while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
+    while( p_ts->p_storage_first != p_ts->p_storage_r )
     {
-        ts_storage_t *p_next = p_ts->p_storage_r->p_next;
-        if( !p_next )
+        ts_storage_t *p_first = p_ts->p_storage_first;
+        if( p_first->i_cmd_w > 0 && p_first->p_cmd[p_first->i_cmd_w - 1].i_date >= i_limit )
             break;
 
-        TsStorageDelete( p_ts->p_storage_r );
-        p_ts->p_storage_r = p_next;
+        p_ts->p_storage_first = p_first->p_next;
+        TsReleaseStorage( p_ts, p_first );
     }
+}
+static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    do
+    {
+        if( TsStorageIsEmpty( p_ts->p_storage_r ) )
+            return VLC_EGENERIC;
 
+        TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+
+        while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
+        {
+            ts_storage_t *p_next = p_ts->p_storage_r->p_next;
+            if( !p_next )
+                break;
+
+            if( p_ts->i_window <= 0 )
+            {
+                TsReleaseStorage( p_ts, p_ts->p_storage_r );
+                p_ts->p_storage_first = p_next;
+            }
+            else
+            {
+                TsStorageUnmap( p_ts->p_storage_r );
+            }
+            p_ts->p_storage_r = p_next;
+        }
+    } while( p_cmd->i_type == C_PLAYED );
+
+    if( p_ts->i_window > 0 )
+    {
+        /* The commands sent to a deleted es cannot be replayed */
+        if( p_cmd->i_type == C_DEL )
+        {
+            TsDropHistory( p_ts );
+            p_ts->p_storage_r->i_cmd_first = p_ts->p_storage_r->i_cmd_r;
+        }
+        TsTrimHistory( p_ts );
+        TsUpdateWindow( p_ts );
+    }
     return VLC_SUCCESS;
 }
 static bool TsHasCmd( ts_thread_t *p_ts )
@@ -865,7 +1073,7 @@ static bool TsHasCmd( ts_thread_t *p_ts )
     bool b_cmd;
 
     vlc_mutex_lock( &p_ts->lock );
-    b_cmd =  TsStorageIsEmpty( p_ts->p_storage_r );
+    b_cmd = !TsStorageIsEmpty( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
 
     return b_cmd;
@@ -875,7 +1083,8 @@ static bool TsIsUnused( ts_thread_t *p_ts )
     bool b_unused;
 
     vlc_mutex_lock( &p_ts->lock );
-    b_unused = !p_ts->b_paused &&
+    b_unused = p_ts->i_window <= 0 &&
+               !p_ts->b_paused &&
                p_ts->i_rate == p_ts->i_rate_source &&
                TsStorageIsEmpty( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
@@ -932,6 +1141,161 @@ static int TsChangeRate( ts_thread_t *p_ts, int i_src_rate, int i_rate )
     return i_ret;
 }
 
+/* Makes TsRun drop the wait for its popped command, and waits until that
+ * command is executed, so that it is not run after the following ones */
+static void TsInterruptLocked( ts_thread_t *p_ts )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    p_ts->i_seek++;
+    vlc_cond_broadcast( &p_ts->wait_cmd );
+
+    const int canc = vlc_savecancel();
+    while( p_ts->b_cmd_held )
+        vlc_cond_wait( &p_ts->wait_cmd, &p_ts->lock );
+    vlc_restorecancel( canc );
+}
+/* Executes the commands before the command i_cmd of p_target, or all of them
+ * when p_target is NULL, but drops the es data */
+static void TsSkipLocked( ts_thread_t *p_ts, const ts_storage_t *p_target, int i_cmd )
+{
+    const int canc = vlc_savecancel();
+    while( !p_target || p_ts->p_storage_r != p_target || p_target->i_cmd_r < i_cmd )
+    {
+        ts_cmd_t cmd;
+
+        if( TsPopCmdLocked( p_ts, &cmd, true ) )
+            break;
+        if( cmd.i_type == C_SEND )
+            CmdClean( &cmd );
+        else
+            CmdExecute( p_ts->p_out, &cmd );
+    }
+    vlc_restorecancel( canc );
+}
+
+/* Moves the reading point to the last indexed command before i_time.
+ * The skipped commands are executed, but the es data is dropped. */
+static int TsSeek( ts_thread_t *p_ts, mtime_t i_time )
+{
+    vlc_mutex_lock( &p_ts->lock );
+
+    ts_storage_t *p_target = NULL;
+    const ts_storage_index_t *p_point = NULL;
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+    {
+        for( int i = 0; i < p->i_index; i++ )
+        {
+            const ts_storage_index_t *p_idx = &p->p_index[i];
+            if( p_idx->i_time < 0 || p_idx->i_cmd < p->i_cmd_first )
+                continue;
+            /* Before the window start, use the first point */
+            if( p_point && p_idx->i_time > i_time )
+                goto found;
+            p_target = p;
+            p_point = p_idx;
+        }
+    }
+found:
+    if( !p_point )
+    {
+        vlc_mutex_unlock( &p_ts->lock );
+        return VLC_EGENERIC;
+    }
+
+    bool b_backward = false;
+    for( ts_storage_t *p = p_ts->p_storage_first; p != p_ts->p_storage_r; p = p->p_next )
+    {
+        if( p == p_target )
+            b_backward = true;
+    }
+    if( p_target == p_ts->p_storage_r )
+        b_backward = p_point->i_cmd < p_target->i_cmd_r;
+
+    TsInterruptLocked( p_ts );
+
+    if( b_backward )
+    {
+        /* Played commands that cannot be replayed are marked C_PLAYED */
+        for( ts_storage_t *p = p_target; p != p_ts->p_storage_r; p = p->p_next )
+            p->i_cmd_r = 0;
+        p_ts->p_storage_r->i_cmd_r = 0;
+        p_target->i_cmd_r = p_point->i_cmd;
+        if( p_ts->p_storage_r != p_ts->p_storage_w && p_ts->p_storage_r != p_target )
+            TsStorageUnmap( p_ts->p_storage_r );
+        p_ts->p_storage_r = p_target;
+    }
+    else
+    {
+        TsSkipLocked( p_ts, p_target, p_point->i_cmd );
+    }
+
+    /* Restart from now on */
+    const mtime_t i_date = p_point->i_date;
+    const mtime_t i_now = mdate();
+    p_ts->i_cmd_delay = i_now - i_date - p_ts->i_buffering_delay;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    if( p_ts->b_paused )
+        p_ts->i_pause_date = i_now;
+
+    es_out_SetTime( p_ts->p_out, -1 );
+
+    vlc_cond_signal( &p_ts->wait );
+    vlc_mutex_unlock( &p_ts->lock );
+    return VLC_SUCCESS;
+}
+/* Skips everything not played yet, before an input seek. The window is
+ * kept until TsResetWindow(), as the input seek may fail. */
+static int TsFlush( ts_thread_t *p_ts )
+{
+    vlc_mutex_lock( &p_ts->lock );
+
+    TsInterruptLocked( p_ts );
+    TsSkipLocked( p_ts, NULL, 0 );
+
+    p_ts->p_storage_flush = p_ts->p_storage_r;
+    if( p_ts->p_storage_r )
+        p_ts->i_cmd_flush = p_ts->p_storage_r->i_cmd_r;
+
+    /* Nothing is delayed anymore */
+    p_ts->i_cmd_delay = 0;
+    p_ts->i_buffering_delay = 0;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    if( p_ts->b_paused )
+        p_ts->i_pause_date = mdate();
+
+    const int i_ret = es_out_SetTime( p_ts->p_out, -1 );
+
+    vlc_cond_signal( &p_ts->wait );
+    vlc_mutex_unlock( &p_ts->lock );
+    return i_ret;
+}
+
+/* Forgets the stream before the last flush, the input seek succeeded and
+ * it cannot be seeked back to */
+static void TsResetWindow( ts_thread_t *p_ts )
+{
+    vlc_mutex_lock( &p_ts->lock );
+
+    ts_storage_t *p_flush = p_ts->p_storage_flush;
+    if( p_flush )
+    {
+        while( p_ts->p_storage_first != p_flush )
+        {
+            ts_storage_t *p_next = p_ts->p_storage_first->p_next;
+            TsReleaseStorage( p_ts, p_ts->p_storage_first );
+            p_ts->p_storage_first = p_next;
+        }
+        p_flush->i_cmd_first = __MAX( p_flush->i_cmd_first, p_ts->i_cmd_flush );
+        p_ts->p_storage_flush = NULL;
+        TsUpdateWindow( p_ts );
+    }
+
+    vlc_mutex_unlock( &p_ts->lock );
+}
+
 static void *TsRun( void *p_data )
 {
     ts_thread_t *p_ts = p_data;
@@ -942,6 +1306,8 @@ static void *TsRun( void *p_data )
         ts_cmd_t cmd;
         mtime_t  i_deadline;
         bool b_buffering;
+        unsigned i_seek;
+        bool b_stale;
 
         /* Pop a command to execute */
         vlc_mutex_lock( &p_ts->lock );
@@ -1010,40 +1376,37 @@ static void *TsRun( void *p_data )
             vlc_restorecancel( canc );
         }
         i_deadline = cmd.i_date + p_ts->i_cmd_delay + p_ts->i_rate_delay + p_ts->i_buffering_delay;
-
-        vlc_cleanup_run();
+        i_seek = p_ts->i_seek;
+        p_ts->b_cmd_held = true;
 
         /* Regulate the speed of command processing to the same one than
-         * reading  */
+         * reading, unless a seek is waiting for this command */
         vlc_cleanup_push( cmd_cleanup_routine, &cmd );
 
-        mwait( i_deadline );
+        while( i_seek == p_ts->i_seek &&
+               !vlc_cond_timedwait( &p_ts->wait_cmd, &p_ts->lock, i_deadline ) )
+            ;
 
         vlc_cleanup_pop();
 
+        /* The data popped before a seek is not wanted anymore */
+        b_stale = i_seek != p_ts->i_seek;
+
+        vlc_cleanup_run();
+
         /* Execute the command  */
         const int canc = vlc_savecancel();
-        switch( cmd.i_type )
-        {
-        case C_ADD:
-            CmdExecuteAdd( p_ts->p_out, &cmd );
-            CmdCleanAdd( &cmd );
-            break;
-        case C_SEND:
-            CmdExecuteSend( p_ts->p_out, &cmd );
-            CmdCleanSend( &cmd );
-            break;
-        case C_CONTROL:
-            CmdExecuteControl( p_ts->p_out, &cmd );
-            CmdCleanControl( &cmd );
-            break;
-        case C_DEL:
-            CmdExecuteDel( p_ts->p_out, &cmd );
-            break;
-        default:
-            vlc_assert_unreachable();
-            break;
-        }
+
+        if( b_stale && cmd.i_type == C_SEND )
+            CmdClean( &cmd );
+        else
+            CmdExecute( p_ts->p_out, &cmd );
+
+        vlc_mutex_lock( &p_ts->lock );
+        p_ts->b_cmd_held = false;
+        vlc_cond_broadcast( &p_ts->wait_cmd );
+        vlc_mutex_unlock( &p_ts->lock );
+
         vlc_restorecancel( canc );
     }
 
@@ -1065,18 +1428,31 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     /* */
     p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
-    p_storage->p_filew = GetTmpFile( &p_storage->psz_file, psz_tmp_path );
-    if( p_storage->psz_file )
-        p_storage->p_filer = vlc_fopen( p_storage->psz_file, "rb" );
+    p_storage->fd = GetTmpFile( &p_storage->psz_file, psz_tmp_path );
+#ifdef HAVE_MMAP
+    /* Allocate the blocks now, a write in a hole of a full disk would fault.
+     * The file is only mapped while it is read or written */
+    p_storage->p_map = MAP_FAILED;
+    bool b_alloc = p_storage->fd >= 0 &&
+# ifdef HAVE_POSIX_FALLOCATE
+        !posix_fallocate( p_storage->fd, 0, p_storage->i_file_max );
+# else
+        !ftruncate( p_storage->fd, p_storage->i_file_max );
+# endif
+#endif
 
     /* */
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
-    p_storage->i_cmd_max = 30000;
+    p_storage->i_cmd_max = TS_STORAGE_CMD_MAX;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
 
-    if( !p_storage->p_cmd || !p_storage->p_filew || !p_storage->p_filer )
+    if( !p_storage->p_cmd || p_storage->fd < 0
+#ifdef HAVE_MMAP
+     || !b_alloc
+#endif
+      )
     {
         TsStorageDelete( p_storage );
         return NULL;
@@ -1094,11 +1470,11 @@ static void TsStorageDelete( ts_storage_t *p_storage )
         CmdClean( &cmd );
     }
     free( p_storage->p_cmd );
+    free( p_storage->p_index );
 
-    if( p_storage->p_filer )
-        fclose( p_storage->p_filer );
-    if( p_storage->p_filew )
-        fclose( p_storage->p_filew );
+    TsStorageUnmap( p_storage );
+    if( p_storage->fd >= 0 )
+        close( p_storage->fd );
 
     if( p_storage->psz_file )
     {
@@ -1108,6 +1484,28 @@ static void TsStorageDelete( ts_storage_t *p_storage )
 
     free( p_storage );
 }
+/* Empties a fully read storage so that it can be written again */
+static int TsStorageReset( ts_storage_t *p_storage )
+{
+    assert( TsStorageIsEmpty( p_storage ) );
+
+    if( p_storage->i_cmd_max < TS_STORAGE_CMD_MAX )
+    {
+        ts_cmd_t *p_new = realloc( p_storage->p_cmd, TS_STORAGE_CMD_MAX * sizeof(*p_storage->p_cmd) );
+        if( !p_new )
+            return VLC_ENOMEM;
+        p_storage->p_cmd = p_new;
+        p_storage->i_cmd_max = TS_STORAGE_CMD_MAX;
+    }
+
+    p_storage->p_next = NULL;
+    p_storage->i_file_size = 0;
+    p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_w = 0;
+    p_storage->i_cmd_first = 0;
+    p_storage->i_index = 0;
+    return VLC_SUCCESS;
+}
 static void TsStoragePack( ts_storage_t *p_storage )
 {
     /* Try to release a bit of memory */
@@ -1120,22 +1518,97 @@ static void TsStoragePack( ts_storage_t *p_storage )
     if( p_new )
         p_storage->p_cmd = p_new;
 }
+/* Bytes used in the file by a command */
+static size_t TsStorageCmdSize( const ts_cmd_t *p_cmd )
+{
+    if( !p_cmd || p_cmd->i_type != C_SEND )
+        return 0;
+    return TS_RECORD_ALIGN( sizeof(ts_record_t) + p_cmd->u.send.p_block->i_buffer );
+}
 static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
-    if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
-    {
-        size_t i_size = sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
-
-        if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
-            return true;
-    }
+    if( p_storage->i_file_size + TsStorageCmdSize( p_cmd ) > p_storage->i_file_max )
+        return true;
     return p_storage->i_cmd_w >= p_storage->i_cmd_max;
 }
 static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+/* Maps the storage file on its first access. Only the storages being read
+ * and written stay mapped, a long buffer would exhaust the address space of
+ * 32 bits systems. Without a mapping, plain file I/O is used. */
+#ifdef HAVE_MMAP
+static bool TsStorageMap( ts_storage_t *p_storage )
+{
+    if( p_storage->p_map == MAP_FAILED )
+        p_storage->p_map = mmap( NULL, p_storage->i_file_max, PROT_READ|PROT_WRITE,
+                                 MAP_SHARED, p_storage->fd, 0 );
+    return p_storage->p_map != MAP_FAILED;
+}
+#endif
+static void TsStorageUnmap( ts_storage_t *p_storage )
+{
+#ifdef HAVE_MMAP
+    if( p_storage->p_map != MAP_FAILED )
+        munmap( p_storage->p_map, p_storage->i_file_max );
+    p_storage->p_map = MAP_FAILED;
+#else
+    VLC_UNUSED( p_storage );
+#endif
+}
+static int TsStorageWrite( ts_storage_t *p_storage, int64_t i_offset,
+                           const void *p_data, size_t i_data )
+{
+#ifdef HAVE_MMAP
+    if( TsStorageMap( p_storage ) )
+    {
+        memcpy( &p_storage->p_map[i_offset], p_data, i_data );
+        return VLC_SUCCESS;
+    }
+#endif
+    if( lseek( p_storage->fd, i_offset, SEEK_SET ) != i_offset ||
+        write( p_storage->fd, p_data, i_data ) != (ssize_t)i_data )
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
+}
+static int TsStorageRead( ts_storage_t *p_storage, int64_t i_offset,
+                          void *p_data, size_t i_data )
+{
+#ifdef HAVE_MMAP
+    if( TsStorageMap( p_storage ) )
+    {
+        memcpy( p_data, &p_storage->p_map[i_offset], i_data );
+        return VLC_SUCCESS;
+    }
+#endif
+    if( lseek( p_storage->fd, i_offset, SEEK_SET ) != i_offset ||
+        read( p_storage->fd, p_data, i_data ) != (ssize_t)i_data )
+        return VLC_EGENERIC;
+    return VLC_SUCCESS;
+}
+static void TsStorageIndex( ts_storage_t *p_storage, mtime_t i_date, mtime_t i_time )
+{
+    if( p_storage->i_index > 0 &&
+        i_date < p_storage->p_index[p_storage->i_index-1].i_date + TS_STORAGE_INDEX_INTERVAL )
+        return;
+
+    if( p_storage->i_index >= p_storage->i_index_max )
+    {
+        const int i_max = __MAX( 2 * p_storage->i_index_max, 64 );
+        ts_storage_index_t *p_new = realloc( p_storage->p_index, i_max * sizeof(*p_new) );
+        if( !p_new )
+            return;
+        p_storage->p_index = p_new;
+        p_storage->i_index_max = i_max;
+    }
+
+    p_storage->p_index[p_storage->i_index].i_date = i_date;
+    p_storage->p_index[p_storage->i_index].i_time = i_time;
+    p_storage->p_index[p_storage->i_index].i_cmd = p_storage->i_cmd_w;
+    p_storage->i_index++;
+}
+static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, mtime_t i_time )
 {
     ts_cmd_t cmd = *p_cmd;
 
@@ -1144,30 +1617,29 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
     if( cmd.i_type == C_SEND )
     {
         block_t *p_block = cmd.u.send.p_block;
+        const ts_record_t record = {
+            .i_pts = p_block->i_pts,
+            .i_dts = p_block->i_dts,
+            .i_length = p_block->i_length,
+            .i_flags = p_block->i_flags,
+            .i_nb_samples = p_block->i_nb_samples,
+            .i_buffer = p_block->i_buffer,
+        };
 
         cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+        cmd.u.send.i_offset = p_storage->i_file_size;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
+        if( TsStorageWrite( p_storage, cmd.u.send.i_offset, &record, sizeof(record) ) ||
+            TsStorageWrite( p_storage, cmd.u.send.i_offset + sizeof(record),
+                            p_block->p_buffer, p_block->i_buffer ) )
         {
             block_Release( p_block );
             return;
         }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
-        {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
-            {
-                block_Release( p_block );
-                return;
-            }
-        }
-        p_storage->i_file_size += p_block->i_buffer;
+        p_storage->i_file_size += TsStorageCmdSize( p_cmd );
         block_Release( p_block );
-
-        if( b_flush )
-            fflush( p_storage->p_filew );
     }
+    TsStorageIndex( p_storage, cmd.i_date, i_time );
     p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
 }
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
@@ -1175,23 +1647,27 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
     assert( !TsStorageIsEmpty( p_storage ) );
 
     *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
+    /* Only the es data and clock can be read again */
+    if( !CmdIsReplayable( p_cmd ) )
+        p_storage->p_cmd[p_storage->i_cmd_r - 1].i_type = C_PLAYED;
     if( p_cmd->i_type == C_SEND )
     {
-        block_t block;
+        ts_record_t record;
 
         if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
+            !TsStorageRead( p_storage, p_cmd->u.send.i_offset, &record, sizeof(record) ) )
         {
-            block_t *p_block = block_Alloc( block.i_buffer );
+            block_t *p_block = block_Alloc( record.i_buffer );
             if( p_block )
             {
-                p_block->i_dts      = block.i_dts;
-                p_block->i_pts      = block.i_pts;
-                p_block->i_flags    = block.i_flags;
-                p_block->i_length   = block.i_length;
-                p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
+                p_block->i_dts      = record.i_dts;
+                p_block->i_pts      = record.i_pts;
+                p_block->i_flags    = record.i_flags;
+                p_block->i_length   = record.i_length;
+                p_block->i_nb_samples = record.i_nb_samples;
+                if( TsStorageRead( p_storage, p_cmd->u.send.i_offset + sizeof(record),
+                                   p_block->p_buffer, record.i_buffer ) )
+                    p_block->i_buffer = 0;
             }
             p_cmd->u.send.p_block = p_block;
         }
@@ -1206,6 +1682,49 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
 /*****************************************************************************
  *
  *****************************************************************************/
+static void CmdExecute( es_out_t *p_out, ts_cmd_t *p_cmd )
+{
+    switch( p_cmd->i_type )
+    {
+    case C_ADD:
+        CmdExecuteAdd( p_out, p_cmd );
+        CmdCleanAdd( p_cmd );
+        break;
+    case C_SEND:
+        CmdExecuteSend( p_out, p_cmd );
+        CmdCleanSend( p_cmd );
+        break;
+    case C_CONTROL:
+        CmdExecuteControl( p_out, p_cmd );
+        CmdCleanControl( p_cmd );
+        break;
+    case C_DEL:
+        CmdExecuteDel( p_out, p_cmd );
+        break;
+    default:
+        vlc_assert_unreachable();
+        break;
+    }
+}
+/* Commands that own nothing, and may be executed again after a seek */
+static bool CmdIsReplayable( const ts_cmd_t *p_cmd )
+{
+    if( p_cmd->i_type == C_SEND )
+        return true;
+    if( p_cmd->i_type != C_CONTROL )
+        return false;
+
+    switch( p_cmd->u.control.i_query )
+    {
+    case ES_OUT_SET_PCR:
+    case ES_OUT_SET_GROUP_PCR:
+    case ES_OUT_SET_NEXT_DISPLAY_TIME:
+    case ES_OUT_SET_TIMES:
+        return true;
+    default:
+        return false;
+    }
+}
 static void CmdClean( ts_cmd_t *p_cmd )
 {
     switch( p_cmd->i_type )
@@ -1220,6 +1739,7 @@ static void CmdClean( ts_cmd_t *p_cmd )
         CmdCleanControl( p_cmd );
         break;
     case C_DEL:
+    case C_PLAYED:
         break;
     default:
         vlc_assert_unreachable();
@@ -1586,29 +2106,17 @@ static char *GetTmpPath( char *psz_path )
     return psz_path;
 }
 
-static FILE *GetTmpFile( char **ppsz_file, const char *psz_path )
+static int GetTmpFile( char **ppsz_file, const char *psz_path )
 {
     char *psz_name;
-    int fd;
-    FILE *f;
 
     /* */
     *ppsz_file = NULL;
     if( asprintf( &psz_name, "%s"DIR_SEP"vlc-timeshift.XXXXXX", psz_path ) < 0 )
-        return NULL;
+        return -1;
 
     /* */
-    fd = vlc_mkstemp( psz_name );
     *ppsz_file = psz_name;
-
-    if( fd < 0 )
-        return NULL;
-
-    /* */
-    f = fdopen( fd, "w+b" );
-    if( !f )
-        close( fd );
-
-    return f;
+    return vlc_mkstemp( psz_name );
 }
 
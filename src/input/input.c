@@ -1653,6 +1653,7 @@ static bool Control( input_thread_t *p_input,
             }
             else
             {
+                es_out_ResetWindow( p_input->p->p_es_out );
                 if( p_input->p->i_slave > 0 )
                     SlaveSeek( p_input );
                 p_input->p->input.b_eof = false;
@@ -1677,25 +1678,36 @@ static bool Control( input_thread_t *p_input,
             if( i_time < 0 )
                 i_time = 0;
 
-            /* Reset the decoders states and clock sync (before calling the demuxer */
-            es_out_SetTime( p_input->p->p_es_out, -1 );
+            /* An input that cannot seek is seeked within the timeshift
+             * window, if any */
+            i_ret = VLC_EGENERIC;
+            if( !p_input->p->input.b_can_seek )
+                i_ret = es_out_SetTime( p_input->p->p_es_out, i_time );
 
-            i_ret = demux_Control( p_input->p->input.p_demux,
-                                   DEMUX_SET_TIME, i_time,
-                                   !p_input->p->b_fast_seek );
             if( i_ret )
             {
-                int64_t i_length;
+                /* Reset the decoders states and clock sync (before calling the demuxer */
+                es_out_SetTime( p_input->p->p_es_out, -1 );
 
-                /* Emulate it with a SET_POS */
-                if( !demux_Control( p_input->p->input.p_demux,
-                                    DEMUX_GET_LENGTH, &i_length ) && i_length > 0 )
+                i_ret = demux_Control( p_input->p->input.p_demux,
+                                       DEMUX_SET_TIME, i_time,
+                                       !p_input->p->b_fast_seek );
+                if( i_ret )
                 {
-                    double f_pos = (double)i_time / (double)i_length;
-                    i_ret = demux_Control( p_input->p->input.p_demux,
-                                            DEMUX_SET_POSITION, f_pos,
-                                            !p_input->p->b_fast_seek );
+                    int64_t i_length;
+
+                    /* Emulate it with a SET_POS */
+                    if( !demux_Control( p_input->p->input.p_demux,
+                                        DEMUX_GET_LENGTH, &i_length ) && i_length > 0 )
+                    {
+                        double f_pos = (double)i_time / (double)i_length;
+                        i_ret = demux_Control( p_input->p->input.p_demux,
+                                                DEMUX_SET_POSITION, f_pos,
+                                                !p_input->p->b_fast_seek );
+                    }
                 }
+                if( !i_ret )
+                    es_out_ResetWindow( p_input->p->p_es_out );
             }
             if( i_ret )
             {
@@ -1868,8 +1880,9 @@ static bool Control( input_thread_t *p_input,
                 break;
 
             es_out_SetTime( p_input->p->p_es_out, -1 );
-            demux_Control( p_input->p->input.p_demux,
-                           DEMUX_SET_TITLE, i_title );
+            if( !demux_Control( p_input->p->input.p_demux,
+                                DEMUX_SET_TITLE, i_title ) )
+                es_out_ResetWindow( p_input->p->p_es_out );
             input_SendEventTitle( p_input, i_title );
             break;
         }
@@ -1911,8 +1924,9 @@ static bool Control( input_thread_t *p_input,
                 break;
 
             es_out_SetTime( p_input->p->p_es_out, -1 );
-            demux_Control( p_input->p->input.p_demux,
-                           DEMUX_SET_SEEKPOINT, i_seekpoint );
+            if( !demux_Control( p_input->p->input.p_demux,
+                                DEMUX_SET_SEEKPOINT, i_seekpoint ) )
+                es_out_ResetWindow( p_input->p->p_es_out );
             input_SendEventSeekpoint( p_input, i_title, i_seekpoint );
             break;
         }
@@ -2157,6 +2171,13 @@ static input_source_t *InputSourceNew( input_thread_t *p_input )
     return calloc( 1,  sizeof( input_source_t ) );
 }
 
+/* The timeshift window can be seeked even when the input cannot */
+static bool InputCanSeek( input_thread_t *p_input, const input_source_t *in )
+{
+    return in->b_can_seek ||
+           var_InheritInteger( p_input, "input-timeshift-window" ) > 0;
+}
+
 /*****************************************************************************
  * InputSourceInit:
  *****************************************************************************/
@@ -2247,10 +2268,9 @@ static int InputSourceInit( input_thread_t *p_input,
         var_SetBool( p_input, "can-rate", !in->b_can_pace_control || in->b_can_rate_control ); /* XXX temporary because of es_out_timeshift*/
         var_SetBool( p_input, "can-rewind", !in->b_rescale_ts && !in->b_can_pace_control && in->b_can_rate_control );
 
-        bool b_can_seek;
-        if( demux_Control( in->p_demux, DEMUX_CAN_SEEK, &b_can_seek ) )
-            b_can_seek = false;
-        var_SetBool( p_input, "can-seek", b_can_seek );
+        if( demux_Control( in->p_demux, DEMUX_CAN_SEEK, &in->b_can_seek ) )
+            in->b_can_seek = false;
+        var_SetBool( p_input, "can-seek", InputCanSeek( p_input, in ) );
     }
     else
     {   /* Now try a real access */
@@ -2335,8 +2355,6 @@ static int InputSourceInit( input_thread_t *p_input,
 
         if( !p_input->b_preparsing )
         {
-            bool b;
-
             stream_Control( p_stream, STREAM_CAN_CONTROL_PACE,
                             &in->b_can_pace_control );
             in->b_can_rate_control = in->b_can_pace_control;
@@ -2350,8 +2368,8 @@ static int InputSourceInit( input_thread_t *p_input,
             var_SetBool( p_input, "can-rewind",
                          !in->b_rescale_ts && !in->b_can_pace_control );
 
-            stream_Control( p_stream, STREAM_CAN_SEEK, &b );
-            var_SetBool( p_input, "can-seek", b );
+            stream_Control( p_stream, STREAM_CAN_SEEK, &in->b_can_seek );
+            var_SetBool( p_input, "can-seek", InputCanSeek( p_input, in ) );
 
             in->b_title_demux = false;
 
@@ -55,6 +55,7 @@ typedef struct
     int i_seekpoint_end;
 
     /* Properties */
+    bool b_can_seek;
     bool b_can_pause;
     bool b_can_pace_control;
     bool b_can_rate_control;
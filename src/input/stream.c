@@ -68,6 +68,8 @@
     /* Max size of our cache 4Mo per track */
 #   define STREAM_CACHE_SIZE  (4*STREAM_CACHE_TRACK*1024*1024)
 #endif
+/* Smallest track size allowed by --stream-cache-size */
+#define STREAM_CACHE_TRACK_MIN (64*1024)
 
 /* How many data we try to prebuffer
  * XXX it should be small to avoid useless latency but big enough for
@@ -93,7 +95,18 @@
  *        - ?
  */
 #define STREAM_READ_ATONCE 1024
-#define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
+
+/* Method2 with read-ahead (--stream-readahead):
+ *  A thread refills the current track up to the watermark, or to what the
+ *  reader is waiting for, so slow accesses do not block the demuxer.
+ *  Only the thread reads from the access, unless the reader holds it
+ *  (i_hold) to seek or control the access, which is then done
+ *  synchronously. The area about to be overwritten in the ring is
+ *  removed from the track before reading, so the reader can keep on
+ *  using the rest of the track meanwhile.
+ */
+#define STREAM_READAHEAD_MIN (32*1024)
+#define STREAM_READAHEAD_MAX (256*1024)
 
 typedef struct
 {
@@ -106,6 +119,18 @@ typedef struct
 
 } stream_track_t;
 
+/* Access state answered without the access under read-ahead */
+typedef struct
+{
+    bool     b_can_seek;
+    bool     b_can_fastseek;
+    bool     b_can_pause;
+    bool     b_can_control_pace;
+    int64_t  i_pts_delay;
+    uint64_t i_size;
+
+} stream_caps_t;
+
 typedef struct
 {
     char     *psz_path;
@@ -154,6 +179,21 @@ struct stream_sys_t
         /* */
         unsigned i_used; /* Used since last read */
         unsigned i_read_size;
+        unsigned i_tk_size; /* Size of one track */
+
+        /* Read-ahead thread */
+        bool         b_readahead;
+        unsigned     i_watermark;
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait_data;   /* data read or thread idle */
+        vlc_cond_t   wait_space;  /* data consumed or wanted */
+        unsigned     i_wanted;    /* Data the reader is waiting for */
+        unsigned     i_hold;
+        bool         b_busy;      /* Reading outside of the lock */
+        bool         b_eof;
+        bool         b_quit;
+        stream_caps_t caps;       /* Refreshed by whoever owns the access */
 
     } stream;
 
@@ -190,6 +230,10 @@ static int  AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned in
 static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
+static int  AStreamReadStreamAsync( stream_t *s, void *p_read, unsigned int i_read );
+static int  AStreamPeekStreamAsync( stream_t *s, const uint8_t **pp_peek, unsigned int i_read );
+static void *AStreamReadAheadThread( void * );
+static void AStreamGetCaps( stream_t *s, stream_caps_t *p_caps );
 
 /* ReadDir */
 static input_item_t *AStreamReadDir( stream_t *s );
@@ -394,9 +438,17 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         s->pf_peek = AStreamPeekStream;
 
         /* Allocate/Setup our tracks */
+        int64_t i_cache_size = 1024 * var_InheritInteger( s, "stream-cache-size" );
+        if( i_cache_size <= 0 )
+            i_cache_size = STREAM_CACHE_SIZE;
+        p_sys->stream.i_tk_size = __MAX( i_cache_size / STREAM_CACHE_TRACK,
+                                         STREAM_CACHE_TRACK_MIN );
+
         p_sys->stream.i_offset = 0;
         p_sys->stream.i_tk     = 0;
-        p_sys->stream.p_buffer = malloc( STREAM_CACHE_SIZE );
+        p_sys->stream.b_readahead = false;
+        p_sys->stream.p_buffer = malloc( STREAM_CACHE_TRACK *
+                                         p_sys->stream.i_tk_size );
         if( p_sys->stream.p_buffer == NULL )
             goto error;
         p_sys->stream.i_used   = 0;
@@ -411,7 +463,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
             p_sys->stream.tk[i].i_start = p_sys->i_pos;
             p_sys->stream.tk[i].i_end   = p_sys->i_pos;
             p_sys->stream.tk[i].p_buffer=
-                &p_sys->stream.p_buffer[i * STREAM_CACHE_TRACK_SIZE];
+                &p_sys->stream.p_buffer[i * p_sys->stream.i_tk_size];
         }
 
         /* Do the prebuffering */
@@ -422,6 +474,40 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
             msg_Err( s, "cannot pre fill buffer" );
             goto error;
         }
+
+        /* Start the read-ahead */
+        int64_t i_watermark = 1024 * var_InheritInteger( s, "stream-readahead" );
+        if( i_watermark > 0 )
+        {
+            p_sys->stream.i_watermark = __MIN( i_watermark,
+                                               p_sys->stream.i_tk_size );
+            p_sys->stream.i_wanted = 0;
+            p_sys->stream.i_hold   = 0;
+            p_sys->stream.b_busy   = false;
+            p_sys->stream.b_eof    = false;
+            p_sys->stream.b_quit   = false;
+            vlc_mutex_init( &p_sys->stream.lock );
+            vlc_cond_init( &p_sys->stream.wait_data );
+            vlc_cond_init( &p_sys->stream.wait_space );
+            AStreamGetCaps( s, &p_sys->stream.caps );
+            p_sys->stream.b_readahead = true;
+            if( vlc_clone( &p_sys->stream.thread, AStreamReadAheadThread, s,
+                           VLC_THREAD_PRIORITY_INPUT ) )
+            {
+                vlc_cond_destroy( &p_sys->stream.wait_space );
+                vlc_cond_destroy( &p_sys->stream.wait_data );
+                vlc_mutex_destroy( &p_sys->stream.lock );
+                p_sys->stream.b_readahead = false;
+            }
+            else
+            {
+                s->pf_read = AStreamReadStreamAsync;
+                s->pf_peek = AStreamPeekStreamAsync;
+                msg_Dbg( s, "read-ahead of %u KiB on %d tracks of %u KiB",
+                         p_sys->stream.i_watermark / 1024, STREAM_CACHE_TRACK,
+                         p_sys->stream.i_tk_size / 1024 );
+            }
+        }
     }
     else
     {
@@ -461,7 +547,21 @@ static void AStreamDestroy( stream_t *s )
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
     else if( p_sys->method == STREAM_METHOD_STREAM )
+    {
+        if( p_sys->stream.b_readahead )
+        {
+            vlc_mutex_lock( &p_sys->stream.lock );
+            p_sys->stream.b_quit = true;
+            vlc_cond_signal( &p_sys->stream.wait_space );
+            vlc_mutex_unlock( &p_sys->stream.lock );
+
+            vlc_join( p_sys->stream.thread, NULL );
+            vlc_cond_destroy( &p_sys->stream.wait_space );
+            vlc_cond_destroy( &p_sys->stream.wait_data );
+            vlc_mutex_destroy( &p_sys->stream.lock );
+        }
         free( p_sys->stream.p_buffer );
+    }
 
     free( p_sys->p_peek );
 
@@ -514,6 +614,7 @@ static void AStreamControlReset( stream_t *s )
         p_sys->stream.i_offset = 0;
         p_sys->stream.i_tk     = 0;
         p_sys->stream.i_used   = 0;
+        p_sys->stream.b_eof    = false;
 
         for( i = 0; i < STREAM_CACHE_TRACK; i++ )
         {
@@ -552,7 +653,70 @@ static void AStreamControlUpdate( stream_t *s )
 /****************************************************************************
  * AStreamControl:
  ****************************************************************************/
+static void AStreamHold( stream_t *s );
+static void AStreamRelease( stream_t *s );
+static int AStreamAccessControl( stream_t *s, int i_query, va_list args );
+
 static int AStreamControl( stream_t *s, int i_query, va_list args )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->method != STREAM_METHOD_STREAM || !p_sys->stream.b_readahead )
+        return AStreamAccessControl( s, i_query, args );
+
+    int i_ret = VLC_SUCCESS;
+    vlc_mutex_lock( &p_sys->stream.lock );
+    switch( i_query )
+    {
+        /* Those are answered from the cache while the access is reading */
+        case STREAM_CAN_SEEK:
+            *va_arg( args, bool * ) = p_sys->stream.caps.b_can_seek;
+            break;
+        case STREAM_CAN_FASTSEEK:
+            *va_arg( args, bool * ) = p_sys->stream.caps.b_can_fastseek;
+            break;
+        case STREAM_CAN_PAUSE:
+            *va_arg( args, bool * ) = p_sys->stream.caps.b_can_pause;
+            break;
+        case STREAM_CAN_CONTROL_PACE:
+            *va_arg( args, bool * ) = p_sys->stream.caps.b_can_control_pace;
+            break;
+        case STREAM_GET_PTS_DELAY:
+            *va_arg( args, int64_t * ) = p_sys->stream.caps.i_pts_delay;
+            break;
+        case STREAM_GET_SIZE:
+            *va_arg( args, uint64_t * ) = p_sys->stream.caps.i_size;
+            break;
+
+        case STREAM_GET_POSITION:
+        case STREAM_SET_POSITION: /* holds it if needed */
+            i_ret = AStreamAccessControl( s, i_query, args );
+            break;
+        default:
+            AStreamHold( s );
+            i_ret = AStreamAccessControl( s, i_query, args );
+            AStreamRelease( s );
+            break;
+    }
+    vlc_mutex_unlock( &p_sys->stream.lock );
+    return i_ret;
+}
+
+static uint64_t AStreamGetSize( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->i_list )
+    {
+        uint64_t i_size = 0;
+        for( int i = 0; i < p_sys->i_list; i++ )
+            i_size += p_sys->list[i]->i_size;
+        return i_size;
+    }
+    return access_GetSize( p_sys->p_access );
+}
+
+static int AStreamAccessControl( stream_t *s, int i_query, va_list args )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t     *p_access = p_sys->p_access;
@@ -595,19 +759,8 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
             return access_vaControl( p_access, i_query, args );
 
         case STREAM_GET_SIZE:
-        {
-            uint64_t *pi_64 = va_arg( args, uint64_t * );
-            if( s->p_sys->i_list )
-            {
-                int i;
-                *pi_64 = 0;
-                for( i = 0; i < s->p_sys->i_list; i++ )
-                    *pi_64 += s->p_sys->list[i]->i_size;
-                break;
-            }
-            *pi_64 = access_GetSize( p_access );
+            *va_arg( args, uint64_t * ) = AStreamGetSize( s );
             break;
-        }
 
         case STREAM_GET_POSITION:
             *va_arg( args, uint64_t * ) = p_sys->i_pos;
@@ -1048,6 +1201,63 @@ static int AStreamRefillBlock( stream_t *s )
 static int AStreamRefillStream( stream_t *s );
 static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read );
 
+/* Read-ahead: the lock protects the tracks, and the access when held */
+static void AStreamHold( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->stream.b_readahead )
+        return;
+
+    p_sys->stream.i_hold++;
+    while( p_sys->stream.b_busy )
+        vlc_cond_wait( &p_sys->stream.wait_data, &p_sys->stream.lock );
+}
+
+static void AStreamRelease( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->stream.b_readahead )
+        return;
+
+    assert( p_sys->stream.i_hold > 0 );
+    p_sys->stream.b_eof = false; /* we may have seeked */
+    AStreamGetCaps( s, &p_sys->stream.caps );
+    if( --p_sys->stream.i_hold == 0 )
+        vlc_cond_signal( &p_sys->stream.wait_space );
+}
+
+static void AStreamWakeUp( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+
+    if( tk->i_end - tk->i_start - p_sys->stream.i_offset < p_sys->stream.i_watermark )
+        vlc_cond_signal( &p_sys->stream.wait_space );
+}
+
+static int AStreamReadStreamAsync( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    int i_ret = AStreamReadStream( s, p_read, i_read );
+    AStreamWakeUp( s );
+    vlc_mutex_unlock( &p_sys->stream.lock );
+    return i_ret;
+}
+
+static int AStreamPeekStreamAsync( stream_t *s, const uint8_t **pp_peek, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    int i_ret = AStreamPeekStream( s, pp_peek, i_read );
+    vlc_mutex_unlock( &p_sys->stream.lock );
+    return i_ret;
+}
+
 static int AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1082,8 +1292,8 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
 #endif
 
     /* Avoid problem, but that should *never* happen */
-    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
-        i_read = STREAM_CACHE_TRACK_SIZE / 2;
+    if( i_read > p_sys->stream.i_tk_size / 2 )
+        i_read = p_sys->stream.i_tk_size / 2;
 
     while( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
     {
@@ -1102,8 +1312,8 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
     }
 
     /* Now, direct pointer or a copy ? */
-    i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-    if( i_off + i_read <= STREAM_CACHE_TRACK_SIZE )
+    i_off = (tk->i_start + p_sys->stream.i_offset) % p_sys->stream.i_tk_size;
+    if( i_off + i_read <= p_sys->stream.i_tk_size )
     {
         *pp_peek = &tk->p_buffer[i_off];
         return i_read;
@@ -1121,9 +1331,9 @@ static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int
     }
 
     memcpy( p_sys->p_peek, &tk->p_buffer[i_off],
-            STREAM_CACHE_TRACK_SIZE - i_off );
-    memcpy( &p_sys->p_peek[STREAM_CACHE_TRACK_SIZE - i_off],
-            &tk->p_buffer[0], i_read - (STREAM_CACHE_TRACK_SIZE - i_off) );
+            p_sys->stream.i_tk_size - i_off );
+    memcpy( &p_sys->p_peek[p_sys->stream.i_tk_size - i_off],
+            &tk->p_buffer[0], i_read - (p_sys->stream.i_tk_size - i_off) );
 
     *pp_peek = p_sys->p_peek;
     return i_read;
@@ -1149,16 +1359,24 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
 #endif
 
     bool   b_aseek;
-    access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+    bool   b_afastseek;
+    if( p_sys->stream.b_readahead )
+    {
+        /* The thread may be using the access */
+        b_aseek = p_sys->stream.caps.b_can_seek;
+        b_afastseek = p_sys->stream.caps.b_can_fastseek;
+    }
+    else
+    {
+        access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+        access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
+    }
     if( !b_aseek && i_pos < p_current->i_start )
     {
         msg_Warn( s, "AStreamSeekStream: can't seek" );
         return VLC_EGENERIC;
     }
 
-    bool   b_afastseek;
-    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
-
     /* FIXME compute seek cost (instead of static 'stupid' value) */
     uint64_t i_skip_threshold;
     if( b_aseek )
@@ -1172,6 +1390,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     /* Search a new track slot */
     stream_track_t *tk = NULL;
     int i_tk_idx = -1;
+    bool b_hold = false;
 
     /* Prefer the current track */
     if( p_current->i_start <= i_pos && i_pos <= p_current->i_end + i_skip_threshold )
@@ -1229,18 +1448,31 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
             /* Seek at the end of the buffer
              * TODO it is stupid to seek now, it would be better to delay it
              */
+            AStreamHold( s );
+            b_hold = true;
             if( ASeek( s, tk->i_end ) )
+            {
+                AStreamRelease( s );
                 return VLC_EGENERIC;
+            }
         }
         else if( i_pos > tk->i_end )
         {
-            uint64_t i_skip = i_pos - tk->i_end;
-            while( i_skip > 0 )
+            /* Skip from the end of the track, the offset must not get
+             * beyond the data read */
+            while( tk->i_end < i_pos )
             {
-                const int i_read_max = __MIN( 10 * STREAM_READ_ATONCE, i_skip );
-                if( AStreamReadNoSeekStream( s, NULL, i_read_max ) != i_read_max )
+                p_sys->stream.i_offset = tk->i_end - tk->i_start;
+                p_sys->i_pos = tk->i_end;
+
+                const unsigned i_read_requested = VLC_CLIP( i_pos - tk->i_end,
+                                                        STREAM_READ_ATONCE / 2,
+                                                        STREAM_READ_ATONCE * 10 );
+                if( p_sys->stream.i_used < i_read_requested )
+                    p_sys->stream.i_used = i_read_requested;
+
+                if( AStreamRefillStream( s ) )
                     return VLC_EGENERIC;
-                i_skip -= i_read_max;
             }
         }
     }
@@ -1250,8 +1482,13 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
         msg_Err( s, "AStreamSeekStream: hard seek" );
 #endif
         /* Nothing good, seek and choose oldest segment */
+        AStreamHold( s );
+        b_hold = true;
         if( ASeek( s, i_pos ) )
+        {
+            AStreamRelease( s );
             return VLC_EGENERIC;
+        }
 
         tk->i_start = i_pos;
         tk->i_end   = i_pos;
@@ -1259,6 +1496,8 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     p_sys->stream.i_offset = i_pos - tk->i_start;
     p_sys->stream.i_tk = i_tk_idx;
     p_sys->i_pos = i_pos;
+    if( b_hold )
+        AStreamRelease( s );
 
     /* If there is not enough data left in the track, refill  */
     /* TODO How to get a correct value for
@@ -1296,10 +1535,10 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
 
     while( i_data < i_read )
     {
-        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
+        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % p_sys->stream.i_tk_size;
         unsigned int i_current =
             __MIN( tk->i_end - tk->i_start - p_sys->stream.i_offset,
-                   STREAM_CACHE_TRACK_SIZE - i_off );
+                   p_sys->stream.i_tk_size - i_off );
         int i_copy = __MIN( i_current, i_read - i_data );
 
         if( i_copy <= 0 ) break; /* EOF */
@@ -1341,14 +1580,43 @@ static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_re
 }
 
 
+/* Waits for the read-ahead thread to read more data in the current track */
+static int AStreamWaitStream( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+    const uint64_t i_end = tk->i_end;
+    const unsigned i_ahead = tk->i_end - tk->i_start - p_sys->stream.i_offset;
+
+    if( i_ahead >= p_sys->stream.i_tk_size )
+        return VLC_EGENERIC; /* No room left */
+
+    p_sys->stream.i_wanted =
+        __MIN( i_ahead + __MAX( p_sys->stream.i_used, STREAM_READ_ATONCE ),
+               p_sys->stream.i_tk_size );
+    p_sys->stream.b_eof = false;
+    vlc_cond_signal( &p_sys->stream.wait_space );
+
+    while( tk->i_end == i_end && !p_sys->stream.b_eof )
+        vlc_cond_wait( &p_sys->stream.wait_data, &p_sys->stream.lock );
+
+    p_sys->stream.i_wanted = 0;
+    p_sys->stream.i_used = 0;
+    return tk->i_end > i_end ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
 static int AStreamRefillStream( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
     stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
 
+    /* Unless we hold the access, the thread reads for us */
+    if( p_sys->stream.b_readahead && p_sys->stream.i_hold == 0 )
+        return AStreamWaitStream( s );
+
     /* We read but won't increase i_start after initial start + offset */
     int i_toread =
-        __MIN( p_sys->stream.i_used, STREAM_CACHE_TRACK_SIZE -
+        __MIN( p_sys->stream.i_used, p_sys->stream.i_tk_size -
                (tk->i_end - tk->i_start - p_sys->stream.i_offset) );
     bool b_read = false;
     int64_t i_start, i_stop;
@@ -1363,13 +1631,13 @@ static int AStreamRefillStream( stream_t *s )
     i_start = mdate();
     while( i_toread > 0 )
     {
-        int i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
+        int i_off = tk->i_end % p_sys->stream.i_tk_size;
         int i_read;
 
         if( !vlc_object_alive(s) )
             return VLC_EGENERIC;
 
-        i_read = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
+        i_read = __MIN( i_toread, p_sys->stream.i_tk_size - i_off );
         i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
 
         /* msg_Dbg( s, "AStreamRefillStream: read=%d", i_read ); */
@@ -1388,10 +1656,10 @@ static int AStreamRefillStream( stream_t *s )
         /* Update end */
         tk->i_end += i_read;
 
-        /* Windows of STREAM_CACHE_TRACK_SIZE */
-        if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end )
+        /* Windows of the track size */
+        if( tk->i_start + p_sys->stream.i_tk_size < tk->i_end )
         {
-            unsigned i_invalid = tk->i_end - tk->i_start - STREAM_CACHE_TRACK_SIZE;
+            unsigned i_invalid = tk->i_end - tk->i_start - p_sys->stream.i_tk_size;
 
             tk->i_start += i_invalid;
             p_sys->stream.i_offset -= i_invalid;
@@ -1446,7 +1714,7 @@ static void AStreamPrebufferStream( stream_t *s )
         }
 
         /* */
-        i_read = STREAM_CACHE_TRACK_SIZE - i_buffered;
+        i_read = p_sys->stream.i_tk_size - i_buffered;
         i_read = __MIN( (int)p_sys->stream.i_read_size, i_read );
         i_read = AReadStream( s, &tk->p_buffer[i_buffered], i_read );
         if( i_read <  0 )
@@ -1467,6 +1735,94 @@ static void AStreamPrebufferStream( stream_t *s )
     }
 }
 
+/* Reads the access state for the read-ahead queries, the caller must own
+ * the access: the thread while busy, the reader while holding it */
+static void AStreamGetCaps( stream_t *s, stream_caps_t *p_caps )
+{
+    access_t *p_access = s->p_sys->p_access;
+
+    if( access_Control( p_access, ACCESS_CAN_SEEK, &p_caps->b_can_seek ) )
+        p_caps->b_can_seek = false;
+    if( access_Control( p_access, ACCESS_CAN_FASTSEEK, &p_caps->b_can_fastseek ) )
+        p_caps->b_can_fastseek = false;
+    if( access_Control( p_access, ACCESS_CAN_PAUSE, &p_caps->b_can_pause ) )
+        p_caps->b_can_pause = false;
+    if( access_Control( p_access, ACCESS_CAN_CONTROL_PACE,
+                        &p_caps->b_can_control_pace ) )
+        p_caps->b_can_control_pace = false;
+    if( access_Control( p_access, ACCESS_GET_PTS_DELAY, &p_caps->i_pts_delay ) )
+        p_caps->i_pts_delay = 0;
+    p_caps->i_size = AStreamGetSize( s );
+}
+
+static void *AStreamReadAheadThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->stream.lock );
+    while( !p_sys->stream.b_quit )
+    {
+        stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
+        const unsigned i_size = p_sys->stream.i_tk_size;
+        const unsigned i_ahead = tk->i_end - tk->i_start - p_sys->stream.i_offset;
+        const unsigned i_target = __MAX( p_sys->stream.i_watermark,
+                                         p_sys->stream.i_wanted );
+
+        if( p_sys->stream.i_hold > 0 || p_sys->stream.b_eof ||
+            i_ahead >= __MIN( i_target, i_size ) )
+        {
+            vlc_cond_wait( &p_sys->stream.wait_space, &p_sys->stream.lock );
+            continue;
+        }
+
+        const unsigned i_off = tk->i_end % i_size;
+        unsigned i_read = __MAX( i_target - i_ahead, STREAM_READAHEAD_MIN );
+        i_read = __MIN( i_read, STREAM_READAHEAD_MAX );
+        i_read = __MIN( i_read, i_size - i_ahead );
+        i_read = __MIN( i_read, i_size - i_off );
+
+        /* Remove the area we are going to overwrite from the track */
+        if( tk->i_end + i_read > tk->i_start + i_size )
+        {
+            unsigned i_invalid = tk->i_end + i_read - tk->i_start - i_size;
+
+            tk->i_start += i_invalid;
+            p_sys->stream.i_offset -= i_invalid;
+        }
+
+        p_sys->stream.b_busy = true;
+        vlc_mutex_unlock( &p_sys->stream.lock );
+
+        const int64_t i_start = mdate();
+        int i_ret = 0;
+        if( vlc_object_alive( s ) )
+            i_ret = AReadStream( s, &tk->p_buffer[i_off], i_read );
+        const int64_t i_stop = mdate();
+
+        /* The access may have changed its size or seekability (reconnection) */
+        stream_caps_t caps;
+        AStreamGetCaps( s, &caps );
+
+        vlc_mutex_lock( &p_sys->stream.lock );
+        p_sys->stream.b_busy = false;
+        p_sys->stream.caps = caps;
+        if( i_ret > 0 )
+        {
+            tk->i_end += i_ret;
+
+            p_sys->stat.i_bytes += i_ret;
+            p_sys->stat.i_read_count++;
+            p_sys->stat.i_read_time += i_stop - i_start;
+        }
+        else /* EOF or error, retried when the reader wants more */
+            p_sys->stream.b_eof = true;
+        vlc_cond_broadcast( &p_sys->stream.wait_data );
+    }
+    vlc_mutex_unlock( &p_sys->stream.lock );
+    return NULL;
+}
+
 /****************************************************************************
  * stream_ReadLine:
  ****************************************************************************/
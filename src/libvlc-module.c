@@ -676,6 +676,12 @@ static const char *const ppsz_prefres[] = {
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define INPUT_TIMESHIFT_WINDOW_TEXT N_("Timeshift window")
+#define INPUT_TIMESHIFT_WINDOW_LONGTEXT N_( \
+    "Duration in seconds of already played stream kept by the timeshift, " \
+    "so that it can be seeked back even when the input cannot seek. " \
+    "The timeshift is then always used. 0 disables it." )
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -982,6 +988,17 @@ static const char *const ppsz_prefres[] = {
     "the correct access is not automatically detected. You should not "\
     "set this as a global option unless you really know what you are doing." )
 
+#define STREAM_CACHE_SIZE_TEXT N_("Stream cache size (KiB)")
+#define STREAM_CACHE_SIZE_LONGTEXT N_( \
+    "Total size of the memory used to cache data read from the access, " \
+    "split among a few tracks to keep seeks cheap. 0 uses the default size." )
+
+#define STREAM_READAHEAD_TEXT N_("Stream read-ahead (KiB)")
+#define STREAM_READAHEAD_LONGTEXT N_( \
+    "Read data ahead of the current position from a separate thread, up " \
+    "to this amount, so that slow accesses do not stall playback. " \
+    "0 reads data only when needed." )
+
 #define STREAM_FILTER_TEXT N_("Stream filter module")
 #define STREAM_FILTER_LONGTEXT N_( \
     "Stream filters are used to modify the stream that is being read. " )
@@ -993,6 +1010,11 @@ static const char *const ppsz_prefres[] = {
     "the correct demuxer is not automatically detected. You should not "\
     "set this as a global option unless you really know what you are doing." )
 
+#define DEMUX_PROBE_CACHE_TEXT N_("Remember demux probing results")
+#define DEMUX_PROBE_CACHE_LONGTEXT N_( \
+    "Try first the demultiplexer that previously opened a stream starting " \
+    "with the same data, or whose signature matches the stream start.")
+
 #define VOD_SERVER_TEXT N_("VoD server module")
 #define VOD_SERVER_LONGTEXT N_( \
     "You can select which VoD server module you want to use. Set this " \
@@ -1839,6 +1861,8 @@ vlc_module_begin ()
                 INPUT_TIMESHIFT_PATH_LONGTEXT, true )
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
+    add_integer( "input-timeshift-window", 0, INPUT_TIMESHIFT_WINDOW_TEXT,
+                 INPUT_TIMESHIFT_WINDOW_LONGTEXT, true )
 
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
@@ -1853,9 +1877,17 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_category_hint( N_("Input"), INPUT_CAT_LONGTEXT , false )
     add_module( "access", "access", NULL, ACCESS_TEXT, ACCESS_LONGTEXT, true )
+    add_integer( "stream-cache-size", 0, STREAM_CACHE_SIZE_TEXT,
+                 STREAM_CACHE_SIZE_LONGTEXT, true )
+        change_integer_range( 0, 1024 * 1024 )
+    add_integer( "stream-readahead", 0, STREAM_READAHEAD_TEXT,
+                 STREAM_READAHEAD_LONGTEXT, true )
+        change_integer_range( 0, 1024 * 1024 )
 
     set_subcategory( SUBCAT_INPUT_DEMUX )
     add_module( "demux", "demux", "any", DEMUX_TEXT, DEMUX_LONGTEXT, true )
+    add_bool( "demux-probe-cache", true, DEMUX_PROBE_CACHE_TEXT,
+              DEMUX_PROBE_CACHE_LONGTEXT, true )
     set_subcategory( SUBCAT_INPUT_ACODEC )
     set_subcategory( SUBCAT_INPUT_SCODEC )
     add_obsolete_bool( "prefer-system-codecs" )
@@ -37,6 +37,7 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
 
 /**
  * @section Block handling functions.
@@ -261,6 +262,177 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
 }
 
 
+/**
+ * @section Pools of recycled blocks.
+ *
+ * Released blocks are pushed on a lock-free list of their size class.
+ * The allocating side moves that whole list to a private list at once,
+ * so it does not suffer from ABA issues.
+ */
+
+/** Smallest size class (256 bytes, enough for a TS packet). */
+#define BLOCK_POOL_MIN_SHIFT 8
+#define BLOCK_POOL_CLASSES   16
+/** Maximum amount of memory cached per size class. */
+#define BLOCK_POOL_CACHE     (4 << 20)
+
+typedef struct
+{
+    block_t self;
+    block_pool_t *pool;
+    unsigned class;
+} block_pool_item_t;
+
+struct block_pool_t
+{
+    unsigned classes;
+    atomic_uint refs; /* the owner, and one per allocated block */
+    vlc_mutex_t lock; /* for the private lists */
+
+    struct
+    {
+        atomic_uintptr_t released; /* lock-free list of released blocks */
+        block_t *free; /* private list of free blocks */
+        unsigned max; /* blocks kept when moving them to the private list */
+    } class[BLOCK_POOL_CLASSES];
+};
+
+static size_t block_PoolClassSize (unsigned class)
+{
+    return (size_t)1 << (BLOCK_POOL_MIN_SHIFT + class);
+}
+
+static unsigned block_PoolClass (size_t size)
+{
+    unsigned class = 0;
+    while (class < BLOCK_POOL_CLASSES && block_PoolClassSize (class) < size)
+        class++;
+    return class;
+}
+
+static void block_ListFree (block_t *list)
+{
+    while (list != NULL)
+    {
+        block_t *next = list->p_next;
+        free (list);
+        list = next;
+    }
+}
+
+static void block_PoolDestroy (block_pool_t *pool)
+{
+    for (unsigned i = 0; i < pool->classes; i++)
+    {
+        block_ListFree (pool->class[i].free);
+        block_ListFree ((block_t *)atomic_load (&pool->class[i].released));
+    }
+    vlc_mutex_destroy (&pool->lock);
+    free (pool);
+}
+
+static void block_PoolUnref (block_pool_t *pool)
+{
+    if (atomic_fetch_sub (&pool->refs, 1) == 1)
+        block_PoolDestroy (pool);
+}
+
+static void block_pool_Release (block_t *block)
+{
+    block_pool_item_t *item = (block_pool_item_t *)block;
+    block_pool_t *pool = item->pool;
+    atomic_uintptr_t *released = &pool->class[item->class].released;
+
+    block_Invalidate (block);
+
+    uintptr_t head = atomic_load (released);
+    do
+        block->p_next = (block_t *)head;
+    while (!atomic_compare_exchange_weak (released, &head, (uintptr_t)block));
+
+    block_PoolUnref (pool);
+}
+
+block_pool_t *block_PoolNew (size_t max_size)
+{
+    block_pool_t *pool = malloc (sizeof (*pool));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    pool->classes = block_PoolClass (max_size);
+    if (pool->classes < BLOCK_POOL_CLASSES)
+        pool->classes++;
+    atomic_init (&pool->refs, 1);
+    vlc_mutex_init (&pool->lock);
+
+    for (unsigned i = 0; i < pool->classes; i++)
+    {
+        atomic_init (&pool->class[i].released, (uintptr_t)NULL);
+        pool->class[i].free = NULL;
+        pool->class[i].max = BLOCK_POOL_CACHE / block_PoolClassSize (i);
+        if (pool->class[i].max == 0)
+            pool->class[i].max = 1;
+    }
+    return pool;
+}
+
+void block_PoolRelease (block_pool_t *pool)
+{
+    block_PoolUnref (pool);
+}
+
+block_t *block_PoolAlloc (block_pool_t *pool, size_t size)
+{
+    const unsigned class = block_PoolClass (size);
+    if (class >= pool->classes)
+        return block_Alloc (size);
+
+    const size_t alloc = sizeof (block_pool_item_t) + BLOCK_ALIGN
+                       + (2 * BLOCK_PADDING) + block_PoolClassSize (class);
+    block_t *b;
+
+    vlc_mutex_lock (&pool->lock);
+    b = pool->class[class].free;
+    if (b == NULL)
+    {
+        b = (block_t *)atomic_exchange (&pool->class[class].released,
+                                        (uintptr_t)NULL);
+
+        /* Do not keep too many of them */
+        block_t *last = b;
+        for (unsigned i = 1; last != NULL && i < pool->class[class].max; i++)
+            last = last->p_next;
+        if (last != NULL)
+        {
+            block_ListFree (last->p_next);
+            last->p_next = NULL;
+        }
+    }
+    if (b != NULL)
+        pool->class[class].free = b->p_next;
+    vlc_mutex_unlock (&pool->lock);
+
+    if (b == NULL)
+    {
+        block_pool_item_t *item = malloc (alloc);
+        if (unlikely(item == NULL))
+            return NULL;
+        item->pool = pool;
+        item->class = class;
+        b = &item->self;
+    }
+    atomic_fetch_add (&pool->refs, 1);
+
+    block_Init (b, (block_pool_item_t *)b + 1,
+                alloc - sizeof (block_pool_item_t));
+    b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
+    b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
+    b->i_buffer = size;
+    b->pf_release = block_pool_Release;
+    return b;
+}
+
+
 static void block_heap_Release (block_t *block)
 {
     block_Invalidate (block);
@@ -84,10 +84,85 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_pool (void)
+{
+    block_pool_t *pool = block_PoolNew (2048);
+    assert (pool != NULL);
+
+    block_t *block = block_PoolAlloc (pool, 188);
+    assert (block != NULL);
+    assert (block->i_buffer == 188);
+    assert (((uintptr_t)block->p_buffer % 32) == 0);
+    memcpy (block->p_buffer, text, sizeof (text));
+    block_Release (block);
+
+    /* Same size class: recycled */
+    block_t *again = block_PoolAlloc (pool, 200);
+    assert (again == block);
+    assert (again->i_buffer == 200);
+    assert (again->i_pts == VLC_TS_INVALID && again->i_flags == 0);
+
+    /* Works with block_Realloc() */
+    again = block_Realloc (again, 100, 4000);
+    assert (again != NULL);
+    assert (again->i_buffer == 4100);
+    block_Release (again);
+
+    /* Bigger than the pool */
+    block = block_PoolAlloc (pool, 100000);
+    assert (block != NULL);
+    assert (block->i_buffer == 100000);
+
+    /* Blocks can outlive the pool */
+    block_t *chain = NULL;
+    for (unsigned i = 0; i < 1000; i++)
+        block_ChainAppend (&chain, block_PoolAlloc (pool, i));
+    block_PoolRelease (pool);
+    block_ChainRelease (chain);
+    block_Release (block);
+}
+
+static void *test_block_pool_thread (void *data)
+{
+    block_fifo_t *fifo = data;
+    block_t *block;
+
+    while ((block = block_FifoGet (fifo))->i_buffer > 0)
+        block_Release (block);
+    block_Release (block);
+    return NULL;
+}
+
+static void test_block_pool_threads (void)
+{
+    block_pool_t *pool = block_PoolNew (1500);
+    block_fifo_t *fifo = block_FifoNew ();
+    vlc_thread_t th;
+
+    assert (pool != NULL && fifo != NULL);
+    assert (vlc_clone (&th, test_block_pool_thread, fifo,
+                       VLC_THREAD_PRIORITY_LOW) == 0);
+
+    for (unsigned i = 0; i < 200000; i++)
+    {
+        block_t *block = block_PoolAlloc (pool, 1 + (i % 1500));
+        assert (block != NULL);
+        memset (block->p_buffer, i, block->i_buffer);
+        block_FifoPut (fifo, block);
+    }
+    block_FifoPut (fifo, block_PoolAlloc (pool, 0));
+    vlc_join (th, NULL);
+
+    block_FifoRelease (fifo);
+    block_PoolRelease (pool);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_pool ();
+    test_block_pool_threads ();
     return 0;
 }
 
@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * csa.c: batched CSA scrambling tests
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <string.h>
+
+/* the scrambler is not a module of its own */
+#include "../modules/mux/mpeg/csa.c"
+
+#define PACKETS 600
+
+static uint8_t ref[PACKETS][188];
+static uint8_t pkts[PACKETS][188];
+static uint8_t *pp_pkts[PACKETS];
+
+static void FillPackets( int i_count )
+{
+    for( int i = 0; i < i_count; i++ )
+    {
+        for( int j = 0; j < 188; j++ )
+            ref[i][j] = rand();
+        ref[i][0] = 0x47;
+        /* mix of odd, even and clear packets, some with adaptation */
+        ref[i][3] = (ref[i][3] & 0x1f) | (rand() % 3 == 0 ? 0x20 : 0x10);
+        if( ref[i][3] & 0x20 )
+            ref[i][4] = rand() % 190;
+        pp_pkts[i] = pkts[i];
+    }
+}
+
+static void SetScrambling( int i_count )
+{
+    for( int i = 0; i < i_count; i++ )
+    {
+        const int r = rand() % 4;
+        ref[i][3] = (ref[i][3] & 0x3f) | (r == 0 ? 0x00 : r == 1 ? 0x80 : 0xc0);
+    }
+}
+
+static void test_decrypt( csa_t *c, int i_count, int i_size )
+{
+    FillPackets( i_count );
+    SetScrambling( i_count );
+    memcpy( pkts, ref, sizeof(pkts) );
+
+    csa_DecryptPackets( c, pp_pkts, i_count, i_size );
+    for( int i = 0; i < i_count; i++ )
+        csa_Decrypt( c, ref[i], i_size );
+
+    assert( !memcmp( pkts, ref, i_count * 188 ) );
+}
+
+static void test_encrypt( csa_t *c, int i_count, int i_size )
+{
+    static uint8_t orig[PACKETS][188];
+
+    FillPackets( i_count );
+    memcpy( pkts, ref, sizeof(pkts) );
+    memcpy( orig, ref, sizeof(orig) );
+
+    csa_EncryptPackets( c, pp_pkts, i_count, i_size );
+    for( int i = 0; i < i_count; i++ )
+        csa_Encrypt( c, ref[i], i_size );
+
+    assert( !memcmp( pkts, ref, i_count * 188 ) );
+
+    csa_DecryptPackets( c, pp_pkts, i_count, i_size );
+    for( int i = 0; i < i_count; i++ )
+        assert( !memcmp( &pkts[i][4], &orig[i][4], i_size - 4 ) );
+}
+
+int main( void )
+{
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    log( "Testing batched CSA\n" );
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+    vlc_object_t *p_obj = VLC_OBJECT(p_vlc->p_libvlc_int);
+
+    csa_t *c = csa_New();
+    assert( c != NULL );
+
+    char psz_even[] = "0123456789abcdef";
+    char psz_odd[] = "fedcba9876543210";
+    assert( csa_SetCW( p_obj, c, psz_even, false ) == VLC_SUCCESS );
+    assert( csa_SetCW( p_obj, c, psz_odd, true ) == VLC_SUCCESS );
+
+    srand( 42 );
+    static const int counts[] = { 1, 7, 8, 9, 63, 64, 65, 128, 257, PACKETS };
+    static const int sizes[] = { 188, 184, 100, 12 };
+    for( size_t i = 0; i < ARRAY_SIZE(counts); i++ )
+        for( size_t j = 0; j < ARRAY_SIZE(sizes); j++ )
+        {
+            test_decrypt( c, counts[i], sizes[j] );
+            csa_UseKey( p_obj, c, j % 2 );
+            test_encrypt( c, counts[i], sizes[j] );
+        }
+
+    csa_Delete( c );
+    libvlc_release( p_vlc );
+
+    return 0;
+}
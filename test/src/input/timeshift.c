@@ -0,0 +1,129 @@
+/*****************************************************************************
+ * timeshift.c: seeking within the timeshift window of a non-seekable input
+ *****************************************************************************
+ * Copyright (C) 2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <vlc_common.h>
+#include <signal.h>
+#include <string.h>
+
+/* 16 bits stereo PCM, fed live through a pipe so that the input cannot seek,
+ * with a stream cache too small to seek back within it */
+#define RATE     48000
+#define FRAME    4
+#define DURATION 8
+
+static void SetLE32( uint8_t *p, uint32_t i )
+{
+    p[0] = i; p[1] = i >> 8; p[2] = i >> 16; p[3] = i >> 24;
+}
+
+static void *Feed( void *data )
+{
+    int fd = *(int *)data;
+    uint8_t hdr[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x02\0"
+                      "\0\0\0\0\0\0\0\0\x04\0\x10\0data";
+
+    SetLE32( &hdr[4], 36 + RATE * FRAME * DURATION );
+    SetLE32( &hdr[24], RATE );
+    SetLE32( &hdr[28], RATE * FRAME );
+    SetLE32( &hdr[40], RATE * FRAME * DURATION );
+    if( write( fd, hdr, sizeof(hdr) ) != sizeof(hdr) )
+        goto end;
+
+    uint8_t buf[RATE * FRAME / 10];
+    for( int i = 0; i < DURATION * 10; i++ )
+    {
+        memset( buf, i, sizeof(buf) );
+        if( write( fd, buf, sizeof(buf) ) != sizeof(buf) )
+            break;
+        usleep( 100000 ); /* real time, as a live source would */
+    }
+end:
+    close( fd );
+    return NULL;
+}
+
+/* Waits until the played time is below (or not) i_limit, in milliseconds */
+static libvlc_time_t WaitTime( libvlc_media_player_t *mp, libvlc_time_t i_limit,
+                               bool b_below )
+{
+    for( int i = 0; i < 500; i++ )
+    {
+        libvlc_time_t i_time = libvlc_media_player_get_time( mp );
+        if( i_time >= 0 && (i_time < i_limit) == b_below )
+            return i_time;
+        usleep( 10000 );
+    }
+    return -1;
+}
+
+int main( void )
+{
+    test_init();
+    signal( SIGPIPE, SIG_IGN );
+
+    log( "Testing timeshift window seek on a non-seekable input\n" );
+
+    const char *args[test_defaults_nargs + 3];
+    memcpy( args, test_defaults_args, sizeof(test_defaults_args) );
+    args[test_defaults_nargs] = "--input-timeshift-window=30";
+    args[test_defaults_nargs + 1] = "--stream-cache-size=192";
+    args[test_defaults_nargs + 2] = "--codec=ddummy";
+
+    libvlc_instance_t *vlc = libvlc_new( test_defaults_nargs + 3, args );
+    assert( vlc != NULL );
+
+    int fds[2];
+    assert( pipe( fds ) == 0 );
+
+    vlc_thread_t th;
+    assert( vlc_clone( &th, Feed, &fds[1], VLC_THREAD_PRIORITY_LOW ) == 0 );
+
+    char psz_mrl[32];
+    snprintf( psz_mrl, sizeof(psz_mrl), "fd://%d", fds[0] );
+    libvlc_media_t *md = libvlc_media_new_location( vlc, psz_mrl );
+    assert( md != NULL );
+    libvlc_media_player_t *mp = libvlc_media_player_new_from_media( md );
+    assert( mp != NULL );
+    libvlc_media_release( md );
+
+    libvlc_media_player_play( mp );
+
+    /* Play a bit, then seek back into what was already played */
+    libvlc_time_t i_live = WaitTime( mp, 2500, false );
+    log( "played up to %"PRId64" ms\n", i_live );
+    assert( i_live >= 2500 );
+    assert( libvlc_media_player_is_seekable( mp ) );
+
+    /* and it plays on from there, rather than from the live point */
+    libvlc_media_player_set_time( mp, 500 );
+    libvlc_time_t i_time = WaitTime( mp, 1000, false );
+    log( "seeked back and played up to %"PRId64" ms\n", i_time );
+    assert( i_time >= 1000 && i_time < i_live );
+
+    libvlc_media_player_stop( mp );
+    libvlc_media_player_release( mp );
+    close( fds[0] );
+    vlc_join( th, NULL );
+    libvlc_release( vlc );
+
+    return 0;
+}